@@ -0,0 +1,507 @@
+/*
+ * Gconnman benchmarks.
+ *
+ * Each scenario runs against the fake ConnMan from tests/mock-connman.c
+ * on a private bus and prints one JSON object per line:
+ *
+ *   {"scenario": "startup", "transport": "dbus-glib", "size": 100,
+ *    "iterations": 20, "ops_per_sec": ..., "p50_us": ..., "p99_us": ...,
+ *    "peak_rss_kb": ...}
+ *
+ * Latencies are per iteration; ops_per_sec counts the operations the
+ * scenario is about (refreshes, reorders, property changes or lookups),
+ * of which an iteration may do several.  Peak RSS is the process's, so
+ * it only ever grows from one scenario to the next.  The transport is the
+ * one the library was configured with (--with-transport), so comparing
+ * them takes a build of each.
+ *
+ * Scenarios:
+ *   startup   time from cm_manager_refresh() to ready, at 10/100/1000
+ *             services
+ *   reorder   the Services array rotated by one, at 100/1000 services
+ *   storm     a PropertyChanged Strength for every network and service
+ *   filtered  the same storm through a strength filter that holds back
+ *             its 1 point changes
+ *   find      cm_manager_find_service() over all 1000 services
+ *   best      cm_manager_get_best_service() for a favorite, at 1000
+ *             services
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <glib-object.h>
+#include <glib.h>
+#include <gconnman/gconnman.h>
+
+#include "mock-connman.h"
+
+#define WAIT_TIMEOUT 60 /* seconds */
+
+#ifndef BENCH_TRANSPORT
+#define BENCH_TRANSPORT "dbus-glib"
+#endif
+
+static gchar *only = NULL;
+static gint scale = 1;
+
+static GOptionEntry entries[] =
+{
+  { "scenario", 's', 0, G_OPTION_ARG_STRING, &only,
+    "Only run the named scenario", "NAME" },
+  { "scale", 'x', 0, G_OPTION_ARG_INT, &scale,
+    "Multiply the number of iterations by N", "N" },
+  { NULL }
+};
+
+static GTimer *bench_clock = NULL;
+
+static gdouble
+bench_now (void)
+{
+  return g_timer_elapsed (bench_clock, NULL);
+}
+
+static glong
+bench_peak_rss (void)
+{
+  struct rusage usage;
+
+  getrusage (RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+static gint
+bench_compare (gconstpointer a, gconstpointer b)
+{
+  gdouble x = *(const gdouble *) a, y = *(const gdouble *) b;
+
+  return x < y ? -1 : x > y;
+}
+
+/* Print and free latencies, in seconds per iteration */
+static void
+bench_report (const gchar *scenario, guint size, GArray *latencies,
+              guint64 ops, gdouble elapsed)
+{
+  guint n = latencies->len;
+  gdouble p50, p99;
+
+  g_array_sort (latencies, bench_compare);
+  p50 = g_array_index (latencies, gdouble, n / 2);
+  p99 = g_array_index (latencies, gdouble, MIN (n - 1, n * 99 / 100));
+
+  g_print ("{\"scenario\": \"%s\", \"transport\": \"%s\", "
+           "\"size\": %u, \"iterations\": %u, "
+           "\"ops_per_sec\": %.1f, \"p50_us\": %.1f, \"p99_us\": %.1f, "
+           "\"peak_rss_kb\": %ld}\n",
+           scenario, BENCH_TRANSPORT, size, n, ops / elapsed, p50 * 1e6,
+           p99 * 1e6, bench_peak_rss ());
+
+  g_array_free (latencies, TRUE);
+}
+
+typedef gboolean (*BenchDone) (gpointer data);
+
+static gboolean
+bench_timeout_cb (gpointer data)
+{
+  g_error ("Timed out waiting for the manager");
+  return FALSE;
+}
+
+static void
+bench_wait (BenchDone done, gpointer data)
+{
+  guint timeout = g_timeout_add (WAIT_TIMEOUT * 1000, bench_timeout_cb, NULL);
+
+  while (!done (data))
+    g_main_context_iteration (NULL, TRUE);
+
+  g_source_remove (timeout);
+}
+
+static MockConnman *
+bench_mock_new (void)
+{
+  GError *error = NULL;
+  MockConnman *mock = mock_connman_new (&error);
+
+  if (!mock)
+    g_error ("Unable to start the fake ConnMan: %s", error->message);
+
+  return mock;
+}
+
+static CmManager *
+bench_manager_new (MockConnman *mock, CmManagerFlags flags)
+{
+  GError *error = NULL;
+  CmManager *manager;
+
+  manager = cm_manager_new_for_address (&error, flags,
+                                        mock_connman_get_address (mock));
+  if (!manager)
+    g_error ("Unable to create a manager: %s", error->message);
+
+  return manager;
+}
+
+typedef struct
+{
+  CmManager *manager;
+  MockConnman *mock;
+  guint n_services;
+  guint64 changes;
+  guint64 expected;
+} BenchState;
+
+static gboolean
+bench_ready (gpointer data)
+{
+  BenchState *state = data;
+
+  return cm_manager_is_ready (state->manager) &&
+         g_list_length ((GList *) cm_manager_get_services (state->manager)) ==
+         state->n_services;
+}
+
+/* Refresh to ready */
+
+static void
+bench_startup (guint n_services, guint iterations)
+{
+  MockConnman *mock = bench_mock_new ();
+  GArray *latencies = g_array_new (FALSE, FALSE, sizeof (gdouble));
+  BenchState state = { NULL, mock, n_services };
+  gdouble start, total = 0;
+  guint i;
+
+  mock_connman_set_services (mock, n_services);
+
+  for (i = 0; i < iterations; i++)
+  {
+    state.manager = bench_manager_new (mock, 0);
+
+    start = bench_now ();
+    cm_manager_refresh (state.manager);
+    bench_wait (bench_ready, &state);
+    start = bench_now () - start;
+
+    g_array_append_val (latencies, start);
+    total += start;
+    g_object_unref (state.manager);
+  }
+
+  bench_report ("startup", n_services, latencies, iterations, total);
+  mock_connman_free (mock);
+}
+
+/* Services reordered by one */
+
+static gboolean
+bench_reordered (gpointer data)
+{
+  BenchState *state = data;
+  const GList *services = cm_manager_get_services (state->manager);
+  gchar *first = mock_connman_service_path (state->mock, 0);
+  gboolean done;
+
+  done = services &&
+         !strcmp (cm_service_get_path (services->data), first);
+  g_free (first);
+
+  return done;
+}
+
+static void
+bench_reorder (guint n_services, guint iterations)
+{
+  MockConnman *mock = bench_mock_new ();
+  GArray *latencies = g_array_new (FALSE, FALSE, sizeof (gdouble));
+  BenchState state = { NULL, mock, n_services };
+  gdouble start, total = 0;
+  guint i;
+
+  /* With the pool the size of the list, rotating only reorders it */
+  mock_connman_set_pool (mock, n_services);
+  mock_connman_set_services (mock, n_services);
+  state.manager = bench_manager_new (mock, 0);
+  cm_manager_refresh (state.manager);
+  bench_wait (bench_ready, &state);
+
+  for (i = 0; i < iterations; i++)
+  {
+    start = bench_now ();
+    mock_connman_rotate (mock, 1);
+    mock_connman_flush (mock);
+    bench_wait (bench_reordered, &state);
+    start = bench_now () - start;
+
+    g_array_append_val (latencies, start);
+    total += start;
+  }
+
+  bench_report ("reorder", n_services, latencies, iterations, total);
+  g_object_unref (state.manager);
+  mock_connman_free (mock);
+}
+
+/* Strength storms */
+
+static void
+bench_strength_changed_cb (GObject *object, gpointer data)
+{
+  BenchState *state = data;
+
+  state->changes++;
+}
+
+static gboolean
+bench_changed (gpointer data)
+{
+  BenchState *state = data;
+
+  return state->changes >= state->expected;
+}
+
+static gboolean
+bench_device_ready (gpointer data)
+{
+  BenchState *state = data;
+  CmDevice *device;
+
+  if (!bench_ready (data))
+    return FALSE;
+
+  device = cm_manager_find_device (state->manager, MOCK_CONNMAN_DEVICE_PATH);
+  return device &&
+         g_list_length ((GList *) cm_device_get_networks (device)) ==
+         state->n_services;
+}
+
+static void
+bench_storm (guint n_objects, guint iterations)
+{
+  MockConnman *mock = bench_mock_new ();
+  GArray *latencies = g_array_new (FALSE, FALSE, sizeof (gdouble));
+  BenchState state = { NULL, mock, n_objects };
+  const GList *iter;
+  CmDevice *device;
+  gdouble start, total = 0;
+  guint i;
+
+  mock_connman_set_services (mock, n_objects);
+  mock_connman_set_networks (mock, n_objects);
+  state.manager = bench_manager_new (mock, MANAGER_FLAG_LOW_LEVEL);
+  cm_manager_refresh (state.manager);
+  bench_wait (bench_device_ready, &state);
+
+  device = cm_manager_find_device (state.manager, MOCK_CONNMAN_DEVICE_PATH);
+  for (iter = cm_device_get_networks (device); iter; iter = iter->next)
+    g_signal_connect (iter->data, "strength-changed",
+                      G_CALLBACK (bench_strength_changed_cb), &state);
+  for (iter = cm_manager_get_services (state.manager); iter; iter = iter->next)
+    g_signal_connect (iter->data, "strength-changed",
+                      G_CALLBACK (bench_strength_changed_cb), &state);
+
+  for (i = 0; i < iterations; i++)
+  {
+    state.expected = state.changes + 2 * n_objects;
+
+    start = bench_now ();
+    mock_connman_strength_storm (mock, 1);
+    bench_wait (bench_changed, &state);
+    start = bench_now () - start;
+
+    g_array_append_val (latencies, start);
+    total += start;
+  }
+
+  bench_report ("storm", 2 * n_objects, latencies,
+                (guint64) iterations * 2 * n_objects, total);
+  g_object_unref (state.manager);
+  mock_connman_free (mock);
+}
+
+/* Strength storms through a filter, waited out by the signal counters */
+
+static guint
+bench_signals (CmManager *manager)
+{
+  CmStats stats;
+
+  cm_manager_get_stats (manager, &stats);
+  return stats.signals[STATS_INTERFACE_NETWORK] +
+         stats.signals[STATS_INTERFACE_SERVICE];
+}
+
+static gboolean
+bench_received (gpointer data)
+{
+  BenchState *state = data;
+
+  return bench_signals (state->manager) >= state->expected;
+}
+
+static void
+bench_filtered (guint n_objects, guint iterations)
+{
+  MockConnman *mock = bench_mock_new ();
+  GArray *latencies = g_array_new (FALSE, FALSE, sizeof (gdouble));
+  BenchState state = { NULL, mock, n_objects };
+  gdouble start, total = 0;
+  guint i;
+
+  mock_connman_set_services (mock, n_objects);
+  mock_connman_set_networks (mock, n_objects);
+  state.manager = bench_manager_new (mock, MANAGER_FLAG_LOW_LEVEL);
+  cm_manager_set_strength_filter (state.manager, 5, 2, 1000);
+  cm_manager_refresh (state.manager);
+  bench_wait (bench_device_ready, &state);
+
+  for (i = 0; i < iterations; i++)
+  {
+    state.expected = bench_signals (state.manager) + 2 * n_objects;
+
+    start = bench_now ();
+    mock_connman_strength_storm (mock, 1);
+    bench_wait (bench_received, &state);
+    start = bench_now () - start;
+
+    g_array_append_val (latencies, start);
+    total += start;
+  }
+
+  bench_report ("filtered", 2 * n_objects, latencies,
+                (guint64) iterations * 2 * n_objects, total);
+  g_object_unref (state.manager);
+  mock_connman_free (mock);
+}
+
+/* Lookups, timed a batch of every service at a time */
+
+static void
+bench_find (guint n_services, guint iterations)
+{
+  MockConnman *mock = bench_mock_new ();
+  GArray *latencies = g_array_new (FALSE, FALSE, sizeof (gdouble));
+  BenchState state = { NULL, mock, n_services };
+  gchar **paths = g_new0 (gchar *, n_services + 1);
+  gdouble start, total = 0;
+  guint i, j;
+
+  mock_connman_set_services (mock, n_services);
+  state.manager = bench_manager_new (mock, 0);
+  cm_manager_refresh (state.manager);
+  bench_wait (bench_ready, &state);
+
+  for (j = 0; j < n_services; j++)
+    paths[j] = mock_connman_service_path (mock, j);
+
+  for (i = 0; i < iterations; i++)
+  {
+    start = bench_now ();
+    for (j = 0; j < n_services; j++)
+    {
+      if (!cm_manager_find_service (state.manager, paths[j]))
+        g_error ("Service %s not found", paths[j]);
+    }
+    start = bench_now () - start;
+
+    g_array_append_val (latencies, start);
+    total += start;
+  }
+
+  bench_report ("find", n_services, latencies,
+                (guint64) iterations * n_services, total);
+  g_strfreev (paths);
+  g_object_unref (state.manager);
+  mock_connman_free (mock);
+}
+
+/* Ranking, a scan of every service each time */
+
+static void
+bench_best (guint n_services, guint iterations)
+{
+  MockConnman *mock = bench_mock_new ();
+  GArray *latencies = g_array_new (FALSE, FALSE, sizeof (gdouble));
+  BenchState state = { NULL, mock, n_services };
+  gdouble start, total = 0;
+  guint i;
+
+  mock_connman_set_services (mock, n_services);
+  state.manager = bench_manager_new (mock, 0);
+  cm_manager_refresh (state.manager);
+  bench_wait (bench_ready, &state);
+
+  for (i = 0; i < iterations; i++)
+  {
+    start = bench_now ();
+    cm_manager_get_best_service (state.manager, 0, TRUE);
+    start = bench_now () - start;
+
+    g_array_append_val (latencies, start);
+    total += start;
+  }
+
+  bench_report ("best", n_services, latencies, iterations, total);
+  g_object_unref (state.manager);
+  mock_connman_free (mock);
+}
+
+static gboolean
+bench_selected (const gchar *scenario)
+{
+  return !only || !strcmp (only, scenario);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  GOptionContext *context;
+  GError *error = NULL;
+
+  g_type_init ();
+
+  context = g_option_context_new ("- gconnman benchmarks");
+  g_option_context_add_main_entries (context, entries, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+  {
+    g_printerr ("%s\n", error->message);
+    return 1;
+  }
+  g_option_context_free (context);
+
+  bench_clock = g_timer_new ();
+
+  if (bench_selected ("startup"))
+  {
+    bench_startup (10, 50 * scale);
+    bench_startup (100, 20 * scale);
+    bench_startup (1000, 5 * scale);
+  }
+
+  if (bench_selected ("reorder"))
+  {
+    bench_reorder (100, 200 * scale);
+    bench_reorder (1000, 50 * scale);
+  }
+
+  if (bench_selected ("storm"))
+    bench_storm (100, 100 * scale);
+
+  if (bench_selected ("filtered"))
+    bench_filtered (100, 100 * scale);
+
+  if (bench_selected ("find"))
+    bench_find (1000, 1000 * scale);
+
+  if (bench_selected ("best"))
+    bench_best (1000, 10000 * scale);
+
+  g_timer_destroy (bench_clock);
+
+  return 0;
+}
@@ -0,0 +1,206 @@
+/*
+ * Gconnman - a GObject wrapper for the Connman D-Bus API
+ * Copyright © 2009, Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ */
+
+/*
+ * GAsyncResult plumbing for the *_async() calls.
+ *
+ * A CmAsyncCall is the user data of one D-Bus call, and the call's
+ * destroy notify frees it.  It completes its GSimpleAsyncResult exactly
+ * once: from the reply, or from being freed without one.
+ *
+ * Cancelling goes through an idle, since the cancellable's handler may
+ * not disconnect itself; the idle cancels the D-Bus call, whose destroy
+ * notify then completes the result with G_IO_ERROR_CANCELLED.  Deadlines
+ * are the D-Bus call's own timeout, reported as DBUS_GERROR_NO_REPLY.
+ */
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "gconnman-internal.h"
+
+CmAsyncCall *
+internal_async_call_new (gpointer source, const gchar *method,
+                         CmStatsCall *stats, GCancellable *cancellable,
+                         GAsyncReadyCallback callback, gpointer user_data,
+                         gpointer source_tag)
+{
+  CmAsyncCall *async = g_slice_new0 (CmAsyncCall);
+
+  async->result = g_simple_async_result_new (G_OBJECT (source), callback,
+                                             user_data, source_tag);
+  async->method = method;
+  async->stats = stats;
+  if (cancellable)
+    async->cancellable = g_object_ref (cancellable);
+
+  return async;
+}
+
+static gboolean
+async_cancel_idle_cb (gpointer data)
+{
+  CmAsyncCall *async = data;
+
+  async->cancel_idle = 0;
+
+  /* Frees async, through the call's destroy notify */
+  dbus_g_proxy_cancel_call (async->proxy, async->call);
+
+  return FALSE;
+}
+
+static void
+async_cancelled_cb (GCancellable *cancellable, gpointer data)
+{
+  CmAsyncCall *async = data;
+
+  if (!async->cancel_idle && !async->completed)
+    async->cancel_idle = g_idle_add (async_cancel_idle_cb, async);
+}
+
+/*
+ * Call once the D-Bus call has been made.  If it could not be, async is
+ * completed with an error and freed, and FALSE is returned.
+ */
+gboolean
+internal_async_call_start (CmAsyncCall *async, DBusGProxy *proxy,
+                           DBusGProxyCall *call)
+{
+  if (!call)
+  {
+    g_simple_async_result_set_error (async->result, DBUS_GERROR,
+                                     DBUS_GERROR_FAILED,
+                                     "Unable to call %s", async->method);
+    internal_async_call_free (async);
+    return FALSE;
+  }
+
+  async->proxy = g_object_ref (proxy);
+  async->call = call;
+
+  if (async->cancellable)
+    async->cancelled_id = g_cancellable_connect (async->cancellable,
+                                                 G_CALLBACK (async_cancelled_cb),
+                                                 async, NULL);
+
+  return TRUE;
+}
+
+/* Report the reply; takes error, NULL for success */
+void
+internal_async_call_complete (CmAsyncCall *async, GError *error)
+{
+  internal_stats_call_done (async->stats, error == NULL);
+
+  if (async->cancel_idle)
+  {
+    g_source_remove (async->cancel_idle);
+    async->cancel_idle = 0;
+  }
+
+  if (!error && g_cancellable_is_cancelled (async->cancellable))
+    error = g_error_new_literal (G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                                 "Operation was cancelled");
+
+  if (error)
+  {
+    g_debug ("%s failed: %s\n", async->method, error->message);
+    g_simple_async_result_set_from_error (async->result, error);
+    g_error_free (error);
+  }
+
+  async->completed = TRUE;
+  g_simple_async_result_complete (async->result);
+}
+
+/* The notify of calls with no return values */
+void
+internal_async_call_notify (DBusGProxy *proxy, DBusGProxyCall *call,
+                            gpointer data)
+{
+  GError *error = NULL;
+
+  dbus_g_proxy_end_call (proxy, call, &error, G_TYPE_INVALID);
+  internal_async_call_complete (data, error);
+}
+
+void
+internal_async_call_free (gpointer data)
+{
+  CmAsyncCall *async = data;
+
+  if (async->cancelled_id)
+    g_cancellable_disconnect (async->cancellable, async->cancelled_id);
+  if (async->cancel_idle)
+    g_source_remove (async->cancel_idle);
+
+  /* Cancelled, or the proxy went away before the reply */
+  if (!async->completed)
+  {
+    if (g_cancellable_is_cancelled (async->cancellable))
+      g_simple_async_result_set_error (async->result, G_IO_ERROR,
+                                       G_IO_ERROR_CANCELLED,
+                                       "Operation was cancelled");
+    else if (async->proxy)
+      g_simple_async_result_set_error (async->result, DBUS_GERROR,
+                                       DBUS_GERROR_NO_REPLY,
+                                       "No reply to %s", async->method);
+    g_simple_async_result_complete_in_idle (async->result);
+  }
+
+  if (async->cancellable)
+    g_object_unref (async->cancellable);
+  if (async->proxy)
+    g_object_unref (async->proxy);
+  internal_stats_call_free (async->stats);
+  g_object_unref (async->result);
+
+  g_slice_free (CmAsyncCall, async);
+}
+
+/* Complete without a D-Bus call, in an idle; takes error, NULL for success */
+void
+internal_async_report (gpointer source, GAsyncReadyCallback callback,
+                       gpointer user_data, gpointer source_tag, GError *error)
+{
+  GSimpleAsyncResult *result;
+
+  result = g_simple_async_result_new (G_OBJECT (source), callback, user_data,
+                                      source_tag);
+  if (error)
+  {
+    g_simple_async_result_set_from_error (result, error);
+    g_error_free (error);
+  }
+
+  g_simple_async_result_complete_in_idle (result);
+  g_object_unref (result);
+}
+
+gboolean
+internal_async_finish (gpointer source, GAsyncResult *result,
+                       gpointer source_tag, GError **error)
+{
+  g_return_val_if_fail (g_simple_async_result_is_valid (result,
+                                                        G_OBJECT (source),
+                                                        source_tag), FALSE);
+
+  return !g_simple_async_result_propagate_error (
+    G_SIMPLE_ASYNC_RESULT (result), error);
+}
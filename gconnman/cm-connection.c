@@ -52,11 +52,12 @@ struct _CmConnectionPrivate
   gboolean signals_added;
 
   gchar *interface;
-  guint strength;
+  guchar strength;
   gboolean default_connection;
   CmDevice *device;
   CmNetwork *network;
-  gchar *ipv4_method;
+  const gchar *ipv4_method; /* interned */
+  CmIPv4Method ipv4_method_enum;
   gchar *ipv4_address;
   gchar *ipv4_gateway;
   gchar *ipv4_broadcast;
@@ -64,8 +65,6 @@ struct _CmConnectionPrivate
   gchar *ipv4_netmask;
 };
 
-static void connection_property_change_handler_proxy (DBusGProxy *, const gchar *,
-						  GValue *, gpointer);
 enum
 {
   SIGNAL_UPDATE,
@@ -93,187 +92,300 @@ connection_error_quark (void)
 }
 
 static void
-connection_emit_updated (CmConnection *connection)
+connection_flush_updated (CmConnection *connection)
 {
   g_signal_emit (connection, connection_signals[SIGNAL_UPDATE], 0 /* detail */);
 }
 
 static void
-connection_update_property (const gchar *key, GValue *value, CmConnection *connection)
+connection_emit_updated (CmConnection *connection)
 {
   CmConnectionPrivate *priv = connection->priv;
-  gchar *tmp;
 
-  // FIXME: use intern strings??
-  if (!strcmp ("Interface", key))
-  {
-    g_free (priv->interface);
-    priv->interface = g_value_dup_string (value);
-    g_signal_emit (connection, connection_signals[SIGNAL_INTERFACE_CHANGED], 0);
-  }
-  else if (!strcmp ("Strength", key))
-  {
-    priv->strength= g_value_get_uchar (value);
-    g_signal_emit (connection, connection_signals[SIGNAL_STRENGTH_CHANGED], 0);
-  }
-  else if (!strcmp ("Default", key))
-  {
-    priv->default_connection = g_value_get_boolean (value);
-    g_signal_emit (connection, connection_signals[SIGNAL_DEFAULT_CHANGED], 0);
-  }
-  else if (!strcmp ("Type", key))
-  {
-    const gchar *type;
-    type = g_value_get_string (value);
-    if (!strcmp (type, "wifi"))
-      priv->type = CONNECTION_WIFI;
-    else if (!strcmp (type, "wimax"))
-      priv->type = CONNECTION_WIMAX;
-    else if (!strcmp (type, "bluetooth"))
-      priv->type = CONNECTION_BLUETOOTH;
-    else if (!strcmp (type, "cellular"))
-      priv->type = CONNECTION_CELLULAR;
-    else if (!strcmp (type, "ethernet"))
-      priv->type = CONNECTION_ETHERNET;
-    else
-    {
-      g_debug ("Unknown connection type on %s: %s\n",
-               cm_connection_get_interface (connection), type);
-      priv->type = CONNECTION_UNKNOWN;
-    }
-    g_signal_emit (connection, connection_signals[SIGNAL_TYPE_CHANGED], 0);
-  }
-  else if (!strcmp ("IPv4.Method", key))
-  {
-    g_free (priv->ipv4_method);
-    priv->ipv4_method = g_value_dup_string (value);
-    g_signal_emit (connection, connection_signals[SIGNAL_IPV4_METHOD_CHANGED], 0);
-  }
-  else if (!strcmp ("IPv4.Address", key))
-  {
-    g_free (priv->ipv4_address);
-    priv->ipv4_address = g_value_dup_string (value);
-    g_signal_emit (connection, connection_signals[SIGNAL_IPV4_ADDRESS_CHANGED], 0);
-  }
-  else if (!strcmp ("IPv4.Gateway", key))
-  {
-    g_free (priv->ipv4_gateway);
-    priv->ipv4_gateway = g_value_dup_string (value);
-    g_signal_emit (connection, connection_signals[SIGNAL_IPV4_GATEWAY_CHANGED], 0);
+  if (!priv->manager ||
+      !internal_manager_queue_update (priv->manager, G_OBJECT (connection),
+                                      (CmUpdateFunc) connection_flush_updated))
+    connection_flush_updated (connection);
+}
 
-  }
-  else if (!strcmp ("IPv4.Broadcast", key))
-  {
-    g_free (priv->ipv4_broadcast);
-    priv->ipv4_broadcast = g_value_dup_string (value);
-    g_signal_emit (connection, connection_signals[SIGNAL_IPV4_BROADCAST_CHANGED], 0);
-  }
-  else if (!strcmp ("IPv4.Nameserver", key))
-  {
-    g_free (priv->ipv4_nameserver);
-    priv->ipv4_nameserver = g_value_dup_string (value);
-    g_signal_emit (connection, connection_signals[SIGNAL_IPV4_NAMESERVER_CHANGED], 0);
-  }
-  else if (!strcmp ("IPv4.Netmask", key))
+static gboolean
+connection_decode_type (gpointer object, const GValue *value)
+{
+  CmConnection *connection = CM_CONNECTION (object);
+  CmConnectionPrivate *priv = connection->priv;
+  const gchar *type;
+
+  type = g_value_get_string (value);
+  if (!strcmp (type, "wifi"))
+    priv->type = CONNECTION_WIFI;
+  else if (!strcmp (type, "wimax"))
+    priv->type = CONNECTION_WIMAX;
+  else if (!strcmp (type, "bluetooth"))
+    priv->type = CONNECTION_BLUETOOTH;
+  else if (!strcmp (type, "cellular"))
+    priv->type = CONNECTION_CELLULAR;
+  else if (!strcmp (type, "ethernet"))
+    priv->type = CONNECTION_ETHERNET;
+  else
   {
-    g_free (priv->ipv4_netmask);
-    priv->ipv4_netmask = g_value_dup_string (value);
-    g_signal_emit (connection, connection_signals[SIGNAL_IPV4_NETMASK_CHANGED], 0);
+    g_debug ("Unknown connection type on %s: %s\n",
+             cm_connection_get_interface (connection), type);
+    priv->type = CONNECTION_UNKNOWN;
   }
-  else if (!strcmp ("Device", key))
-  {
-    gchar *path = g_value_get_boxed (value);
 
-    priv->device = cm_manager_find_device (priv->manager, path);
+  return TRUE;
+}
 
-    if (!priv->device)
-    {
-      g_debug ("Device not found by manager %s: %s\n", path, __FUNCTION__);
-    }
-    else
-    {
-      g_signal_emit (connection, connection_signals[SIGNAL_DEVICE_CHANGED], 0);
-    }
-  }
-  else if (!strcmp ("Network", key))
-  {
-    GError *error = NULL;
-    gchar *path = g_value_get_boxed (value);
+static gboolean
+connection_decode_ipv4_method (gpointer object, const GValue *value)
+{
+  CmConnectionPrivate *priv = CM_CONNECTION (object)->priv;
 
-    if (priv->network)
-    {
-      g_object_unref (priv->network);
-      priv->network = NULL;
-    }
+  priv->ipv4_method_enum = internal_ipv4_method_from_string (
+    priv->ipv4_method);
+
+  return TRUE;
+}
+
+/* The device belongs to the manager; a weak pointer clears when it goes */
+static void
+connection_set_device (CmConnection *connection, CmDevice *device)
+{
+  CmConnectionPrivate *priv = connection->priv;
+
+  if (priv->device)
+    g_object_remove_weak_pointer (G_OBJECT (priv->device),
+                                  (gpointer *) &priv->device);
+
+  priv->device = device;
+
+  if (priv->device)
+    g_object_add_weak_pointer (G_OBJECT (priv->device),
+                               (gpointer *) &priv->device);
+}
+
+/* The device registered after our Device property named it */
+static void
+connection_device_resolved (GObject *object, gpointer device)
+{
+  CmConnection *connection = CM_CONNECTION (object);
+
+  if (connection->priv->device == device)
+    return;
+
+  connection_set_device (connection, device);
+  g_signal_emit (connection, connection_signals[SIGNAL_DEVICE_CHANGED], 0);
+}
+
+/* A device still to register keeps the old one until it does */
+static gboolean
+connection_decode_device (gpointer object, const GValue *value)
+{
+  CmConnection *connection = CM_CONNECTION (object);
+  CmConnectionPrivate *priv = connection->priv;
+  gchar *path = g_value_get_boxed (value);
+  CmDevice *device;
+
+  device = internal_manager_resolve (priv->manager, REGISTRY_DEVICES, path,
+                                     G_OBJECT (connection),
+                                     connection_device_resolved);
+  if (!device || device == priv->device)
+    return FALSE;
+
+  connection_set_device (connection, device);
+  g_signal_emit (connection, connection_signals[SIGNAL_DEVICE_CHANGED], 0);
+  return TRUE;
+}
+
+/* The network registered after our Network property named it */
+static void
+connection_network_resolved (GObject *object, gpointer network)
+{
+  CmConnection *connection = CM_CONNECTION (object);
+  CmConnectionPrivate *priv = connection->priv;
+
+  if (priv->network)
+    g_object_unref (priv->network);
+  priv->network = g_object_ref (network);
+
+  g_signal_emit (connection, connection_signals[SIGNAL_NETWORK_CHANGED], 0);
+}
 
-    priv->network = internal_network_new (priv->proxy, priv->device, path,
-                                          priv->manager, &error);
+/*
+ * The network is normally one its device already lists, so share that
+ * object, and with it the device's proxy and updates.  A network no
+ * device has listed yet is read into a stand-in of the connection's own
+ * until the device's list registers it, when the registered object takes
+ * the stand-in's place.
+ */
+static gboolean
+connection_decode_network (gpointer object, const GValue *value)
+{
+  CmConnection *connection = CM_CONNECTION (object);
+  CmConnectionPrivate *priv = connection->priv;
+  GError *error = NULL;
+  gchar *path = g_value_get_boxed (value);
+  CmNetwork *network;
 
-    if (!priv->network)
+  network = internal_manager_resolve (priv->manager, REGISTRY_NETWORKS, path,
+                                      G_OBJECT (connection),
+                                      connection_network_resolved);
+
+  /* Unchanged: the same shared object, or our stand-in for the same path */
+  if (network ? network == priv->network :
+      priv->network &&
+      g_strcmp0 (cm_network_get_path (priv->network), path) == 0)
+    return FALSE;
+
+  if (network)
+    g_object_ref (network);
+  else
+  {
+    network = internal_network_new (priv->proxy, priv->device, path,
+                                    priv->manager, &error);
+    if (!network)
     {
       g_debug ("network_new failed in %s: %s\n", __FUNCTION__,
                error->message);
       g_error_free (error);
     }
-    else
-    {
-      g_signal_emit (connection, connection_signals[SIGNAL_NETWORK_CHANGED], 0);
-    }
   }
-  else
+
+  if (priv->network)
+    g_object_unref (priv->network);
+  priv->network = network;
+
+  if (priv->network)
+    g_signal_emit (connection, connection_signals[SIGNAL_NETWORK_CHANGED], 0);
+
+  return TRUE;
+}
+
+#define CONNECTION_FIELD(field) G_STRUCT_OFFSET (CmConnectionPrivate, field)
+
+/* Device and Network only signal when the lookup succeeds */
+static const CmProperty connection_properties[] =
+{
+  { "Interface", PROPERTY_STRING, CONNECTION_FIELD (interface),
+    SIGNAL_INTERFACE_CHANGED, 0, NULL },
+  { "Strength", PROPERTY_BYTE, CONNECTION_FIELD (strength),
+    SIGNAL_STRENGTH_CHANGED, 0, NULL },
+  { "Default", PROPERTY_BOOLEAN, CONNECTION_FIELD (default_connection),
+    SIGNAL_DEFAULT_CHANGED, 0, NULL },
+  { "Type", PROPERTY_CUSTOM, 0,
+    SIGNAL_TYPE_CHANGED, 0, connection_decode_type },
+  { "IPv4.Method", PROPERTY_INTERNED, CONNECTION_FIELD (ipv4_method),
+    SIGNAL_IPV4_METHOD_CHANGED, 0, connection_decode_ipv4_method },
+  { "IPv4.Address", PROPERTY_STRING, CONNECTION_FIELD (ipv4_address),
+    SIGNAL_IPV4_ADDRESS_CHANGED, 0, NULL },
+  { "IPv4.Gateway", PROPERTY_STRING, CONNECTION_FIELD (ipv4_gateway),
+    SIGNAL_IPV4_GATEWAY_CHANGED, 0, NULL },
+  { "IPv4.Broadcast", PROPERTY_STRING, CONNECTION_FIELD (ipv4_broadcast),
+    SIGNAL_IPV4_BROADCAST_CHANGED, 0, NULL },
+  { "IPv4.Nameserver", PROPERTY_STRING, CONNECTION_FIELD (ipv4_nameserver),
+    SIGNAL_IPV4_NAMESERVER_CHANGED, 0, NULL },
+  { "IPv4.Netmask", PROPERTY_STRING, CONNECTION_FIELD (ipv4_netmask),
+    SIGNAL_IPV4_NETMASK_CHANGED, 0, NULL },
+  { "Device", PROPERTY_CUSTOM, 0,
+    -1, 0, connection_decode_device },
+  { "Network", PROPERTY_CUSTOM, 0,
+    -1, 0, connection_decode_network },
+};
+
+static GHashTable *connection_property_table;
+
+static void
+connection_update_property (const gchar *key, GValue *value, CmConnection *connection)
+{
+  CmConnectionPrivate *priv = connection->priv;
+  const CmProperty *property;
+  gboolean changed;
+  gchar *tmp;
+
+  property = internal_property_apply (connection_property_table, connection,
+                                      priv, key, value, &changed);
+  if (!property)
   {
     tmp = g_strdup_value_contents (value);
     g_debug ("Unhandled Connection property on %s: %s = %s\n",
              cm_connection_get_interface (connection), key, tmp);
     g_free (tmp);
+    return;
   }
+
+  if (!changed)
+    return;
+
+  if (property->signal >= 0)
+    g_signal_emit (connection, connection_signals[property->signal], 0);
 }
 
-static void
-connection_property_change_handler_proxy (DBusGProxy *proxy,
-				          const gchar *key,
-				          GValue *value,
-				          gpointer data)
+void
+internal_connection_property_changed (CmConnection *connection,
+                                      const gchar *key, GValue *value)
 {
-  CmConnection *connection = data;
-
+  internal_manager_stats_signal (connection->priv->manager,
+                                 STATS_INTERFACE_CONNECTION);
   connection_update_property (key, value, connection);
 
   connection_emit_updated (connection);
 }
 
-static void
-connection_get_properties_call_notify (DBusGProxy *proxy,
-				   DBusGProxyCall *call,
-				   gpointer data)
+void
+internal_connection_apply_properties (CmConnection *connection, GHashTable *properties)
 {
-  CmConnection *connection = data;
-  GError *error = NULL;
-  GHashTable *properties = NULL;
+  g_hash_table_foreach (properties, (GHFunc)connection_update_property, connection);
+  connection_emit_updated (connection);
+}
 
-  if (!dbus_g_proxy_end_call (
-	proxy, call, &error,
-	/* OUT values */
-	dbus_g_type_get_map ("GHashTable", G_TYPE_STRING, G_TYPE_VALUE),
-	&properties, G_TYPE_INVALID))
+#ifdef CM_TRANSPORT_GDBUS
+/* internal_connection_apply_properties(), from a GetProperties reply */
+void
+internal_connection_apply_variant (CmConnection *connection,
+                                   GVariant *properties)
+{
+  CmConnectionPrivate *priv = connection->priv;
+  const CmProperty *property;
+  GVariantIter iter;
+  const gchar *key;
+  GVariant *value;
+  gboolean changed;
+
+  g_variant_iter_init (&iter, properties);
+  while (g_variant_iter_loop (&iter, "{&sv}", &key, &value))
   {
-    g_debug ("Error calling dbus_g_proxy_end_call in %s: %s\n",
-             __FUNCTION__, error->message);
-    g_error_free (error);
-    return;
+    property = internal_property_apply_variant (connection_property_table,
+                                                connection, priv, key, value,
+                                                &changed);
+    if (!property)
+    {
+      g_debug ("Unhandled Connection property on %s: %s\n",
+               cm_connection_get_interface (connection), key);
+      continue;
+    }
+
+    if (changed && property->signal >= 0)
+      g_signal_emit (connection, connection_signals[property->signal], 0);
   }
 
-  g_hash_table_foreach (properties, (GHFunc)connection_update_property, connection);
-  g_hash_table_unref (properties);
   connection_emit_updated (connection);
 }
+#endif
+
+void
+internal_connection_fetch_properties (CmConnection *connection)
+{
+  CmConnectionPrivate *priv = connection->priv;
+
+  internal_manager_get_properties (priv->manager, G_OBJECT (connection), priv->proxy,
+                                   (CmPropertiesFunc) internal_connection_apply_properties);
+}
 
 CmConnection *
 internal_connection_new (DBusGProxy *proxy, const gchar *path, CmManager *manager, GError **error)
 {
   CmConnection *connection;
   CmConnectionPrivate *priv;
-  DBusGProxyCall *call;
 
   connection = g_object_new (CM_TYPE_CONNECTION, NULL);
   if (!connection)
@@ -307,25 +419,7 @@ internal_connection_new (DBusGProxy *proxy, const gchar *path, CmManager *manage
     return NULL;
   }
 
-  dbus_g_proxy_add_signal (
-    priv->proxy, "PropertyChanged",
-    G_TYPE_STRING, G_TYPE_VALUE, G_TYPE_INVALID);
-
-  dbus_g_proxy_connect_signal (
-    priv->proxy, "PropertyChanged",
-    G_CALLBACK (connection_property_change_handler_proxy),
-    connection, NULL);
-
-  call = dbus_g_proxy_begin_call (priv->proxy, "GetProperties",
-                                  connection_get_properties_call_notify,
-                                  connection, NULL, G_TYPE_INVALID);
-  if (!call)
-  {
-    g_set_error (error, CONNECTION_ERROR, CONNECTION_ERROR_CONNMAN_GET_PROPERTIES,
-                 "Invocation of GetProperties failed.");
-    g_object_unref (connection);
-    return NULL;
-  }
+  internal_connection_fetch_properties (connection);
 
   return connection;
 }
@@ -390,7 +484,14 @@ gchar *
 cm_connection_get_ipv4_method (CmConnection *connection)
 {
   CmConnectionPrivate *priv = connection->priv;
-  return priv->ipv4_method;
+  return (gchar *) priv->ipv4_method;
+}
+
+CmIPv4Method
+cm_connection_get_ipv4_method_enum (CmConnection *connection)
+{
+  CmConnectionPrivate *priv = connection->priv;
+  return priv->ipv4_method_enum;
 }
 
 gchar *
@@ -444,11 +545,6 @@ connection_dispose (GObject *object)
 
   if (priv->proxy)
   {
-    dbus_g_proxy_disconnect_signal (
-    priv->proxy, "PropertyChanged",
-    G_CALLBACK (connection_property_change_handler_proxy),
-    connection);
-
     g_object_unref (priv->proxy);
     priv->proxy = NULL;
   }
@@ -459,15 +555,12 @@ connection_dispose (GObject *object)
     priv->network = NULL;
   }
 
-  if (priv->device)
-  {
-    g_object_unref (priv->device);
-    priv->device = NULL;
-  }
+  /* The device belongs to the manager; we never took a reference */
+  connection_set_device (connection, NULL);
 
   priv->manager = NULL;
 
-  G_OBJECT_CLASS (connection_parent_class)->finalize (object);
+  G_OBJECT_CLASS (connection_parent_class)->dispose (object);
 }
 
 static void
@@ -476,8 +569,8 @@ connection_finalize (GObject *object)
   CmConnection *connection = CM_CONNECTION (object);
   CmConnectionPrivate *priv = connection->priv;
 
+  g_free (priv->path);
   g_free (priv->interface);
-  g_free (priv->ipv4_method);
   g_free (priv->ipv4_address);
   g_free (priv->ipv4_gateway);
   g_free (priv->ipv4_broadcast);
@@ -498,6 +591,7 @@ connection_init (CmConnection *self)
   self->priv->device = NULL;
   self->priv->network = NULL;
   self->priv->ipv4_method = NULL;
+  self->priv->ipv4_method_enum = IPV4_METHOD_UNKNOWN;
   self->priv->ipv4_address = NULL;
   self->priv->ipv4_gateway = NULL;
   self->priv->ipv4_broadcast = NULL;
@@ -620,6 +714,9 @@ connection_class_init (CmConnectionClass *klass)
     G_TYPE_NONE, 0);
 
   g_type_class_add_private (gobject_class, sizeof (CmConnectionPrivate));
+
+  connection_property_table = internal_property_table_new (
+    connection_properties, G_N_ELEMENTS (connection_properties));
 }
 
 const gchar *
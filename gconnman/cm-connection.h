@@ -92,6 +92,7 @@ gboolean cm_connection_get_default (CmConnection *connection);
 CmDevice *cm_connection_get_device (CmConnection *connection);
 CmNetwork *cm_connection_get_network (CmConnection *connection);
 gchar *cm_connection_get_ipv4_method (CmConnection *connection);
+CmIPv4Method cm_connection_get_ipv4_method_enum (CmConnection *connection);
 gchar *cm_connection_get_ipv4_address (CmConnection *connection);
 gchar *cm_connection_get_ipv4_gateway (CmConnection *connection);
 gchar *cm_connection_get_ipv4_broadcast (CmConnection *connection);
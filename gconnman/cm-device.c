@@ -61,13 +61,11 @@ struct _CmDevicePrivate
   gchar *iface;
 
   gboolean powered;
-  gchar *ipv4_method;
+  const gchar *ipv4_method; /* interned */
   gchar *address;
   guint scan_interval;
 };
 
-static void device_property_change_handler_proxy (DBusGProxy *, const gchar *,
-						  GValue *, gpointer);
 enum
 {
   SIGNAL_UPDATE,
@@ -92,204 +90,275 @@ device_error_quark (void)
 }
 
 static void
-device_emit_updated (CmDevice *device)
+device_flush_updated (CmDevice *device)
 {
   g_signal_emit (device, device_signals[SIGNAL_UPDATE], 0 /* detail */);
 }
 
+static void
+device_emit_updated (CmDevice *device)
+{
+  CmDevicePrivate *priv = device->priv;
+
+  if (!priv->manager ||
+      !internal_manager_queue_update (priv->manager, G_OBJECT (device),
+                                      (CmUpdateFunc) device_flush_updated))
+    device_flush_updated (device);
+}
+
+/*
+ * The lookup goes through the manager-wide registry rather than walking
+ * our list, but only answers with a network of this device.  A device
+ * without a manager still has its list.
+ */
 CmNetwork *
 cm_device_find_network (CmDevice *device, const gchar *opath)
 {
   CmDevicePrivate *priv = device->priv;
-  CmNetwork *network = NULL;
+  CmNetwork *network;
   GList *iter;
-  const gchar *npath;
+
+  if (priv->manager)
+  {
+    network = cm_manager_find_network (priv->manager, opath);
+    if (network && cm_network_get_device (network) == device)
+      return network;
+    return NULL;
+  }
 
   for (iter = priv->networks; iter != NULL; iter = iter->next)
   {
     network = iter->data;
-    npath = cm_network_get_path (network);
-
-    if (g_strcmp0 (opath, npath) == 0)
+    if (g_strcmp0 (opath, cm_network_get_path (network)) == 0)
       return network;
   }
 
   return NULL;
 }
 
-static void
-device_update_property (const gchar *key, GValue *value, CmDevice *device)
+static gpointer
+device_network_new (const gchar *path, guint position, gpointer data)
 {
+  CmDevice *device = data;
   CmDevicePrivate *priv = device->priv;
-  gchar *tmp;
+  CmNetwork *network;
+  GError *error = NULL;
 
-  if (!strcmp ("Networks", key))
+  network = internal_network_new (priv->proxy, device, path, priv->manager,
+                                  &error);
+  if (!network)
   {
-    GPtrArray *networks = g_value_get_boxed (value);
-    gint i;
-    const gchar *path = NULL;
-    GList *iter;
+    g_debug ("network_new failed in %s: %s", __FUNCTION__, error->message);
+    g_error_free (error);
+  }
 
-    /* First remove stale networks */
-    for (iter = priv->networks; iter != NULL; iter = iter->next)
-    {
-      CmNetwork *net = iter->data;
-      gboolean found = FALSE;
-
-      for (i = 0; i < networks->len && !found; i++)
-      {
-        path = g_ptr_array_index (networks, i);
-
-        if (g_strcmp0 (path, cm_network_get_path (net)) == 0)
-        {
-          found = TRUE;
-        }
-      }
-
-      /* If net not in networks (found = FALSE) delete form priv->networks */
-      if (!found)
-      {
-        priv->networks = g_list_delete_link (priv->networks, iter);
-      }
-    }
+  return network;
+}
 
-    /* iterate networks and add new networks to priv->networks*/
-    for (i = 0; i < networks->len; i++)
-    {
-      path = g_ptr_array_index (networks, i);
-      CmNetwork *network;
-      GError *error = NULL;
-
-      network = cm_device_find_network (device, path);
-      if (!network)
-      {
-        network = internal_network_new (priv->proxy, device, path,
-                                        priv->manager, &error);
-        if (!network)
-        {
-          g_debug ("network_new failed in %s: %s", __FUNCTION__,
-                   error->message);
-          g_error_free (error);
-          continue;
-        }
-        else
-        {
-          priv->networks = g_list_append (priv->networks, network);
-        }
-      }
-    }
+static gboolean
+device_decode_networks (gpointer object, const GValue *value)
+{
+  CmDevice *device = CM_DEVICE (object);
+  CmDevicePrivate *priv = device->priv;
+  CmReconcileResult result;
+  gboolean changed;
+
+  internal_manager_reconcile (priv->manager, REGISTRY_NETWORKS,
+                              &priv->networks, g_value_get_boxed (value),
+                              device_network_new, device, &result);
+  changed = result.added || result.removed || result.moved;
+  g_list_free (result.added);
+  g_list_foreach (result.removed, (GFunc) g_object_unref, NULL);
+  g_list_free (result.removed);
+  g_list_free (result.moved);
+
+  return changed;
+}
 
-    g_signal_emit (device, device_signals[SIGNAL_NETWORKS_CHANGED], 0);
-  }
-  else if (!strcmp ("Scanning", key))
-  {
-    priv->scanning = g_value_get_boolean (value);
-    g_signal_emit (device, device_signals[SIGNAL_SCANNING_CHANGED], 0);
-  }
-  else if (!strcmp ("Name", key))
-  {
-    g_free (priv->name);
-    priv->name = g_value_dup_string (value);
-    g_signal_emit (device, device_signals[SIGNAL_NAME_CHANGED], 0);
-  }
-  else if (!strcmp ("Interface", key))
-  {
-    g_free (priv->iface);
-    priv->iface = g_value_dup_string (value);
-    g_signal_emit (device, device_signals[SIGNAL_INTERFACE_CHANGED], 0);
-  }
-  else if (!strcmp ("Type", key))
-  {
-    const gchar *type;
-    type = g_value_get_string (value);
-    if (!strcmp (type, "wifi"))
-      priv->type = DEVICE_WIFI;
-    else if (!strcmp (type, "wimax"))
-      priv->type = DEVICE_WIMAX;
-    else if (!strcmp (type, "bluetooth"))
-      priv->type = DEVICE_BLUETOOTH;
-    else if (!strcmp (type, "cellular"))
-      priv->type = DEVICE_CELLULAR;
-    else if (!strcmp (type, "ethernet"))
-      priv->type = DEVICE_ETHERNET;
-    else
-    {
-      g_debug ("Unknown device type on %s: %s\n",
-               cm_device_get_name (device), type);
-      priv->type = DEVICE_UNKNOWN;
-    }
-    g_signal_emit (device, device_signals[SIGNAL_TYPE_CHANGED], 0);
-  }
-  else if (!strcmp ("Powered", key))
-  {
-    priv->powered = g_value_get_boolean (value);
-    g_signal_emit (device, device_signals[SIGNAL_POWERED_CHANGED], 0);
-  }
-  else if (!strcmp ("IPv4.Method", key))
-  {
-    g_free (priv->ipv4_method);
-    priv->ipv4_method = g_value_dup_string (value);
-    g_signal_emit (device, device_signals[SIGNAL_METHOD_CHANGED], 0);
-  }
-  else if (!strcmp ("ScanInterval", key))
-  {
-    priv->scan_interval = g_value_get_uint (value);
-    g_signal_emit (device, device_signals[SIGNAL_SCAN_INTERVAL_CHANGED], 0);
-  }
-  else if (!strcmp ("Address", key))
+static const struct
+{
+  const gchar *name;
+  CmDeviceType type;
+} device_types[] =
+{
+  { "wifi", DEVICE_WIFI },
+  { "wimax", DEVICE_WIMAX },
+  { "bluetooth", DEVICE_BLUETOOTH },
+  { "cellular", DEVICE_CELLULAR },
+  { "ethernet", DEVICE_ETHERNET },
+};
+
+/* Also used for the manager's technology names, which are the same */
+CmDeviceType
+internal_device_type_from_string (const gchar *type)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (device_types); i++)
   {
-    g_free (priv->address);
-    priv->address = g_value_dup_string (value);
-    g_signal_emit (device, device_signals[SIGNAL_ADDRESS_CHANGED], 0);
+    if (!strcmp (type, device_types[i].name))
+      return device_types[i].type;
   }
-  else
+
+  return DEVICE_UNKNOWN;
+}
+
+static gboolean
+device_decode_type (gpointer object, const GValue *value)
+{
+  CmDevice *device = CM_DEVICE (object);
+  CmDevicePrivate *priv = device->priv;
+  CmDeviceType old = priv->type;
+  const gchar *type;
+
+  type = g_value_get_string (value);
+  priv->type = internal_device_type_from_string (type);
+
+  if (priv->type == DEVICE_UNKNOWN)
+    g_debug ("Unknown device type on %s: %s\n",
+             cm_device_get_name (device), type);
+
+  return priv->type != old;
+}
+
+#define DEVICE_FIELD(field) G_STRUCT_OFFSET (CmDevicePrivate, field)
+
+static const CmProperty device_properties[] =
+{
+  { "Networks", PROPERTY_CUSTOM, 0,
+    SIGNAL_NETWORKS_CHANGED, 0, device_decode_networks },
+  { "Scanning", PROPERTY_BOOLEAN, DEVICE_FIELD (scanning),
+    SIGNAL_SCANNING_CHANGED, 0, NULL },
+  { "Name", PROPERTY_STRING, DEVICE_FIELD (name),
+    SIGNAL_NAME_CHANGED, 0, NULL },
+  { "Interface", PROPERTY_STRING, DEVICE_FIELD (iface),
+    SIGNAL_INTERFACE_CHANGED, 0, NULL },
+  { "Type", PROPERTY_CUSTOM, 0,
+    SIGNAL_TYPE_CHANGED, 0, device_decode_type },
+  { "Powered", PROPERTY_BOOLEAN, DEVICE_FIELD (powered),
+    SIGNAL_POWERED_CHANGED, 0, NULL },
+  { "IPv4.Method", PROPERTY_INTERNED, DEVICE_FIELD (ipv4_method),
+    SIGNAL_METHOD_CHANGED, 0, NULL },
+  { "ScanInterval", PROPERTY_UINT, DEVICE_FIELD (scan_interval),
+    SIGNAL_SCAN_INTERVAL_CHANGED, 0, NULL },
+  { "Address", PROPERTY_STRING, DEVICE_FIELD (address),
+    SIGNAL_ADDRESS_CHANGED, 0, NULL },
+};
+
+static GHashTable *device_property_table;
+
+static void
+device_update_property (const gchar *key, GValue *value, CmDevice *device)
+{
+  CmDevicePrivate *priv = device->priv;
+  const CmProperty *property;
+  gboolean changed;
+  gchar *tmp;
+
+  property = internal_property_apply (device_property_table, device, priv,
+                                      key, value, &changed);
+  if (!property)
   {
     tmp = g_strdup_value_contents (value);
     g_debug ("Unhandled Device property on %s: %s = %s\n",
              cm_device_get_name (device), key, tmp);
     g_free (tmp);
+    return;
   }
-}
 
+  if (!changed)
+    return;
 
-static void
-device_property_change_handler_proxy (DBusGProxy *proxy,
-				      const gchar *key,
-				      GValue *value,
-				      gpointer data)
-{
-  CmDevice *device = data;
+  g_signal_emit (device, device_signals[property->signal], 0);
+}
 
+void
+internal_device_property_changed (CmDevice *device, const gchar *key,
+                                  GValue *value)
+{
+  internal_manager_stats_signal (device->priv->manager,
+                                 STATS_INTERFACE_DEVICE);
   device_update_property (key, value, device);
 
   device_emit_updated (device);
 }
 
-static void
-device_get_properties_call_notify (DBusGProxy *proxy,
-				   DBusGProxyCall *call,
-				   gpointer data)
+void
+internal_device_apply_properties (CmDevice *device, GHashTable *properties)
 {
-  CmDevice *device = data;
-  GError *error = NULL;
-  GHashTable *properties = NULL;
+  g_hash_table_foreach (properties, (GHFunc)device_update_property, device);
+  device_emit_updated (device);
+}
 
-  if (!dbus_g_proxy_end_call (
-	proxy, call, &error,
-	/* OUT values */
-	dbus_g_type_get_map ("GHashTable", G_TYPE_STRING, G_TYPE_VALUE),
-	&properties, G_TYPE_INVALID))
+#ifdef CM_TRANSPORT_GDBUS
+/* internal_device_apply_properties(), from a GetProperties reply */
+void
+internal_device_apply_variant (CmDevice *device, GVariant *properties)
+{
+  CmDevicePrivate *priv = device->priv;
+  const CmProperty *property;
+  GVariantIter iter;
+  const gchar *key;
+  GVariant *value;
+  gboolean changed;
+
+  g_variant_iter_init (&iter, properties);
+  while (g_variant_iter_loop (&iter, "{&sv}", &key, &value))
   {
-    g_debug ("Error calling dbus_g_proxy_end_call in %s: %s\n",
-             __FUNCTION__, error->message);
-    g_clear_error (&error);
-    return;
+    property = internal_property_apply_variant (device_property_table, device,
+                                                priv, key, value, &changed);
+    if (!property)
+    {
+      g_debug ("Unhandled Device property on %s: %s\n",
+               cm_device_get_name (device), key);
+      continue;
+    }
+
+    if (changed)
+      g_signal_emit (device, device_signals[property->signal], 0);
   }
 
-  g_hash_table_foreach (properties, (GHFunc)device_update_property, device);
-  g_hash_table_unref (properties);
   device_emit_updated (device);
 }
+#endif
+
+/* The inverse of device_update_property, for snapshots */
+void
+internal_device_export_properties (CmDevice *device, GHashTable *values)
+{
+  CmDevicePrivate *priv = device->priv;
+  GPtrArray *paths;
+  GList *iter;
+  guint i;
+
+  internal_property_export (device_property_table, priv, values);
+
+  for (i = 0; i < G_N_ELEMENTS (device_types); i++)
+  {
+    if (device_types[i].type == priv->type)
+      g_value_set_string (
+        internal_property_values_add (values, "Type", G_TYPE_STRING),
+        device_types[i].name);
+  }
+
+  paths = g_ptr_array_new ();
+  for (iter = priv->networks; iter != NULL; iter = iter->next)
+    g_ptr_array_add (paths, g_strdup (cm_network_get_path (iter->data)));
+  g_value_take_boxed (
+    internal_property_values_add (
+      values, "Networks",
+      dbus_g_type_get_collection ("GPtrArray", DBUS_TYPE_G_OBJECT_PATH)),
+    paths);
+}
+
+void
+internal_device_fetch_properties (CmDevice *device)
+{
+  CmDevicePrivate *priv = device->priv;
+
+  internal_manager_get_properties (priv->manager, G_OBJECT (device), priv->proxy,
+                                   (CmPropertiesFunc) internal_device_apply_properties);
+}
 
 CmDevice *
 internal_device_new (DBusGProxy *proxy, const gchar *path, CmManager *manager,
@@ -297,7 +366,6 @@ internal_device_new (DBusGProxy *proxy, const gchar *path, CmManager *manager,
 {
   CmDevice *device;
   CmDevicePrivate *priv;
-  DBusGProxyCall *call;
 
   device = g_object_new (CM_TYPE_DEVICE, NULL);
   if (!device)
@@ -331,25 +399,7 @@ internal_device_new (DBusGProxy *proxy, const gchar *path, CmManager *manager,
     return NULL;
   }
 
-  dbus_g_proxy_add_signal (
-    priv->proxy, "PropertyChanged",
-    G_TYPE_STRING, G_TYPE_VALUE, G_TYPE_INVALID);
-
-  dbus_g_proxy_connect_signal (
-    priv->proxy, "PropertyChanged",
-    G_CALLBACK (device_property_change_handler_proxy),
-    device, NULL);
-
-  call = dbus_g_proxy_begin_call (priv->proxy, "GetProperties",
-                                  device_get_properties_call_notify, device,
-                                  NULL, G_TYPE_INVALID);
-  if (!call)
-  {
-    g_set_error (error, DEVICE_ERROR, DEVICE_ERROR_CONNMAN_GET_PROPERTIES,
-                 "Invocation of GetProperties failed.");
-    g_object_unref (device);
-    return NULL;
-  }
+  internal_device_fetch_properties (device);
 
   return device;
 }
@@ -390,7 +440,7 @@ device_propose_scan_call_notify (DBusGProxy *proxy,
 {
   GError *error = NULL;
 
-  if (!dbus_g_proxy_end_call (proxy, call, &error, G_TYPE_INVALID))
+  if (!internal_stats_end_call (proxy, call, data, &error))
   {
     g_debug ("Error calling dbus_g_proxy_end_call in %s: %s\n",
              __FUNCTION__, error->message);
@@ -418,8 +468,12 @@ cm_device_scan (CmDevice *device)
   }
 
   call = dbus_g_proxy_begin_call (priv->proxy, "ProposeScan",
-                                  device_propose_scan_call_notify, device,
-                                  NULL, G_TYPE_INVALID);
+                                  device_propose_scan_call_notify,
+                                  internal_manager_stats_call (
+                                    priv->manager, STATS_INTERFACE_DEVICE,
+                                    STATS_METHOD_PROPOSE_SCAN, device),
+                                  internal_stats_call_free,
+                                  G_TYPE_INVALID);
   if (!call)
   {
     g_debug ("Net scanning on %s - ProposeScan failed.\n",
@@ -430,15 +484,62 @@ cm_device_scan (CmDevice *device)
   return TRUE;
 }
 
+/* Ask for a scan; devices that cannot scan fail with G_IO_ERROR_NOT_SUPPORTED */
+void
+cm_device_scan_async (CmDevice *device, gint timeout,
+                      GCancellable *cancellable,
+                      GAsyncReadyCallback callback, gpointer user_data)
+{
+  CmDevicePrivate *priv = device->priv;
+  CmAsyncCall *async;
+  DBusGProxyCall *call;
+
+  switch (priv->type)
+  {
+  case DEVICE_WIFI:
+  case DEVICE_WIMAX:
+  case DEVICE_BLUETOOTH:
+  case DEVICE_CELLULAR:
+    break;
+
+  case DEVICE_UNKNOWN:
+  case DEVICE_ETHERNET:
+    internal_async_report (device, callback, user_data, cm_device_scan_async,
+                           g_error_new (G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                                        "%s can not scan",
+                                        cm_device_get_name (device)));
+    return;
+  }
+
+  async = internal_async_call_new (device, "ProposeScan",
+                                   internal_manager_stats_call (
+                                     priv->manager, STATS_INTERFACE_DEVICE,
+                                     STATS_METHOD_PROPOSE_SCAN, NULL),
+                                   cancellable, callback, user_data,
+                                   cm_device_scan_async);
+  call = dbus_g_proxy_begin_call_with_timeout (priv->proxy, "ProposeScan",
+                                               internal_async_call_notify,
+                                               async, internal_async_call_free,
+                                               timeout, G_TYPE_INVALID);
+  internal_async_call_start (async, priv->proxy, call);
+}
+
+gboolean
+cm_device_scan_finish (CmDevice *device, GAsyncResult *result,
+                       GError **error)
+{
+  return internal_async_finish (device, result, cm_device_scan_async, error);
+}
+
 static void
 device_set_property_call_notify (DBusGProxy *proxy,
                                  DBusGProxyCall *call,
                                  gpointer data)
 {
-  CmDevice *device = data;
+  CmDevice *device = internal_stats_call_data (data);
   GError *error = NULL;
 
-  if (!dbus_g_proxy_end_call (proxy, call, &error, G_TYPE_INVALID))
+  if (!internal_stats_end_call (proxy, call, data, &error))
   {
     g_debug ("Error calling dbus_g_proxy_end_call in %s on %s: %s\n",
              __FUNCTION__, cm_device_get_name (device), error->message);
@@ -454,8 +555,12 @@ device_set_property (CmDevice *device, const gchar *property, GValue *value)
   DBusGProxyCall *call;
 
   call = dbus_g_proxy_begin_call (priv->proxy, "SetProperty",
-                                  device_set_property_call_notify, device,
-                                  NULL, G_TYPE_STRING, property,
+                                  device_set_property_call_notify,
+                                  internal_manager_stats_call (
+                                    priv->manager, STATS_INTERFACE_DEVICE,
+                                    STATS_METHOD_SET_PROPERTY, device),
+                                  internal_stats_call_free,
+                                  G_TYPE_STRING, property,
                                   G_TYPE_VALUE, value, G_TYPE_INVALID);
 
   if (!call)
@@ -554,11 +659,6 @@ device_dispose (GObject *object)
 
   if (priv->proxy)
   {
-    dbus_g_proxy_disconnect_signal (
-      priv->proxy, "PropertyChanged",
-      G_CALLBACK (device_property_change_handler_proxy),
-      device);
-
     g_object_unref (priv->proxy);
     priv->proxy = NULL;
   }
@@ -575,7 +675,6 @@ device_finalize (GObject *object)
   CmDevicePrivate *priv = device->priv;
 
   g_free (priv->path);
-  g_free (priv->ipv4_method);
   g_free (priv->address);
   g_free (priv->iface);
   g_free (priv->name);
@@ -687,6 +786,9 @@ device_class_init (CmDeviceClass *klass)
     G_TYPE_NONE, 0);
 
   g_type_class_add_private (gobject_class, sizeof (CmDevicePrivate));
+
+  device_property_table = internal_property_table_new (
+    device_properties, G_N_ELEMENTS (device_properties));
 }
 
 const gchar *
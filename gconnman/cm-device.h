@@ -92,6 +92,11 @@ gchar *cm_device_get_address (CmDevice *device);
 gboolean cm_device_set_scan_interval (CmDevice *device, guint interval);
 
 gboolean cm_device_scan (CmDevice *device);
+void cm_device_scan_async (CmDevice *device, gint timeout,
+                           GCancellable *cancellable,
+                           GAsyncReadyCallback callback, gpointer user_data);
+gboolean cm_device_scan_finish (CmDevice *device, GAsyncResult *result,
+                                GError **error);
 
 G_END_DECLS
 
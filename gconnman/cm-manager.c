@@ -40,15 +40,66 @@ struct _CmManagerPrivate
 {
   DBusGConnection *connection;
   DBusGProxy *proxy;
+  DBusGProxy *bus_proxy; /* the bus itself, for NameOwnerChanged */
+#ifdef CM_TRANSPORT_GDBUS
+  /* GetProperties replies and every signal are read over this */
+  GDBusConnection *gdbus;
+  guint property_subscription;
+  guint owner_subscription;
+#endif
   gboolean offline_mode;
   GList *devices;
   GList *services;
   GList *connections;
-  GList *available_technologies;
-  GList *connected_technologies;
-  GList *enabled_technologies;
+  CmTechnologies available_technologies;
+  CmTechnologies connected_technologies;
+  CmTechnologies enabled_technologies;
   gchar *state;
   gboolean low_level;
+  gboolean lazy_services;
+
+  /* Object registry, keyed by the interned (GQuark) object path */
+  GHashTable *index[REGISTRY_LAST];
+
+  /*
+   * References waiting for an object to register, by kind: path quark ->
+   * GSList of CmPendingRef, and waiting object -> its CmPendingRef
+   */
+  GHashTable *pending[REGISTRY_LAST];
+  GHashTable *pending_waiters[REGISTRY_LAST];
+
+  /* Ranking fields of every service, packed */
+  CmServiceTable *service_table;
+
+  /* Whether manager_property_filter is installed on the connection */
+  gboolean filtering;
+
+  /* Coalesced "*-updated" emission: object -> CmUpdateFunc */
+  gboolean coalesce;
+  GHashTable *pending_updates;
+  guint update_idle;
+
+  /* Batched GetProperties: queued CmFetch, and the calls on the wire */
+  GQueue *fetch_queue;
+  GList *fetch_in_flight;
+  guint n_in_flight;
+  gboolean ready;
+
+  /* Incremental refresh: keep live objects and re-read the survivors */
+  gboolean incremental_refresh;
+  gboolean refreshing;
+
+  /* Objects restored from a snapshot wait for the next refresh */
+  gboolean loading_snapshot;
+  gboolean snapshot_loaded;
+
+  /* D-Bus traffic counters, shared with calls still in flight */
+  CmStatsCounters *stats;
+
+  /* Strength filter settings */
+  guint strength_min_delta;
+  guint strength_hysteresis;
+  guint strength_interval;  /* milliseconds */
 };
 
 static void manager_property_change_handler_proxy (DBusGProxy *, const gchar *,
@@ -64,6 +115,13 @@ enum
   SIGNAL_AVAILABLE_TECHNOLOGIES_CHANGED,
   SIGNAL_CONNECTED_TECHNOLOGIES_CHANGED,
   SIGNAL_ENABLED_TECHNOLOGIES_CHANGED,
+  SIGNAL_DEVICES_DELTA,
+  SIGNAL_SERVICES_DELTA,
+  SIGNAL_CONNECTIONS_DELTA,
+  SIGNAL_AVAILABLE_TECHNOLOGIES_DELTA,
+  SIGNAL_CONNECTED_TECHNOLOGIES_DELTA,
+  SIGNAL_ENABLED_TECHNOLOGIES_DELTA,
+  SIGNAL_READY,
   SIGNAL_LAST
 };
 
@@ -76,426 +134,1433 @@ manager_error_quark (void)
 }
 
 static void
-manager_emit_updated (CmManager *manager)
+manager_flush_updated (CmManager *manager)
 {
   g_signal_emit (manager, manager_signals[SIGNAL_UPDATE], 0 /* detail */);
 }
 
-CmDevice *
-cm_manager_find_device (CmManager *manager, const gchar *opath)
+static void
+manager_emit_updated (CmManager *manager)
+{
+  if (!internal_manager_queue_update (manager, G_OBJECT (manager),
+                                      (CmUpdateFunc) manager_flush_updated))
+    manager_flush_updated (manager);
+}
+
+static void
+manager_flush_pending_updates (CmManager *manager)
+{
+  CmManagerPrivate *priv = manager->priv;
+  GHashTable *pending = priv->pending_updates;
+  GHashTableIter iter;
+  gpointer object, flush;
+
+  if (priv->update_idle)
+  {
+    g_source_remove (priv->update_idle);
+    priv->update_idle = 0;
+  }
+
+  /* Handlers may queue more updates; those go out on the next iteration */
+  priv->pending_updates = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  g_hash_table_iter_init (&iter, pending);
+  while (g_hash_table_iter_next (&iter, &object, &flush))
+  {
+    ((CmUpdateFunc) flush) (object);
+    g_object_unref (object);
+  }
+
+  g_hash_table_destroy (pending);
+}
+
+static gboolean
+manager_update_idle_cb (gpointer data)
+{
+  CmManager *manager = data;
+
+  manager->priv->update_idle = 0;
+  manager_flush_pending_updates (manager);
+
+  return FALSE;
+}
+
+/*
+ * When coalescing is enabled, queue object's "*-updated" emission for the
+ * next idle iteration instead of emitting it right away.  An object is
+ * only queued once per iteration however many properties change, and
+ * flush is responsible for emitting whatever has accumulated.  Returns
+ * FALSE when coalescing is off and the caller should emit directly.
+ */
+gboolean
+internal_manager_queue_update (CmManager *manager, GObject *object,
+                               CmUpdateFunc flush)
+{
+  CmManagerPrivate *priv = manager->priv;
+
+  if (!priv->coalesce)
+    return FALSE;
+
+  if (!g_hash_table_lookup (priv->pending_updates, object))
+    g_hash_table_insert (priv->pending_updates, g_object_ref (object), flush);
+
+  if (!priv->update_idle)
+    priv->update_idle = g_idle_add (manager_update_idle_cb, manager);
+
+  return TRUE;
+}
+
+void
+cm_manager_set_coalesce_updates (CmManager *manager, gboolean coalesce)
+{
+  CmManagerPrivate *priv = manager->priv;
+
+  priv->coalesce = coalesce;
+  if (!coalesce)
+    manager_flush_pending_updates (manager);
+}
+
+gboolean
+cm_manager_get_coalesce_updates (CmManager *manager)
+{
+  CmManagerPrivate *priv = manager->priv;
+  return priv->coalesce;
+}
+
+/*
+ * Strength filter
+ *
+ * Networks and services pass every Strength they are told about through
+ * internal_manager_filter_strength() before publishing it.  A change is
+ * published when it is at least min_delta from the published value, plus
+ * hysteresis if it reverses the direction of the last published change,
+ * and no sooner than interval after the last one; a change held back by
+ * the interval alone is published once the interval is up, unless a
+ * later value cancels it.  The first value, and changes to or from 0,
+ * skip the delta checks.  All zero, the default, publishes everything.
+ */
+void
+cm_manager_set_strength_filter (CmManager *manager, guint min_delta,
+                                guint hysteresis, guint interval)
+{
+  CmManagerPrivate *priv = manager->priv;
+
+  priv->strength_min_delta = min_delta;
+  priv->strength_hysteresis = hysteresis;
+  priv->strength_interval = interval;
+}
+
+void
+cm_manager_get_strength_filter (CmManager *manager, guint *min_delta,
+                                guint *hysteresis, guint *interval)
+{
+  CmManagerPrivate *priv = manager->priv;
+
+  if (min_delta)
+    *min_delta = priv->strength_min_delta;
+  if (hysteresis)
+    *hysteresis = priv->strength_hysteresis;
+  if (interval)
+    *interval = priv->strength_interval;
+}
+
+void
+internal_strength_filter_init (CmStrengthFilter *filter, gpointer object,
+                               CmStrengthFunc publish)
+{
+  filter->object = object;
+  filter->publish = publish;
+  filter->known = FALSE;
+  filter->value = 0;
+  filter->pending = 0;
+  filter->direction = 0;
+  filter->published = 0;
+  filter->timeout = 0;
+}
+
+void
+internal_strength_filter_clear (CmStrengthFilter *filter)
+{
+  if (filter->timeout)
+  {
+    g_source_remove (filter->timeout);
+    filter->timeout = 0;
+  }
+}
+
+/* Seconds on a clock shared by every manager, as filters may outlive theirs */
+static gdouble
+manager_strength_now (void)
+{
+  static GTimer *timer = NULL;
+
+  if (!timer)
+    timer = g_timer_new ();
+
+  return g_timer_elapsed (timer, NULL);
+}
+
+static void
+manager_strength_published (CmStrengthFilter *filter, guchar value)
+{
+  internal_strength_filter_clear (filter);
+
+  if (filter->known && value != filter->value)
+    filter->direction = value > filter->value ? 1 : -1;
+  filter->known = TRUE;
+  filter->value = value;
+  filter->published = manager_strength_now ();
+}
+
+static gboolean
+manager_strength_timeout_cb (gpointer data)
+{
+  CmStrengthFilter *filter = data;
+
+  filter->timeout = 0;
+  manager_strength_published (filter, filter->pending);
+  filter->publish (filter->object, filter->value);
+
+  return FALSE;
+}
+
+/* Returns whether value should be published now */
+gboolean
+internal_manager_filter_strength (CmManager *manager, CmStrengthFilter *filter,
+                                  guchar value)
+{
+  CmManagerPrivate *priv;
+  guint delta, needed;
+  gint direction;
+  gdouble wait;
+  gboolean changed;
+
+  if (!manager || !filter->known)
+  {
+    changed = value != filter->value;
+    manager_strength_published (filter, value);
+    return changed;
+  }
+
+  priv = manager->priv;
+
+  if (value == filter->value)
+  {
+    /* Back where it was: whatever was held back is no longer news */
+    internal_strength_filter_clear (filter);
+    return FALSE;
+  }
+
+  delta = ABS ((gint) value - (gint) filter->value);
+  direction = value > filter->value ? 1 : -1;
+  needed = priv->strength_min_delta;
+  if (filter->direction && direction != filter->direction)
+    needed += priv->strength_hysteresis;
+
+  if (delta < needed && value != 0 && filter->value != 0)
+  {
+    internal_strength_filter_clear (filter);
+    return FALSE;
+  }
+
+  wait = filter->published + priv->strength_interval / 1000.0 -
+         manager_strength_now ();
+  if (priv->strength_interval && wait > 0)
+  {
+    filter->pending = value;
+    if (!filter->timeout)
+      filter->timeout = g_timeout_add (wait * 1000 + 1,
+                                       manager_strength_timeout_cb, filter);
+    return FALSE;
+  }
+
+  manager_strength_published (filter, value);
+  return TRUE;
+}
+
+/*
+ * Batched GetProperties
+ *
+ * Every object fetches its properties through the manager rather than
+ * calling GetProperties itself, so that a refresh or a daemon restart
+ * pipelines its calls with at most MANAGER_FETCH_WINDOW of them on the
+ * bus at once.  Replies are applied as they arrive; once the queue has
+ * drained, and no reply has queued further objects, the manager is ready
+ * and emits "manager-ready".
+ */
+#define MANAGER_FETCH_WINDOW 16
+
+typedef struct
+{
+  CmManager *manager;
+  GObject *object;
+  DBusGProxy *proxy;
+  DBusGProxyCall *call;
+  CmPropertiesFunc apply;
+  CmFetchDoneFunc done;
+  GError *error;      /* why the properties were not applied */
+  gboolean applied;
+  CmStatsInterface iface;
+  CmStatsCall *stats;
+#ifdef CM_TRANSPORT_GDBUS
+  GCancellable *cancellable;
+#endif
+} CmFetch;
+
+static void manager_fetch_pump (CmManager *manager);
+
+static void
+manager_fetch_free (CmFetch *fetch)
+{
+  if (fetch->done)
+  {
+    /* Dropped from the queue, cancelled or never made */
+    if (!fetch->applied && !fetch->error)
+      fetch->error = g_error_new (DBUS_GERROR, DBUS_GERROR_NO_REPLY,
+                                  "No reply to GetProperties on %s",
+                                  dbus_g_proxy_get_path (fetch->proxy));
+
+    fetch->done (fetch->object, fetch->applied ? NULL : fetch->error);
+  }
+  g_clear_error (&fetch->error);
+
+  if (fetch->stats)
+    internal_stats_call_free (fetch->stats);
+#ifdef CM_TRANSPORT_GDBUS
+  if (fetch->cancellable)
+    g_object_unref (fetch->cancellable);
+#endif
+  g_object_unref (fetch->proxy);
+  g_object_unref (fetch->object);
+  g_slice_free (CmFetch, fetch);
+}
+
+#ifndef CM_TRANSPORT_GDBUS
+static void
+manager_fetch_call_notify (DBusGProxy *proxy,
+                           DBusGProxyCall *call,
+                           gpointer data)
+{
+  CmFetch *fetch = data;
+  CmManager *manager = fetch->manager;
+  CmManagerPrivate *priv = manager->priv;
+  GError *error = NULL;
+  GHashTable *properties = NULL;
+  gboolean ok;
+
+  priv->fetch_in_flight = g_list_remove (priv->fetch_in_flight, fetch);
+  priv->n_in_flight--;
+
+  ok = dbus_g_proxy_end_call (
+    proxy, call, &error,
+    /* OUT values */
+    dbus_g_type_get_map ("GHashTable", G_TYPE_STRING, G_TYPE_VALUE),
+    &properties, G_TYPE_INVALID);
+  internal_stats_call_done (fetch->stats, ok);
+
+  if (!ok)
+  {
+    g_debug ("Error calling dbus_g_proxy_end_call in %s on %s: %s\n",
+             __FUNCTION__, dbus_g_proxy_get_path (proxy), error->message);
+    fetch->error = error;
+  }
+  else
+  {
+    fetch->apply (fetch->object, properties);
+    fetch->applied = TRUE;
+    g_hash_table_unref (properties);
+  }
+
+  manager_fetch_free (fetch);
+  manager_fetch_pump (manager);
+}
+#else
+/*
+ * With GDBus the reply is applied straight from its GVariant, without
+ * the GHashTable of GValues dbus-glib would build.
+ */
+static void
+manager_fetch_apply_variant (GObject *object, GVariant *properties)
+{
+  if (CM_IS_MANAGER (object))
+    internal_manager_apply_variant (CM_MANAGER (object), properties);
+  else if (CM_IS_SERVICE (object))
+    internal_service_apply_variant (CM_SERVICE (object), properties);
+  else if (CM_IS_NETWORK (object))
+    internal_network_apply_variant (CM_NETWORK (object), properties);
+  else if (CM_IS_DEVICE (object))
+    internal_device_apply_variant (CM_DEVICE (object), properties);
+  else if (CM_IS_CONNECTION (object))
+    internal_connection_apply_variant (CM_CONNECTION (object), properties);
+}
+
+static void
+manager_fetch_variant_cb (GObject *source, GAsyncResult *result,
+                          gpointer data)
+{
+  CmFetch *fetch = data;
+  CmManager *manager = fetch->manager;
+  CmManagerPrivate *priv;
+  GError *error = NULL;
+  GVariant *reply, *properties;
+
+  reply = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source), result,
+                                         &error);
+
+  /* Cancelled with the rest of the queue, and the manager may be gone */
+  if (!manager)
+  {
+    if (reply)
+      g_variant_unref (reply);
+    else
+      fetch->error = error;
+    manager_fetch_free (fetch);
+    return;
+  }
+
+  priv = manager->priv;
+  priv->fetch_in_flight = g_list_remove (priv->fetch_in_flight, fetch);
+  priv->n_in_flight--;
+  internal_stats_call_done (fetch->stats, reply != NULL);
+
+  if (!reply)
+  {
+    g_debug ("Error calling GetProperties on %s: %s\n",
+             dbus_g_proxy_get_path (fetch->proxy), error->message);
+    fetch->error = error;
+  }
+  else
+  {
+    properties = g_variant_get_child_value (reply, 0);
+    manager_fetch_apply_variant (fetch->object, properties);
+    fetch->applied = TRUE;
+    g_variant_unref (properties);
+    g_variant_unref (reply);
+  }
+
+  manager_fetch_free (fetch);
+  manager_fetch_pump (manager);
+}
+#endif
+
+static void
+manager_fetch_pump (CmManager *manager)
+{
+  CmManagerPrivate *priv = manager->priv;
+  CmFetch *fetch;
+
+  while (priv->n_in_flight < MANAGER_FETCH_WINDOW &&
+         (fetch = g_queue_pop_head (priv->fetch_queue)))
+  {
+    fetch->stats = internal_stats_call_new (priv->stats, fetch->iface,
+                                            STATS_METHOD_GET_PROPERTIES, NULL);
+#ifdef CM_TRANSPORT_GDBUS
+    fetch->cancellable = g_cancellable_new ();
+    g_dbus_connection_call (priv->gdbus,
+                            dbus_g_proxy_get_bus_name (fetch->proxy),
+                            dbus_g_proxy_get_path (fetch->proxy),
+                            dbus_g_proxy_get_interface (fetch->proxy),
+                            "GetProperties", NULL,
+                            G_VARIANT_TYPE ("(a{sv})"),
+                            G_DBUS_CALL_FLAGS_NONE, -1, fetch->cancellable,
+                            manager_fetch_variant_cb, fetch);
+#else
+    fetch->call = dbus_g_proxy_begin_call (fetch->proxy, "GetProperties",
+                                           manager_fetch_call_notify, fetch,
+                                           NULL, G_TYPE_INVALID);
+    if (!fetch->call)
+    {
+      g_debug ("Invocation of GetProperties failed on %s\n",
+               dbus_g_proxy_get_path (fetch->proxy));
+      manager_fetch_free (fetch);
+      continue;
+    }
+#endif
+
+    priv->fetch_in_flight = g_list_prepend (priv->fetch_in_flight, fetch);
+    priv->n_in_flight++;
+  }
+
+  if (!priv->ready && priv->n_in_flight == 0)
+  {
+    priv->ready = TRUE;
+    priv->refreshing = FALSE;
+    g_signal_emit (manager, manager_signals[SIGNAL_READY], 0);
+  }
+}
+
+static void
+manager_fetch_cancel_all (CmManager *manager)
+{
+  CmManagerPrivate *priv = manager->priv;
+  CmFetch *fetch;
+
+  while (priv->fetch_in_flight)
+  {
+    fetch = priv->fetch_in_flight->data;
+#ifdef CM_TRANSPORT_GDBUS
+    /* The callback still runs, and frees it */
+    fetch->manager = NULL;
+    g_cancellable_cancel (fetch->cancellable);
+#else
+    dbus_g_proxy_cancel_call (fetch->proxy, fetch->call);
+    manager_fetch_free (fetch);
+#endif
+    priv->fetch_in_flight = g_list_delete_link (priv->fetch_in_flight,
+                                                priv->fetch_in_flight);
+  }
+  priv->n_in_flight = 0;
+
+  while ((fetch = g_queue_pop_head (priv->fetch_queue)))
+    manager_fetch_free (fetch);
+}
+
+static CmStatsInterface
+manager_stats_interface (GObject *object)
+{
+  if (CM_IS_SERVICE (object))
+    return STATS_INTERFACE_SERVICE;
+  if (CM_IS_NETWORK (object))
+    return STATS_INTERFACE_NETWORK;
+  if (CM_IS_DEVICE (object))
+    return STATS_INTERFACE_DEVICE;
+  if (CM_IS_CONNECTION (object))
+    return STATS_INTERFACE_CONNECTION;
+
+  return STATS_INTERFACE_MANAGER;
+}
+
+/*
+ * Queue a GetProperties call on proxy; apply is called with object and
+ * the returned properties once the reply arrives.  object is kept alive
+ * until then.
+ */
+void
+internal_manager_get_properties (CmManager *manager, GObject *object,
+                                 DBusGProxy *proxy, CmPropertiesFunc apply)
+{
+  internal_manager_get_properties_full (manager, object, proxy, apply, NULL);
+}
+
+/*
+ * The same, also calling done when the fetch is over: after apply, or
+ * with the error that kept it from running.  Returns FALSE, and never
+ * calls done, if no fetch was queued.
+ */
+gboolean
+internal_manager_get_properties_full (CmManager *manager, GObject *object,
+                                      DBusGProxy *proxy, CmPropertiesFunc apply,
+                                      CmFetchDoneFunc done)
+{
+  CmManagerPrivate *priv = manager->priv;
+  CmFetch *fetch;
+
+  /* Restored objects are re-read by the refresh that follows the load */
+  if (priv->loading_snapshot)
+    return FALSE;
+
+  fetch = g_slice_new0 (CmFetch);
+  fetch->manager = manager;
+  fetch->object = g_object_ref (object);
+  fetch->proxy = g_object_ref (proxy);
+  fetch->apply = apply;
+  fetch->done = done;
+  fetch->iface = manager_stats_interface (object);
+
+  g_queue_push_tail (priv->fetch_queue, fetch);
+  priv->ready = FALSE;
+
+  manager_fetch_pump (manager);
+
+  return TRUE;
+}
+
+gboolean
+cm_manager_is_ready (CmManager *manager)
+{
+  CmManagerPrivate *priv = manager->priv;
+  return priv->ready;
+}
+
+/*
+ * Emit the "*-delta" signal for a reconciled list, then the plain
+ * "*-changed" one.  The lists are only valid for the duration of the
+ * emission and are released here, dropping the list's reference on the
+ * removed objects.
+ */
+static void
+manager_emit_delta (CmManager *manager, guint delta_signal,
+                    guint changed_signal, CmReconcileResult *result)
+{
+  if (result->added || result->removed || result->moved)
+    g_signal_emit (manager, manager_signals[delta_signal], 0,
+                   result->added, result->removed, result->moved);
+
+  g_list_free (result->added);
+  g_list_foreach (result->removed, (GFunc) g_object_unref, NULL);
+  g_list_free (result->removed);
+  g_list_free (result->moved);
+
+  g_signal_emit (manager, manager_signals[changed_signal], 0);
+}
+
+/*
+ * Object registry
+ *
+ * Every object the manager (or one of its devices) tracks is indexed by
+ * its interned object path so lookups don't have to walk the GLists,
+ * which remain as the ordered views handed out by the getters.
+ */
+static GHashTable *
+manager_index_new (void)
+{
+  return g_hash_table_new (g_direct_hash, g_direct_equal);
+}
+
+static void
+manager_index_insert (GHashTable *index, const gchar *path, gpointer object)
+{
+  g_hash_table_insert (index, GUINT_TO_POINTER (g_quark_from_string (path)),
+                       object);
+}
+
+static void
+manager_index_remove (GHashTable *index, const gchar *path)
+{
+  GQuark quark = g_quark_try_string (path);
+
+  if (quark)
+    g_hash_table_remove (index, GUINT_TO_POINTER (quark));
+}
+
+static gpointer
+manager_index_lookup (GHashTable *index, const gchar *path)
+{
+  /* A path that was never interned cannot be in the registry */
+  GQuark quark = g_quark_try_string (path);
+
+  if (!quark)
+    return NULL;
+
+  return g_hash_table_lookup (index, GUINT_TO_POINTER (quark));
+}
+
+void
+internal_manager_unregister_network (CmManager *manager, CmNetwork *network)
+{
+  CmManagerPrivate *priv = manager->priv;
+
+  if (manager_index_lookup (priv->index[REGISTRY_NETWORKS],
+                            cm_network_get_path (network)) == network)
+    manager_index_remove (priv->index[REGISTRY_NETWORKS], cm_network_get_path (network));
+}
+
+static void
+manager_unregister_device (CmManager *manager, CmDevice *device)
+{
+  CmManagerPrivate *priv = manager->priv;
+  const GList *iter;
+
+  for (iter = cm_device_get_networks (device); iter != NULL; iter = iter->next)
+    internal_manager_unregister_network (manager, iter->data);
+
+  manager_index_remove (priv->index[REGISTRY_DEVICES], cm_device_get_path (device));
+}
+
+static void
+manager_clear_registry (CmManager *manager)
+{
+  CmManagerPrivate *priv = manager->priv;
+  gint i;
+
+  for (i = 0; i < REGISTRY_LAST; i++)
+    g_hash_table_remove_all (priv->index[i]);
+}
+
+CmDevice *
+cm_manager_find_device (CmManager *manager, const gchar *opath)
+{
+  CmManagerPrivate *priv = manager->priv;
+  return manager_index_lookup (priv->index[REGISTRY_DEVICES], opath);
+}
+
+CmService *
+cm_manager_find_service (CmManager *manager, const gchar *opath)
+{
+  CmManagerPrivate *priv = manager->priv;
+  return manager_index_lookup (priv->index[REGISTRY_SERVICES], opath);
+}
+
+CmConnection *
+cm_manager_find_connection (CmManager *manager, const gchar *opath)
+{
+  CmManagerPrivate *priv = manager->priv;
+  return manager_index_lookup (priv->index[REGISTRY_CONNECTIONS], opath);
+}
+
+CmNetwork *
+cm_manager_find_network (CmManager *manager, const gchar *opath)
+{
+  CmManagerPrivate *priv = manager->priv;
+  return manager_index_lookup (priv->index[REGISTRY_NETWORKS], opath);
+}
+
+/*
+ * Pending references
+ *
+ * Networks and connections name their device, and connections their
+ * network, by path, and that object may not be registered yet when they
+ * do.  Rather than lose the link, the reference waits here, keyed by the
+ * path, until the object is registered.  Waiters are weakly referenced,
+ * and an object waits for at most one object of each kind.
+ */
+typedef struct
+{
+  CmManager *manager;
+  CmRegistryKind kind;
+  GObject *object;
+  GQuark path;
+  CmResolvedFunc resolved;
+} CmPendingRef;
+
+static void
+manager_pending_unlink (CmPendingRef *pending)
+{
+  CmManagerPrivate *priv = pending->manager->priv;
+  GHashTable *paths = priv->pending[pending->kind];
+  gpointer key = GUINT_TO_POINTER (pending->path);
+  GSList *waiters;
+
+  g_hash_table_remove (priv->pending_waiters[pending->kind], pending->object);
+
+  waiters = g_slist_remove (g_hash_table_lookup (paths, key), pending);
+  if (waiters)
+    g_hash_table_insert (paths, key, waiters);
+  else
+    g_hash_table_remove (paths, key);
+}
+
+static void
+manager_pending_gone (gpointer data, GObject *object)
+{
+  CmPendingRef *pending = data;
+
+  manager_pending_unlink (pending);
+  g_slice_free (CmPendingRef, pending);
+}
+
+/* Stop object waiting for an object of kind, if it is */
+void
+internal_manager_forget (CmManager *manager, CmRegistryKind kind,
+                         GObject *object)
+{
+  CmPendingRef *pending;
+
+  pending = g_hash_table_lookup (manager->priv->pending_waiters[kind], object);
+  if (!pending)
+    return;
+
+  g_object_weak_unref (object, manager_pending_gone, pending);
+  manager_pending_unlink (pending);
+  g_slice_free (CmPendingRef, pending);
+}
+
+/*
+ * The object of kind at path, for object to point at.  If none is
+ * registered yet, NULL is returned and resolved is called with it once
+ * it is, replacing whatever object was waiting for before.
+ */
+gpointer
+internal_manager_resolve (CmManager *manager, CmRegistryKind kind,
+                          const gchar *path, GObject *object,
+                          CmResolvedFunc resolved)
+{
+  CmManagerPrivate *priv = manager->priv;
+  CmPendingRef *pending;
+  gpointer target, key;
+
+  internal_manager_forget (manager, kind, object);
+
+  target = manager_index_lookup (priv->index[kind], path);
+  if (target || !path || !*path)
+    return target;
+
+  g_debug ("%s not registered yet, deferring\n", path);
+
+  pending = g_slice_new (CmPendingRef);
+  pending->manager = manager;
+  pending->kind = kind;
+  pending->object = object;
+  pending->path = g_quark_from_string (path);
+  pending->resolved = resolved;
+
+  key = GUINT_TO_POINTER (pending->path);
+  g_hash_table_insert (priv->pending[kind], key,
+                       g_slist_prepend (g_hash_table_lookup (
+                                          priv->pending[kind], key),
+                                        pending));
+  g_hash_table_insert (priv->pending_waiters[kind], object, pending);
+  g_object_weak_ref (object, manager_pending_gone, pending);
+
+  return NULL;
+}
+
+/* Hand a newly registered target to the references waiting for it */
+static void
+manager_pending_resolve (CmManager *manager, CmRegistryKind kind,
+                         const gchar *path, gpointer target)
+{
+  CmManagerPrivate *priv = manager->priv;
+  GQuark quark = g_quark_try_string (path);
+  GSList *waiters, *iter;
+
+  if (!quark)
+    return;
+
+  waiters = g_hash_table_lookup (priv->pending[kind],
+                                 GUINT_TO_POINTER (quark));
+  if (!waiters)
+    return;
+
+  /* Detach them all first, the handlers may start waiting again */
+  g_hash_table_remove (priv->pending[kind], GUINT_TO_POINTER (quark));
+  for (iter = waiters; iter != NULL; iter = iter->next)
+  {
+    CmPendingRef *pending = iter->data;
+
+    g_hash_table_remove (priv->pending_waiters[kind], pending->object);
+    g_object_weak_unref (pending->object, manager_pending_gone, pending);
+    g_object_ref (pending->object);
+  }
+
+  for (iter = waiters; iter != NULL; iter = iter->next)
+  {
+    CmPendingRef *pending = iter->data;
+
+    pending->resolved (pending->object, target);
+    g_object_unref (pending->object);
+    g_slice_free (CmPendingRef, pending);
+  }
+
+  g_slist_free (waiters);
+}
+
+static void
+manager_pending_clear (CmManager *manager)
+{
+  CmManagerPrivate *priv = manager->priv;
+  GHashTableIter iter;
+  gpointer object, pending;
+  gint i;
+
+  for (i = 0; i < REGISTRY_LAST; i++)
+  {
+    g_hash_table_iter_init (&iter, priv->pending_waiters[i]);
+    while (g_hash_table_iter_next (&iter, &object, &pending))
+    {
+      g_object_weak_unref (object, manager_pending_gone, pending);
+      g_slice_free (CmPendingRef, pending);
+    }
+    g_hash_table_remove_all (priv->pending_waiters[i]);
+
+    g_hash_table_iter_init (&iter, priv->pending[i]);
+    while (g_hash_table_iter_next (&iter, NULL, &pending))
+      g_slist_free (pending);
+    g_hash_table_remove_all (priv->pending[i]);
+  }
+}
+
+static const gchar *
+manager_registry_path (CmRegistryKind kind, gpointer object)
+{
+  switch (kind)
+  {
+  case REGISTRY_DEVICES:
+    return cm_device_get_path (object);
+  case REGISTRY_SERVICES:
+    return cm_service_get_path (object);
+  case REGISTRY_CONNECTIONS:
+    return cm_connection_get_path (object);
+  case REGISTRY_NETWORKS:
+    return cm_network_get_path (object);
+  case REGISTRY_LAST:
+  default:
+    break;
+  }
+
+  return NULL;
+}
+
+static void
+manager_registry_fetch (CmRegistryKind kind, gpointer object)
+{
+  switch (kind)
+  {
+  case REGISTRY_DEVICES:
+    internal_device_fetch_properties (object);
+    break;
+  case REGISTRY_SERVICES:
+    internal_service_fetch_properties (object);
+    break;
+  case REGISTRY_CONNECTIONS:
+    internal_connection_fetch_properties (object);
+    break;
+  case REGISTRY_NETWORKS:
+    internal_network_fetch_properties (object);
+    break;
+  case REGISTRY_LAST:
+  default:
+    break;
+  }
+}
+
+/*
+ * Given the old ranks of the kept objects laid out in their new order,
+ * flag every object outside one longest increasing subsequence.  Those
+ * are the fewest objects that have to move to turn the old order into
+ * the new one.  Patience sorting, O(K log K).
+ */
+static void
+manager_find_moved (const gint *ranks, guint len, gboolean *moved)
+{
+  gint *tails = g_new (gint, len + 1);
+  gint *prev = g_new (gint, len + 1);
+  guint i, longest = 0;
+  gint j;
+
+  for (i = 0; i < len; i++)
+  {
+    guint lo = 0, hi = longest;
+
+    while (lo < hi)
+    {
+      guint mid = (lo + hi) / 2;
+
+      if (ranks[tails[mid]] < ranks[i])
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+    prev[i] = lo > 0 ? tails[lo - 1] : -1;
+    tails[lo] = i;
+    if (lo == longest)
+      longest++;
+
+    moved[i] = TRUE;
+  }
+
+  for (j = longest ? tails[longest - 1] : -1; j >= 0; j = prev[j])
+    moved[j] = FALSE;
+
+  g_free (tails);
+  g_free (prev);
+}
+
+/*
+ * Reconcile an ordered object list against the array of object paths
+ * ConnMan just sent us.
+ *
+ * The paths are first loaded into a set (path quark -> position), which
+ * lets a single walk of the current list split it into kept and removed
+ * objects.  A second walk over the array then relinks the list in array
+ * order, looking kept objects up through the registry and creating the
+ * new ones with new_func.  Kept objects keep their GList node, and only
+ * links that change are written, so a list handed out earlier stays
+ * valid.  Everything but the moved detection is O(N + M).
+ *
+ * Removed objects are dropped from the registry but not unreferenced;
+ * they are handed back in result->removed, along with the objects new
+ * to the list in result->added and the kept objects whose relative
+ * position changed in result->moved.  The caller owns all three lists.
+ * An object already registered for a new path, by another list, is
+ * adopted with a reference of its own rather than created again.
+ */
+void
+internal_manager_reconcile (CmManager *manager, CmRegistryKind kind,
+                            GList **list, GPtrArray *paths,
+                            CmReconcileNewFunc new_func, gpointer data,
+                            CmReconcileResult *result)
+{
+  CmManagerPrivate *priv = manager->priv;
+  GHashTable *index = priv->index[kind];
+  GHashTable *positions;
+  GList *iter, *next, *node, *head = NULL, *tail = NULL;
+  GList **nodes;
+  GPtrArray *kept;
+  gint *old_ranks, *kept_ranks;
+  gboolean *moved;
+  gint rank = 0;
+  guint i;
+
+  result->added = NULL;
+  result->removed = NULL;
+  result->moved = NULL;
+
+  positions = g_hash_table_new (g_direct_hash, g_direct_equal);
+  for (i = 0; i < paths->len; i++)
+  {
+    gpointer quark;
+
+    quark = GUINT_TO_POINTER (
+      g_quark_from_string (g_ptr_array_index (paths, i)));
+
+    /* Keep the first position should ConnMan repeat a path */
+    if (!g_hash_table_lookup (positions, quark))
+      g_hash_table_insert (positions, quark, GUINT_TO_POINTER (i + 1));
+  }
+
+  /* old_ranks[new position] = rank of the kept object in the old list */
+  old_ranks = g_new (gint, paths->len + 1);
+  for (i = 0; i < paths->len; i++)
+    old_ranks[i] = -1;
+
+  /* nodes[new position] = the kept object's node in the old list */
+  nodes = g_new0 (GList *, paths->len + 1);
+
+  for (iter = *list; iter != NULL; iter = next)
+  {
+    const gchar *path = manager_registry_path (kind, iter->data);
+    GQuark quark = g_quark_try_string (path);
+    guint position = 0;
+
+    next = iter->next;
+
+    if (quark)
+      position = GPOINTER_TO_UINT (
+        g_hash_table_lookup (positions, GUINT_TO_POINTER (quark)));
+
+    if (position)
+    {
+      old_ranks[position - 1] = rank++;
+      nodes[position - 1] = iter;
+      continue;
+    }
+
+    /* Unless the path has been registered to another object since */
+    if (manager_index_lookup (index, path) == iter->data)
+    {
+      if (kind == REGISTRY_DEVICES)
+        manager_unregister_device (manager, iter->data);
+      else
+        manager_index_remove (index, path);
+    }
+
+    result->removed = g_list_prepend (result->removed, iter->data);
+    g_list_free_1 (iter);
+  }
+
+  kept = g_ptr_array_sized_new (rank);
+  kept_ranks = g_new (gint, rank + 1);
+
+  for (i = 0; i < paths->len; i++)
+  {
+    const gchar *path = g_ptr_array_index (paths, i);
+    gpointer object;
+
+    if (GPOINTER_TO_UINT (g_hash_table_lookup (
+          positions, GUINT_TO_POINTER (g_quark_try_string (path)))) != i + 1)
+      continue;
+
+    node = nodes[i];
+    object = manager_index_lookup (index, path);
+
+    /*
+     * Our own object for the path is registered unless the registry was
+     * cleared since; if another object took the path over, ours goes and
+     * the registered one is adopted below.
+     */
+    if (node && !object)
+    {
+      object = node->data;
+      manager_index_insert (index, path, object);
+    }
+    else if (node && node->data != object)
+    {
+      result->removed = g_list_prepend (result->removed, node->data);
+      g_list_free_1 (node);
+      node = NULL;
+    }
+
+    if (node)
+    {
+      kept_ranks[kept->len] = old_ranks[i];
+      g_ptr_array_add (kept, object);
+
+      /* Survivors of an incremental refresh may have gone stale */
+      if (priv->refreshing)
+        manager_registry_fetch (kind, object);
+    }
+    else if (object)
+    {
+      /* Registered, but not in this list yet: the list takes a reference */
+      g_object_ref (object);
+      result->added = g_list_prepend (result->added, object);
+    }
+    else
+    {
+      object = new_func (path, i, data);
+      if (!object)
+        continue;
+
+      manager_index_insert (index, path, object);
+      result->added = g_list_prepend (result->added, object);
+    }
+
+    if (!node)
+    {
+      node = g_list_alloc ();
+      node->data = object;
+    }
+
+    if (node->prev != tail)
+      node->prev = tail;
+    if (!tail)
+      head = node;
+    else if (tail->next != node)
+      tail->next = node;
+    tail = node;
+  }
+
+  if (tail && tail->next)
+    tail->next = NULL;
+
+  moved = g_new (gboolean, kept->len + 1);
+  manager_find_moved (kept_ranks, kept->len, moved);
+  for (i = kept->len; i > 0; i--)
+  {
+    if (moved[i - 1])
+      result->moved = g_list_prepend (result->moved,
+                                      g_ptr_array_index (kept, i - 1));
+  }
+
+  g_free (moved);
+  g_free (kept_ranks);
+  g_free (old_ranks);
+  g_ptr_array_free (kept, TRUE);
+  g_free (nodes);
+  g_hash_table_destroy (positions);
+
+  *list = head;
+  result->added = g_list_reverse (result->added);
+  result->removed = g_list_reverse (result->removed);
+
+  /* Now the list is whole, link up whatever was waiting for the new */
+  for (iter = result->added; iter != NULL; iter = iter->next)
+    manager_pending_resolve (manager, kind,
+                             manager_registry_path (kind, iter->data),
+                             iter->data);
+}
+
+static gpointer
+manager_device_new (const gchar *path, guint position, gpointer data)
 {
-  CmManagerPrivate *priv = manager->priv;
-  CmDevice *device = NULL;
-  GList *iter;
-  const gchar *dpath;
+  CmManager *manager = data;
+  CmDevice *device;
+  GError *error = NULL;
 
-  for (iter = priv->devices; iter != NULL; iter = iter->next)
+  device = internal_device_new (manager->priv->proxy, path, manager, &error);
+  if (!device)
   {
-    device = iter->data;
-    dpath = cm_device_get_path (device);
-
-    if (g_strcmp0 (opath, dpath) == 0)
-      return device;
+    g_debug ("device_new failed in %s: %s\n", __FUNCTION__, error->message);
+    g_error_free (error);
   }
 
-  return NULL;
+  return device;
 }
 
-CmService *
-cm_manager_find_service (CmManager *manager, const gchar *opath)
+static gpointer
+manager_connection_new (const gchar *path, guint position, gpointer data)
 {
-  CmManagerPrivate *priv = manager->priv;
-  CmService *service = NULL;
-  GList *iter;
-  const gchar *spath;
+  CmManager *manager = data;
+  CmConnection *connection;
+  GError *error = NULL;
 
-  for (iter = priv->services; iter != NULL; iter = iter->next)
+  connection = internal_connection_new (manager->priv->proxy, path, manager,
+                                        &error);
+  if (!connection)
   {
-    service = iter->data;
-    spath = cm_service_get_path (service);
-
-    if (g_strcmp0 (opath, spath) == 0)
-      return service;
+    g_debug ("connection_new failed in %s: %s\n", __FUNCTION__,
+             error->message);
+    g_error_free (error);
   }
 
-  return NULL;
+  return connection;
 }
 
-CmConnection *
-cm_manager_find_connection (CmManager *manager, const gchar *opath)
+static gpointer
+manager_service_new (const gchar *path, guint position, gpointer data)
 {
-  CmManagerPrivate *priv = manager->priv;
-  CmConnection *connection = NULL;
-  GList *iter;
-  const gchar *cpath;
+  CmManager *manager = data;
+  CmService *service;
+  GError *error = NULL;
 
-  for (iter = priv->connections; iter != NULL; iter = iter->next)
+  service = internal_service_new (manager->priv->proxy, path, position,
+                                  manager->priv->lazy_services, manager,
+                                  &error);
+  if (!service)
   {
-    connection = iter->data;
-    cpath = cm_connection_get_path (connection);
-
-    if (g_strcmp0 (opath, cpath) == 0)
-      return connection;
+    g_debug ("service_new failed in %s: %s\n", __FUNCTION__, error->message);
+    g_error_free (error);
   }
 
-  return NULL;
+  return service;
 }
 
-static void
-manager_update_property (const gchar *key, GValue *value, CmManager *manager)
+static gboolean
+manager_decode_devices (gpointer object, const GValue *value)
 {
+  CmManager *manager = CM_MANAGER (object);
   CmManagerPrivate *priv = manager->priv;
-  gchar *tmp;
+  CmReconcileResult result;
 
-  if (!strcmp ("Devices", key))
-  {
-    if (priv->low_level)
-    {
-      GPtrArray *devices = g_value_get_boxed (value);
-      gint i;
-      const gchar *path = NULL;
-      GList *curr, *next;
-
-      /* First remove stale devices */
-      curr = priv->devices;
-      while (curr != NULL)
-      {
-        CmDevice *dev = CM_DEVICE (curr->data);
-        gboolean found = FALSE;
-
-        next = curr->next;
-
-        for (i = 0; i < devices->len && !found; i++)
-        {
-          path = g_ptr_array_index (devices, i);
-
-          if (g_strcmp0 (path, cm_device_get_path (dev)) == 0)
-          {
-            found = TRUE;
-          }
-        }
-
-        /* device not in retrieved list, delete from our list */
-        if (!found)
-        {
-          priv->devices = g_list_delete_link (priv->devices, curr);
-        }
-
-        curr = next;
-      }
-
-      /* iterate retrieved list, add any new items to our list */
-      for (i = 0; i < devices->len; i++)
-      {
-        path = g_ptr_array_index (devices, i);
-        CmDevice *device;
-        GError *error = NULL;
-
-        device = cm_manager_find_device (manager, path);
-        if (!device)
-        {
-          device = internal_device_new (priv->proxy, path, manager, &error);
-          if (!device)
-          {
-            g_debug ("device_new failed in %s: %s\n", __FUNCTION__,
-                     error->message);
-            g_error_free (error);
-            continue;
-          }
-          else
-          {
-            priv->devices = g_list_append (priv->devices, device);
-          }
-        }
-      }
-      g_signal_emit (manager, manager_signals[SIGNAL_DEVICES_CHANGED], 0);
-    }
-  }
-  else if (!strcmp ("Connections", key))
-  {
-    if (priv->low_level)
-    {
-      GPtrArray *connections = g_value_get_boxed (value);
-      gint i;
-      const gchar *path = NULL;
-      GList *curr, *next;
-
-      /* First remove stale connections */
-      curr = priv->connections;
-      while (curr != NULL)
-      {
-        CmConnection *con = CM_CONNECTION (curr->data);
-        gboolean found = FALSE;
-
-        next = curr->next;
-
-        for (i = 0; i < connections->len && !found; i++)
-        {
-          path = g_ptr_array_index (connections, i);
-
-          if (g_strcmp0 (path, cm_connection_get_path (con)) == 0)
-          {
-            found = TRUE;
-          }
-        }
-
-        /* connection not in retrieved list, delete from our list */
-        if (!found)
-        {
-          priv->connections = g_list_delete_link (priv->connections, curr);
-        }
-
-        curr = next;
-      }
-
-      /* iterate retrieved list, add any new items to our list */
-      for (i = 0; i < connections->len; i++)
-      {
-        path = g_ptr_array_index (connections, i);
-        CmConnection *connection;
-        GError *error = NULL;
-
-        connection = cm_manager_find_connection (manager, path);
-        if (!connection)
-        {
-          connection = internal_connection_new (priv->proxy, path, manager,
-                                                &error);
-          if (!connection)
-          {
-            g_debug ("connection_new failed in %s: %s\n", __FUNCTION__,
-                     error->message);
-            g_error_free (error);
-            continue;
-          }
-          else
-          {
-            priv->connections = g_list_append (priv->connections, connection);
-          }
-        }
-      }
-      g_signal_emit (manager, manager_signals[SIGNAL_CONNECTIONS_CHANGED], 0);
-    }
-  }
-  else if (!strcmp ("Services", key))
-  {
-    GPtrArray *services = g_value_get_boxed (value);
-    gint i;
-    const gchar *path = NULL;
-    GList *curr, *next;
+  if (!priv->low_level)
+    return FALSE;
 
-    /* First remove stale services */
-    curr = priv->services;
-    while (curr != NULL)
-    {
-      CmService *serv = CM_SERVICE (curr->data);
-      gboolean found = FALSE;
+  internal_manager_reconcile (manager, REGISTRY_DEVICES, &priv->devices,
+                              g_value_get_boxed (value),
+                              manager_device_new, manager, &result);
 
-      next = curr->next;
+  manager_emit_delta (manager, SIGNAL_DEVICES_DELTA,
+                      SIGNAL_DEVICES_CHANGED, &result);
 
-      for (i = 0; i < services->len && !found; i++)
-      {
-        path = g_ptr_array_index (services, i);
+  return TRUE;
+}
+
+static gboolean
+manager_decode_connections (gpointer object, const GValue *value)
+{
+  CmManager *manager = CM_MANAGER (object);
+  CmManagerPrivate *priv = manager->priv;
+  CmReconcileResult result;
 
-        if (g_strcmp0 (path, cm_service_get_path (serv)) == 0)
-        {
-          found = TRUE;
-        }
-      }
+  if (!priv->low_level)
+    return FALSE;
 
-      /* service not in retrieved list, delete from our list */
-      if (!found)
-      {
-        priv->services = g_list_delete_link (priv->services, curr);
-      }
+  internal_manager_reconcile (manager, REGISTRY_CONNECTIONS,
+                              &priv->connections,
+                              g_value_get_boxed (value),
+                              manager_connection_new, manager, &result);
 
-      curr = next;
-    }
+  manager_emit_delta (manager, SIGNAL_CONNECTIONS_DELTA,
+                      SIGNAL_CONNECTIONS_CHANGED, &result);
 
-    /* iterate retrieved list, add any new items to our list */
-    for (i = 0; i < services->len; i++)
-    {
-      path = g_ptr_array_index (services, i);
-      CmService *service;
-      GError *error = NULL;
-
-      service = cm_manager_find_service (manager, path);
-      if (!service)
-      {
-        service = internal_service_new (priv->proxy, path, i, manager, &error);
-        if (!service)
-        {
-          g_debug ("service_new failed in %s: %s\n", __FUNCTION__,
-                   error->message);
-          g_error_free (error);
-          continue;
-        }
-        else
-        {
-          priv->services = g_list_append (priv->services, service);
-        }
-      }
-      else
-      {
-        /* services are sorted so update the order */
-        cm_service_set_order (service, i);
-      }
-    }
+  return TRUE;
+}
 
-    priv->services = g_list_sort (priv->services,
-                                  (GCompareFunc) cm_service_compare);
+static gboolean
+manager_decode_services (gpointer object, const GValue *value)
+{
+  CmManager *manager = CM_MANAGER (object);
+  CmManagerPrivate *priv = manager->priv;
+  CmReconcileResult result;
+  GList *iter;
+  gint i;
 
-    g_signal_emit (manager, manager_signals[SIGNAL_SERVICES_CHANGED], 0);
-  }
-  else if (!strcmp ("Profiles", key))
-  {
-  }
-  else if (!strcmp ("ActiveProfile", key))
-  {
-    // gchar *profile = g_value_get_boxed (value);
-    /* FIXME: Finish this property */
-  }
-  else if (!strcmp ("OfflineMode", key))
+  internal_manager_reconcile (manager, REGISTRY_SERVICES, &priv->services,
+                              g_value_get_boxed (value),
+                              manager_service_new, manager, &result);
+
+  g_list_foreach (result.removed, (GFunc) internal_service_unlist, NULL);
+
+  /* The list is in ConnMan's order, so renumber what moved */
+  for (iter = priv->services, i = 0; iter != NULL; iter = iter->next, i++)
   {
-    priv->offline_mode = g_value_get_boolean (value);
-    g_signal_emit (manager, manager_signals[SIGNAL_OFFLINE_MODE_CHANGED], 0);
+    if (cm_service_get_order (iter->data) != i)
+      cm_service_set_order (iter->data, i);
   }
-  else if (!strcmp ("State", key))
+
+  manager_emit_delta (manager, SIGNAL_SERVICES_DELTA,
+                      SIGNAL_SERVICES_CHANGED, &result);
+
+  return TRUE;
+}
+
+/*
+ * Replace technologies with the names in value, returning whether they
+ * changed.  The names are interned, so an unchanged array is spotted
+ * with pointer compares and leaves the list alone; the mask changes,
+ * if any, go out on delta_signal.
+ */
+static gboolean
+manager_update_technologies (CmManager *manager, CmTechnologies *technologies,
+                             const GValue *value, gint delta_signal)
+{
+  gchar **v = g_value_get_boxed (value);
+  GList *iter = technologies->names;
+  gboolean same = TRUE;
+  guint mask = 0, old = technologies->mask;
+  CmDeviceType type;
+  gint i;
+
+  for (i = 0; v && v[i]; i++)
   {
-    g_free (priv->state);
-    priv->state = g_value_dup_string (value);
-    g_signal_emit (manager, manager_signals[SIGNAL_STATE_CHANGED], 0);
+    const gchar *name = g_intern_string (v[i]);
+
+    if (same && (!iter || iter->data != name))
+      same = FALSE;
+    if (iter)
+      iter = iter->next;
+
+    type = internal_device_type_from_string (name);
+    if (type != DEVICE_UNKNOWN)
+      mask |= CM_TECHNOLOGY_BIT (type);
   }
-  else if (!strcmp ("AvailableTechnologies", key))
-  {
-    gchar **v = g_value_get_boxed (value);
-    gint i;
-    GList *curr, *next;
 
-    /* cleanup existing list */
-    curr = priv->available_technologies;
-    while (curr)
-    {
-      next = curr->next;
-      g_free (curr->data);
-      priv->available_technologies =
-	      g_list_delete_link (priv->available_technologies,
-				  curr);
-      curr = next;
-    }
+  if (same && !iter)
+    return FALSE;
 
-    for (i = 0; i < g_strv_length(v); i++)
-    {
-      priv->available_technologies =
-	      g_list_prepend (priv->available_technologies,
-			      g_strdup (*(v + i)));
-    }
+  g_list_free (technologies->names);
+  technologies->names = NULL;
+  for (i = 0; v && v[i]; i++)
+    technologies->names = g_list_prepend (technologies->names,
+                                          (gpointer) g_intern_string (v[i]));
+  technologies->names = g_list_reverse (technologies->names);
+  technologies->mask = mask;
 
-    g_signal_emit (manager,
-		   manager_signals[SIGNAL_AVAILABLE_TECHNOLOGIES_CHANGED],
-		   0);
-  }
-  else if (!strcmp ("ConnectedTechnologies", key))
-  {
-    gchar **v = g_value_get_boxed (value);
-    gint i;
-    GList *curr, *next;
+  if (mask != old)
+    g_signal_emit (manager, manager_signals[delta_signal], 0,
+                   mask & ~old, old & ~mask);
 
-    /* cleanup existing list */
-    curr = priv->connected_technologies;
-    while (curr)
-    {
-      next = curr->next;
-      g_free (curr->data);
-      priv->connected_technologies =
-	      g_list_delete_link (priv->connected_technologies,
-				  curr);
-      curr = next;
-    }
+  return TRUE;
+}
 
-    for (i = 0; i < g_strv_length(v); i++)
-    {
-      priv->connected_technologies =
-	      g_list_prepend (priv->connected_technologies,
-			      g_strdup (*(v + i)));
-    }
+static gboolean
+manager_decode_available_technologies (gpointer object, const GValue *value)
+{
+  CmManager *manager = CM_MANAGER (object);
 
-    g_signal_emit (manager,
-		   manager_signals[SIGNAL_CONNECTED_TECHNOLOGIES_CHANGED],
-		   0);
-  }
-  else if (!strcmp ("EnabledTechnologies", key))
-  {
-    gchar **v = g_value_get_boxed (value);
-    gint i;
-    GList *curr, *next;
+  return manager_update_technologies (
+    manager, &manager->priv->available_technologies, value,
+    SIGNAL_AVAILABLE_TECHNOLOGIES_DELTA);
+}
 
-    /* cleanup existnig list */
-    curr = priv->enabled_technologies;
-    while (curr)
-    {
-      next = curr->next;
-      g_free (curr->data);
-      priv->enabled_technologies =
-	g_list_delete_link (priv->enabled_technologies,
-			    curr);
-      curr = next;
-    }
+static gboolean
+manager_decode_connected_technologies (gpointer object, const GValue *value)
+{
+  CmManager *manager = CM_MANAGER (object);
 
-    for (i = 0; i < g_strv_length(v); i++)
-    {
-      priv->enabled_technologies =
-	g_list_prepend (priv->enabled_technologies,
-			g_strdup (*(v + i)));
-    }
+  return manager_update_technologies (
+    manager, &manager->priv->connected_technologies, value,
+    SIGNAL_CONNECTED_TECHNOLOGIES_DELTA);
+}
 
-    g_signal_emit (manager,
-		   manager_signals[SIGNAL_ENABLED_TECHNOLOGIES_CHANGED],
-		   0);
-  }
-  else if (!strcmp ("DefaultTechnology", key))
-  {
-    /* FIXME: finish this property */
-  }
-  else
+static gboolean
+manager_decode_enabled_technologies (gpointer object, const GValue *value)
+{
+  CmManager *manager = CM_MANAGER (object);
+
+  return manager_update_technologies (
+    manager, &manager->priv->enabled_technologies, value,
+    SIGNAL_ENABLED_TECHNOLOGIES_DELTA);
+}
+
+#define MANAGER_FIELD(field) G_STRUCT_OFFSET (CmManagerPrivate, field)
+
+/* The object lists emit their own delta and changed signals */
+static const CmProperty manager_properties[] =
+{
+  { "Devices", PROPERTY_CUSTOM, 0,
+    -1, 0, manager_decode_devices },
+  { "Connections", PROPERTY_CUSTOM, 0,
+    -1, 0, manager_decode_connections },
+  { "Services", PROPERTY_CUSTOM, 0,
+    -1, 0, manager_decode_services },
+  /* FIXME: finish Profiles, ActiveProfile and DefaultTechnology */
+  { "Profiles", PROPERTY_IGNORE, 0,
+    -1, 0, NULL },
+  { "ActiveProfile", PROPERTY_IGNORE, 0,
+    -1, 0, NULL },
+  { "DefaultTechnology", PROPERTY_IGNORE, 0,
+    -1, 0, NULL },
+  { "OfflineMode", PROPERTY_BOOLEAN, MANAGER_FIELD (offline_mode),
+    SIGNAL_OFFLINE_MODE_CHANGED, 0, NULL },
+  { "State", PROPERTY_STRING, MANAGER_FIELD (state),
+    SIGNAL_STATE_CHANGED, 0, NULL },
+  { "AvailableTechnologies", PROPERTY_CUSTOM, 0,
+    SIGNAL_AVAILABLE_TECHNOLOGIES_CHANGED, 0,
+    manager_decode_available_technologies },
+  { "ConnectedTechnologies", PROPERTY_CUSTOM, 0,
+    SIGNAL_CONNECTED_TECHNOLOGIES_CHANGED, 0,
+    manager_decode_connected_technologies },
+  { "EnabledTechnologies", PROPERTY_CUSTOM, 0,
+    SIGNAL_ENABLED_TECHNOLOGIES_CHANGED, 0,
+    manager_decode_enabled_technologies },
+};
+
+static GHashTable *manager_property_table;
+
+static void
+manager_update_property (const gchar *key, GValue *value, CmManager *manager)
+{
+  CmManagerPrivate *priv = manager->priv;
+  const CmProperty *property;
+  gboolean changed;
+  gchar *tmp;
+
+  property = internal_property_apply (manager_property_table, manager, priv,
+                                      key, value, &changed);
+  if (!property)
   {
     tmp = g_strdup_value_contents (value);
     g_debug ("Unhandled Manager property on Manager: %s = %s\n",
              key, tmp);
     g_free (tmp);
+    return;
   }
+
+  if (!changed)
+    return;
+
+  if (property->signal >= 0)
+    g_signal_emit (manager, manager_signals[property->signal], 0);
 }
 
 static void
-manager_get_properties_call_notify (DBusGProxy *proxy,
-                                    DBusGProxyCall *call,
-                                    gpointer data)
+manager_apply_properties (CmManager *manager, GHashTable *properties)
 {
-  CmManager *manager = data;
-  GError *error = NULL;
-  GHashTable *properties = NULL;
+  g_hash_table_foreach (properties, (GHFunc)manager_update_property, manager);
+  manager_emit_updated (manager);
+}
 
-  if (!dbus_g_proxy_end_call (
-        proxy, call, &error,
-        /* OUT values */
-        dbus_g_type_get_map ("GHashTable", G_TYPE_STRING, G_TYPE_VALUE),
-        &properties, G_TYPE_INVALID))
+#ifdef CM_TRANSPORT_GDBUS
+/* manager_apply_properties(), from a GetProperties reply */
+void
+internal_manager_apply_variant (CmManager *manager, GVariant *properties)
+{
+  CmManagerPrivate *priv = manager->priv;
+  const CmProperty *property;
+  GVariantIter iter;
+  const gchar *key;
+  GVariant *value;
+  gboolean changed;
+
+  g_variant_iter_init (&iter, properties);
+  while (g_variant_iter_loop (&iter, "{&sv}", &key, &value))
   {
-    g_debug ("Error calling dbus_g_proxy_end_call in %s: %s\n",
-             __FUNCTION__, error->message);
-    g_error_free (error);
-    return;
+    property = internal_property_apply_variant (manager_property_table,
+                                                manager, priv, key, value,
+                                                &changed);
+    if (!property)
+    {
+      g_debug ("Unhandled Manager property on Manager: %s\n", key);
+      continue;
+    }
+
+    if (changed && property->signal >= 0)
+      g_signal_emit (manager, manager_signals[property->signal], 0);
   }
 
-  g_hash_table_foreach (properties, (GHFunc)manager_update_property, manager);
-  g_hash_table_unref (properties);
   manager_emit_updated (manager);
 }
+#endif
 
-gboolean
-cm_manager_refresh (CmManager *manager)
+static void
+manager_release_objects (CmManager *manager)
 {
   CmManagerPrivate *priv = manager->priv;
-  DBusGProxyCall *call;
+
+  manager_clear_registry (manager);
 
   /* Remove all the prior devices */
   while (priv->devices)
@@ -514,22 +1579,286 @@ cm_manager_refresh (CmManager *manager)
   /* Remove all the prior services */
   while (priv->services)
   {
+    internal_service_unlist (priv->services->data);
     g_object_unref (priv->services->data);
     priv->services = g_list_delete_link (priv->services, priv->services);
   }
+}
+
+/*
+ * Re-read the manager's properties.  By default every object is dropped
+ * and rebuilt; with incremental refresh enabled the existing objects are
+ * reconciled by path against the new lists instead, and only those that
+ * survive are re-read, so pointers held by the application stay valid.
+ */
+gboolean
+cm_manager_refresh (CmManager *manager)
+{
+  CmManagerPrivate *priv = manager->priv;
 
-  call = dbus_g_proxy_begin_call (priv->proxy, "GetProperties",
-                                  manager_get_properties_call_notify, manager,
-                                  NULL, G_TYPE_INVALID);
+  /* Objects restored from a snapshot are reconciled like live ones */
+  if (priv->incremental_refresh || priv->snapshot_loaded)
+    priv->refreshing = TRUE;
+  else
+    manager_release_objects (manager);
+  priv->snapshot_loaded = FALSE;
 
-  if (!call)
+  internal_manager_get_properties (manager, G_OBJECT (manager), priv->proxy,
+                                   (CmPropertiesFunc) manager_apply_properties);
+
+  return TRUE;
+}
+
+/*
+ * Snapshots
+ *
+ * The manager's object graph can be saved to disk and restored on the
+ * next start, so that the getters have something to answer with before
+ * the first GetProperties round trips complete.  The next refresh then
+ * reconciles the restored objects with ConnMan's, as an incremental
+ * refresh would, and only properties that differ signal a change.
+ */
+static GPtrArray *
+manager_path_array (GList *objects, const gchar *(*get_path) (gpointer))
+{
+  GPtrArray *paths = g_ptr_array_new ();
+  GList *iter;
+
+  for (iter = objects; iter != NULL; iter = iter->next)
+    g_ptr_array_add (paths, g_strdup (get_path (iter->data)));
+
+  return paths;
+}
+
+static gchar **
+manager_technology_strv (const CmTechnologies *technologies)
+{
+  gchar **strv = g_new0 (gchar *, g_list_length (technologies->names) + 1);
+  GList *iter;
+  gint i = 0;
+
+  for (iter = technologies->names; iter != NULL; iter = iter->next)
+    strv[i++] = g_strdup (iter->data);
+
+  return strv;
+}
+
+static void
+manager_export_properties (CmManager *manager, GHashTable *values)
+{
+  CmManagerPrivate *priv = manager->priv;
+  GType path_array;
+
+  path_array = dbus_g_type_get_collection ("GPtrArray",
+                                           DBUS_TYPE_G_OBJECT_PATH);
+
+  internal_property_export (manager_property_table, priv, values);
+
+  g_value_take_boxed (
+    internal_property_values_add (values, "Services", path_array),
+    manager_path_array (priv->services,
+                        (const gchar *(*) (gpointer)) cm_service_get_path));
+  if (priv->low_level)
+    g_value_take_boxed (
+      internal_property_values_add (values, "Devices", path_array),
+      manager_path_array (priv->devices,
+                          (const gchar *(*) (gpointer)) cm_device_get_path));
+
+  g_value_take_boxed (
+    internal_property_values_add (values, "AvailableTechnologies",
+                                  G_TYPE_STRV),
+    manager_technology_strv (&priv->available_technologies));
+  g_value_take_boxed (
+    internal_property_values_add (values, "ConnectedTechnologies",
+                                  G_TYPE_STRV),
+    manager_technology_strv (&priv->connected_technologies));
+  g_value_take_boxed (
+    internal_property_values_add (values, "EnabledTechnologies",
+                                  G_TYPE_STRV),
+    manager_technology_strv (&priv->enabled_technologies));
+}
+
+gboolean
+cm_manager_save_snapshot (CmManager *manager, const gchar *filename,
+                          GError **error)
+{
+  CmManagerPrivate *priv = manager->priv;
+  CmSnapshotRecord *record;
+  GPtrArray *records;
+  GList *iter, *net;
+  GString *data;
+  gboolean ret;
+
+  records = g_ptr_array_new ();
+
+  /* Containers come before their contents, so loading can create them */
+  record = internal_snapshot_record_new (SNAPSHOT_MANAGER,
+                                         CONNMAN_MANAGER_PATH);
+  manager_export_properties (manager, record->values);
+  g_ptr_array_add (records, record);
+
+  for (iter = priv->devices; iter != NULL; iter = iter->next)
+  {
+    record = internal_snapshot_record_new (SNAPSHOT_DEVICE,
+                                           cm_device_get_path (iter->data));
+    internal_device_export_properties (iter->data, record->values);
+    g_ptr_array_add (records, record);
+  }
+
+  for (iter = priv->devices; iter != NULL; iter = iter->next)
+  {
+    for (net = (GList *) cm_device_get_networks (iter->data); net != NULL;
+         net = net->next)
+    {
+      record = internal_snapshot_record_new (SNAPSHOT_NETWORK,
+                                             cm_network_get_path (net->data));
+      internal_network_export_properties (net->data, record->values);
+      g_ptr_array_add (records, record);
+    }
+  }
+
+  for (iter = priv->services; iter != NULL; iter = iter->next)
+  {
+    record = internal_snapshot_record_new (SNAPSHOT_SERVICE,
+                                           cm_service_get_path (iter->data));
+    internal_service_export_properties (iter->data, record->values);
+    g_ptr_array_add (records, record);
+  }
+
+  data = internal_snapshot_encode (records);
+  ret = g_file_set_contents (filename, data->str, data->len, error);
+
+  g_string_free (data, TRUE);
+  g_ptr_array_foreach (records, (GFunc) internal_snapshot_record_free, NULL);
+  g_ptr_array_free (records, TRUE);
+
+  return ret;
+}
+
+/*
+ * Restore the objects saved by cm_manager_save_snapshot().  This is meant
+ * to be called before the first cm_manager_refresh(), which will bring
+ * the restored objects up to date.
+ */
+gboolean
+cm_manager_load_snapshot (CmManager *manager, const gchar *filename,
+                          GError **error)
+{
+  CmManagerPrivate *priv = manager->priv;
+  GMappedFile *file;
+  GPtrArray *records;
+  gpointer object;
+  guint i;
+
+  file = g_mapped_file_new (filename, FALSE, error);
+  if (!file)
+    return FALSE;
+
+  records = internal_snapshot_decode (g_mapped_file_get_contents (file),
+                                      g_mapped_file_get_length (file));
+  g_mapped_file_free (file);
+
+  if (!records)
   {
+    g_set_error (error, MANAGER_ERROR, MANAGER_ERROR_SNAPSHOT_INVALID,
+                 "%s is not a valid snapshot.", filename);
     return FALSE;
   }
 
-  return TRUE;
+  priv->loading_snapshot = TRUE;
+
+  for (i = 0; i < records->len; i++)
+  {
+    CmSnapshotRecord *record = g_ptr_array_index (records, i);
+
+    switch (record->kind)
+    {
+    case SNAPSHOT_MANAGER:
+      manager_apply_properties (manager, record->values);
+      break;
+
+    case SNAPSHOT_DEVICE:
+      object = cm_manager_find_device (manager, record->path);
+      if (object)
+        internal_device_apply_properties (object, record->values);
+      break;
+
+    case SNAPSHOT_NETWORK:
+      object = cm_manager_find_network (manager, record->path);
+      if (object)
+        internal_network_apply_properties (object, record->values);
+      break;
+
+    case SNAPSHOT_SERVICE:
+      object = cm_manager_find_service (manager, record->path);
+      if (object)
+        internal_service_apply_properties (object, record->values);
+      break;
+
+    default:
+      g_debug ("Unknown snapshot record for %s\n", record->path);
+      break;
+    }
+
+    internal_snapshot_record_free (record);
+  }
+
+  g_ptr_array_free (records, TRUE);
+
+  priv->loading_snapshot = FALSE;
+  priv->snapshot_loaded = TRUE;
+
+  return TRUE;
+}
+
+void
+cm_manager_set_incremental_refresh (CmManager *manager, gboolean incremental)
+{
+  CmManagerPrivate *priv = manager->priv;
+  priv->incremental_refresh = incremental;
+}
+
+gboolean
+cm_manager_get_incremental_refresh (CmManager *manager)
+{
+  CmManagerPrivate *priv = manager->priv;
+  return priv->incremental_refresh;
+}
+
+
+/*
+ * Statistics
+ *
+ * The manager counts the D-Bus calls it and its objects make, and the
+ * signals they receive; the counters are cheap enough to always be on.
+ */
+CmStatsCall *
+internal_manager_stats_call (CmManager *manager, CmStatsInterface iface,
+                             CmStatsMethod method, gpointer data)
+{
+  return internal_stats_call_new (manager ? manager->priv->stats : NULL,
+                                  iface, method, data);
+}
+
+void
+internal_manager_stats_signal (CmManager *manager, CmStatsInterface iface)
+{
+  if (manager)
+    internal_stats_signal (manager->priv->stats, iface);
+}
+
+/* Copy the counters, as of now, into stats */
+void
+cm_manager_get_stats (CmManager *manager, CmStats *stats)
+{
+  internal_stats_copy (manager->priv->stats, stats);
 }
 
+void
+cm_manager_reset_stats (CmManager *manager)
+{
+  internal_stats_reset (manager->priv->stats);
+}
 
 static void
 manager_property_change_handler_proxy (DBusGProxy *proxy,
@@ -539,11 +1868,114 @@ manager_property_change_handler_proxy (DBusGProxy *proxy,
 {
   CmManager *manager = data;
 
+  internal_manager_stats_signal (manager, STATS_INTERFACE_MANAGER);
   manager_update_property (key, value, manager);
 
   manager_emit_updated (manager);
 }
 
+/*
+ * PropertyChanged from every ConnMan object is seen by this one filter
+ * and handed to the object registered for its path, rather than having
+ * each object's proxy add its own match rule and signal handler.
+ */
+#define MANAGER_PROPERTY_MATCH \
+  "type='signal',sender='" CONNMAN_SERVICE "',member='PropertyChanged'"
+
+static CmRegistryKind
+manager_registry_kind (const gchar *interface)
+{
+  if (!interface)
+    return REGISTRY_LAST;
+  if (!strcmp (interface, CONNMAN_SERVICE_INTERFACE))
+    return REGISTRY_SERVICES;
+  if (!strcmp (interface, CONNMAN_NETWORK_INTERFACE))
+    return REGISTRY_NETWORKS;
+  if (!strcmp (interface, CONNMAN_DEVICE_INTERFACE))
+    return REGISTRY_DEVICES;
+  if (!strcmp (interface, CONNMAN_CONNECTION_INTERFACE))
+    return REGISTRY_CONNECTIONS;
+
+  return REGISTRY_LAST;
+}
+
+/* Hand a PropertyChanged value to the object registered for its path */
+static void
+manager_property_dispatch (CmRegistryKind kind, gpointer object,
+                           const gchar *key, GValue *value)
+{
+  switch (kind)
+  {
+  case REGISTRY_DEVICES:
+    internal_device_property_changed (object, key, value);
+    break;
+  case REGISTRY_SERVICES:
+    internal_service_property_changed (object, key, value);
+    break;
+  case REGISTRY_CONNECTIONS:
+    internal_connection_property_changed (object, key, value);
+    break;
+  case REGISTRY_NETWORKS:
+    internal_network_property_changed (object, key, value);
+    break;
+  case REGISTRY_LAST:
+  default:
+    break;
+  }
+}
+
+#ifndef CM_TRANSPORT_GDBUS
+static DBusHandlerResult
+manager_property_filter (DBusConnection *connection, DBusMessage *message,
+                         void *data)
+{
+  CmManager *manager = data;
+  CmManagerPrivate *priv = manager->priv;
+  CmRegistryKind kind;
+  DBusMessageIter iter, variant;
+  const gchar *path, *key;
+  GValue value = { 0, };
+  gpointer object;
+
+  if (dbus_message_get_type (message) != DBUS_MESSAGE_TYPE_SIGNAL ||
+      g_strcmp0 (dbus_message_get_member (message), "PropertyChanged"))
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+  /* The manager's own changes arrive through its proxy */
+  kind = manager_registry_kind (dbus_message_get_interface (message));
+  if (kind == REGISTRY_LAST)
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+  path = dbus_message_get_path (message);
+  object = path ? manager_index_lookup (priv->index[kind], path) : NULL;
+  if (!object)
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+  if (!dbus_message_iter_init (message, &iter) ||
+      dbus_message_iter_get_arg_type (&iter) != DBUS_TYPE_STRING)
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+  dbus_message_iter_get_basic (&iter, &key);
+
+  if (!dbus_message_iter_next (&iter) ||
+      dbus_message_iter_get_arg_type (&iter) != DBUS_TYPE_VARIANT)
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+  dbus_message_iter_recurse (&iter, &variant);
+
+  if (!internal_property_value_from_iter (&variant, &value))
+  {
+    g_debug ("Unhandled type '%c' for %s on %s\n",
+             dbus_message_iter_get_arg_type (&variant), key, path);
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+  }
+
+  manager_property_dispatch (kind, object, key, &value);
+  g_value_unset (&value);
+
+  /* Leave the message to anyone else on the connection */
+  return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+#endif
+
 static void
 manager_name_owner_changed_cb (DBusGProxy  *proxy,
                                const gchar *name,
@@ -557,41 +1989,117 @@ manager_name_owner_changed_cb (DBusGProxy  *proxy,
   if (g_str_equal (name, CONNMAN_SERVICE) == FALSE)
     return; /* Don't care about non ConnMan events */
 
-  if (!new) /* No new owner, ConnMan gone away? */
+  /* The bus reports a missing owner as an empty name */
+  if (!new || *new == '\0') /* No new owner, ConnMan gone away? */
   {
-    /* Tidy up lists and report offline state */
-    while (priv->devices)
-    {
-      g_object_unref (priv->devices->data);
-      priv->devices = g_list_delete_link (priv->devices, priv->devices);
-    }
-    while (priv->connections)
-    {
-      g_object_unref (priv->connections->data);
-      priv->connections = g_list_delete_link (priv->connections,
-                                              priv->connections);
-    }
-    while (priv->services)
-    {
-      g_object_unref (priv->services->data);
-      priv->services = g_list_delete_link (priv->services, priv->services);
-    }
+    /*
+     * Tidy up lists and report offline state.  An incremental refresh
+     * keeps the objects around to be reconciled when ConnMan returns.
+     */
+    manager_fetch_cancel_all (manager);
+    priv->ready = FALSE;
+    priv->refreshing = FALSE;
+    if (!priv->incremental_refresh)
+      manager_release_objects (manager);
     g_free (priv->state);
     priv->state = g_strdup ("unavailable");
     g_signal_emit (manager, manager_signals[SIGNAL_STATE_CHANGED], 0);
   }
-  else if (new && g_strcmp0 (new, CONNMAN_SERVICE) == 0)
+  else
   {
-    /* Owner changed, refresh lists */
+    /* ConnMan is back under a new unique name, refresh lists */
     cm_manager_refresh (manager);
   }
 }
 
-gboolean
-manager_set_dbus_connection (CmManager *manager, GError **error)
+#ifdef CM_TRANSPORT_GDBUS
+/*
+ * With GDBus, signals are received on the connection that carries the
+ * GetProperties replies, so a reply can never be applied over a newer
+ * PropertyChanged, nor after the NameOwnerChanged that cancelled it.
+ */
+static void
+manager_property_signal_cb (GDBusConnection *connection,
+                            const gchar     *sender,
+                            const gchar     *path,
+                            const gchar     *interface,
+                            const gchar     *signal,
+                            GVariant        *parameters,
+                            gpointer         data)
+{
+  CmManager *manager = data;
+  CmManagerPrivate *priv = manager->priv;
+  CmRegistryKind kind = REGISTRY_LAST;
+  GValue value = { 0, };
+  const gchar *key;
+  GVariant *variant;
+  gpointer object;
+
+  if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(sv)")))
+    return;
+
+  if (!g_strcmp0 (interface, CONNMAN_MANAGER_INTERFACE))
+  {
+    if (g_strcmp0 (path, CONNMAN_MANAGER_PATH))
+      return;
+    object = manager;
+  }
+  else
+  {
+    kind = manager_registry_kind (interface);
+    if (kind == REGISTRY_LAST)
+      return;
+
+    object = manager_index_lookup (priv->index[kind], path);
+    if (!object)
+      return;
+  }
+
+  g_variant_get (parameters, "(&sv)", &key, &variant);
+  if (!internal_property_value_from_variant (variant, &value))
+  {
+    g_debug ("Unhandled type '%s' for %s on %s\n",
+             g_variant_get_type_string (variant), key, path);
+    g_variant_unref (variant);
+    return;
+  }
+
+  if (object == manager)
+    manager_property_change_handler_proxy (NULL, key, &value, manager);
+  else
+    manager_property_dispatch (kind, object, key, &value);
+
+  g_value_unset (&value);
+  g_variant_unref (variant);
+}
+
+static void
+manager_name_owner_signal_cb (GDBusConnection *connection,
+                              const gchar     *sender,
+                              const gchar     *path,
+                              const gchar     *interface,
+                              const gchar     *signal,
+                              GVariant        *parameters,
+                              gpointer         data)
+{
+  const gchar *name, *previous, *new;
+
+  if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(sss)")))
+    return;
+
+  g_variant_get (parameters, "(&s&s&s)", &name, &previous, &new);
+  manager_name_owner_changed_cb (NULL, name, previous, new, data);
+}
+#endif
+
+/* Connect to the bus at address, or to the system bus when it is NULL */
+static gboolean
+manager_set_dbus_connection (CmManager *manager, const gchar *address,
+                             GError **error)
 {
   static gboolean dbus_init = FALSE;
   CmManagerPrivate *priv = manager->priv;
+  DBusError dbus_error;
 
   if (!dbus_init)
   {
@@ -614,9 +2122,47 @@ manager_set_dbus_connection (CmManager *manager, GError **error)
                                        G_TYPE_INVALID);
   }
 
-  priv->connection = dbus_g_bus_get (DBUS_BUS_SYSTEM, error);
-  if (!priv->connection)
+  if (!address)
+  {
+    priv->connection = dbus_g_bus_get (DBUS_BUS_SYSTEM, error);
+    if (!priv->connection)
+      return FALSE;
+  }
+  else
+  {
+    priv->connection = dbus_g_connection_open (address, error);
+    if (!priv->connection)
+      return FALSE;
+
+    /* A plain connection has to say hello before it can talk to names */
+    dbus_error_init (&dbus_error);
+    if (!dbus_bus_register (
+          dbus_g_connection_get_connection (priv->connection), &dbus_error))
+    {
+      dbus_set_g_error (error, &dbus_error);
+      dbus_error_free (&dbus_error);
+      dbus_g_connection_unref (priv->connection);
+      priv->connection = NULL;
+      return FALSE;
+    }
+  }
+
+#ifdef CM_TRANSPORT_GDBUS
+  if (!address)
+    priv->gdbus = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, error);
+  else
+    priv->gdbus = g_dbus_connection_new_for_address_sync (
+      address,
+      G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+      G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+      NULL, NULL, error);
+  if (!priv->gdbus)
+  {
+    dbus_g_connection_unref (priv->connection);
+    priv->connection = NULL;
     return FALSE;
+  }
+#endif
 
   priv->proxy = dbus_g_proxy_new_for_name(
     priv->connection,
@@ -627,16 +2173,31 @@ manager_set_dbus_connection (CmManager *manager, GError **error)
                  "Unable to obtain proxy for %s:%s/%s",
                  CONNMAN_SERVICE, CONNMAN_MANAGER_PATH,
                  CONNMAN_MANAGER_INTERFACE);
-    g_object_unref (priv->connection);
+    dbus_g_connection_unref (priv->connection);
     priv->connection = NULL;
     return FALSE;
   }
 
-  dbus_g_proxy_add_signal (priv->proxy, "NameOwnerChanged",
+#ifdef CM_TRANSPORT_GDBUS
+  priv->owner_subscription = g_dbus_connection_signal_subscribe (
+    priv->gdbus, DBUS_SERVICE_DBUS, DBUS_INTERFACE_DBUS, "NameOwnerChanged",
+    DBUS_PATH_DBUS, CONNMAN_SERVICE, G_DBUS_SIGNAL_FLAGS_NONE,
+    manager_name_owner_signal_cb, manager, NULL);
+
+  /* PropertyChanged from the manager and every object it has registered */
+  priv->property_subscription = g_dbus_connection_signal_subscribe (
+    priv->gdbus, CONNMAN_SERVICE, NULL, "PropertyChanged", NULL, NULL,
+    G_DBUS_SIGNAL_FLAGS_NONE, manager_property_signal_cb, manager, NULL);
+#else
+  /* NameOwnerChanged comes from the bus, not from ConnMan */
+  priv->bus_proxy = dbus_g_proxy_new_for_name (
+    priv->connection, DBUS_SERVICE_DBUS, DBUS_PATH_DBUS, DBUS_INTERFACE_DBUS);
+
+  dbus_g_proxy_add_signal (priv->bus_proxy, "NameOwnerChanged",
                            G_TYPE_STRING, G_TYPE_STRING,
                            G_TYPE_STRING, G_TYPE_INVALID);
 
-  dbus_g_proxy_connect_signal (priv->proxy, "NameOwnerChanged",
+  dbus_g_proxy_connect_signal (priv->bus_proxy, "NameOwnerChanged",
                                G_CALLBACK (manager_name_owner_changed_cb),
                                manager, NULL);
 
@@ -649,17 +2210,83 @@ manager_set_dbus_connection (CmManager *manager, GError **error)
     G_CALLBACK (manager_property_change_handler_proxy),
     manager, NULL);
 
+  if (!dbus_connection_add_filter (
+        dbus_g_connection_get_connection (priv->connection),
+        manager_property_filter, manager, NULL))
+  {
+    g_set_error (error, MANAGER_ERROR, MANAGER_ERROR_NO_CONNMAN,
+                 "Unable to listen for PropertyChanged from %s",
+                 CONNMAN_SERVICE);
+    return FALSE;
+  }
+  priv->filtering = TRUE;
+
+  /* Sent without waiting for the bus to reply */
+  dbus_bus_add_match (dbus_g_connection_get_connection (priv->connection),
+                      MANAGER_PROPERTY_MATCH, NULL);
+#endif
+
   return TRUE;
 }
 
 CmManager *
 cm_manager_new (GError **error, gboolean low_level)
+{
+  return cm_manager_new_with_flags (error,
+                                    low_level ? MANAGER_FLAG_LOW_LEVEL : 0);
+}
+
+/*
+ * Create a manager pre-populated from the snapshot in filename.  A missing
+ * or unreadable snapshot is not an error; the manager then simply starts
+ * out empty.
+ */
+CmManager *
+cm_manager_new_from_snapshot (GError **error, CmManagerFlags flags,
+                              const gchar *filename)
+{
+  CmManager *manager;
+  GError *snapshot_error = NULL;
+
+  manager = cm_manager_new_with_flags (error, flags);
+  if (!manager)
+    return NULL;
+
+  if (!cm_manager_load_snapshot (manager, filename, &snapshot_error))
+  {
+    g_debug ("Not using snapshot: %s\n", snapshot_error->message);
+    g_error_free (snapshot_error);
+  }
+
+  return manager;
+}
+
+/*
+ * With MANAGER_FLAG_LAZY_SERVICES, services are created as just a path
+ * and an order; each reads its properties the first time one is asked
+ * for, or when it is pinned with cm_service_pin().
+ */
+CmManager *
+cm_manager_new_with_flags (GError **error, CmManagerFlags flags)
+{
+  return cm_manager_new_for_address (error, flags, NULL);
+}
+
+/*
+ * Create a manager that looks for ConnMan on the bus at address rather
+ * than on the system bus, e.g. a private bus running a test daemon.
+ * With a NULL address this is cm_manager_new_with_flags().
+ */
+CmManager *
+cm_manager_new_for_address (GError **error, CmManagerFlags flags,
+                            const gchar *address)
 {
   CmManager *manager = g_object_new (CM_TYPE_MANAGER, NULL);
   CmManagerPrivate *priv = manager->priv;
-  priv->low_level = low_level;
+  priv->low_level = (flags & MANAGER_FLAG_LOW_LEVEL) != 0;
+  priv->lazy_services = (flags & MANAGER_FLAG_LAZY_SERVICES) != 0;
 
-  if (manager_set_dbus_connection (manager, error))
+  if (manager_set_dbus_connection (manager, address, error))
     return manager;
   g_object_unref (manager);
   return NULL;
@@ -672,7 +2299,7 @@ manager_set_property_call_notify (DBusGProxy *proxy,
 {
   GError *error = NULL;
 
-  if (!dbus_g_proxy_end_call (proxy, call, &error, G_TYPE_INVALID))
+  if (!internal_stats_end_call (proxy, call, data, &error))
   {
     g_debug ("Error calling dbus_g_proxy_end_call in %s on Manager: %s",
              __FUNCTION__, error->message);
@@ -688,8 +2315,12 @@ manager_set_property (CmManager *manager, const gchar *property, GValue *value)
   DBusGProxyCall *call;
 
   call = dbus_g_proxy_begin_call (priv->proxy, "SetProperty",
-                                  manager_set_property_call_notify, NULL,
-                                  NULL, G_TYPE_STRING, property, G_TYPE_VALUE,
+                                  manager_set_property_call_notify,
+                                  internal_manager_stats_call (
+                                    manager, STATS_INTERFACE_MANAGER,
+                                    STATS_METHOD_SET_PROPERTY, NULL),
+                                  internal_stats_call_free,
+                                  G_TYPE_STRING, property, G_TYPE_VALUE,
                                   value, G_TYPE_INVALID);
 
   if (!call)
@@ -709,7 +2340,7 @@ manager_request_scan_call_notify (DBusGProxy *proxy,
 {
   GError *error = NULL;
 
-  if (!dbus_g_proxy_end_call (proxy, call, &error, G_TYPE_INVALID))
+  if (!internal_stats_end_call (proxy, call, data, &error))
   {
     g_debug ("Error calling dbus_g_proxy_end_call in %s on Manager: %s",
              __FUNCTION__, error->message);
@@ -724,7 +2355,7 @@ manager_generic_call_notify (DBusGProxy *proxy,
 {
   GError *error = NULL;
 
-  if (!dbus_g_proxy_end_call (proxy, call, &error, G_TYPE_INVALID))
+  if (!internal_stats_end_call (proxy, call, data, &error))
   {
     g_debug ("Error calling dbus_g_proxy_end_call in %s on Manager: %s",
              __FUNCTION__, error->message);
@@ -741,8 +2372,12 @@ manager_request_scan (CmManager *manager,
   DBusGProxyCall *call;
 
   call = dbus_g_proxy_begin_call (priv->proxy, "RequestScan",
-                                  manager_request_scan_call_notify, NULL,
-                                  NULL, G_TYPE_STRING, technology,
+                                  manager_request_scan_call_notify,
+                                  internal_manager_stats_call (
+                                    manager, STATS_INTERFACE_MANAGER,
+                                    STATS_METHOD_REQUEST_SCAN, NULL),
+                                  internal_stats_call_free,
+                                  G_TYPE_STRING, technology,
                                   G_TYPE_INVALID);
 
   if (!call)
@@ -790,6 +2425,42 @@ cm_manager_request_scan_devices (CmManager *manager,
   return ret;
 }
 
+/* Ask for a scan on every technology, reporting the outcome to callback */
+void
+cm_manager_request_scan_async (CmManager *manager,
+                               gint timeout,
+                               GCancellable *cancellable,
+                               GAsyncReadyCallback callback,
+                               gpointer user_data)
+{
+  CmManagerPrivate *priv = manager->priv;
+  CmAsyncCall *async;
+  DBusGProxyCall *call;
+
+  async = internal_async_call_new (manager, "RequestScan",
+                                   internal_manager_stats_call (
+                                     manager, STATS_INTERFACE_MANAGER,
+                                     STATS_METHOD_REQUEST_SCAN, NULL),
+                                   cancellable, callback, user_data,
+                                   cm_manager_request_scan_async);
+  call = dbus_g_proxy_begin_call_with_timeout (priv->proxy, "RequestScan",
+                                               internal_async_call_notify,
+                                               async, internal_async_call_free,
+                                               timeout,
+                                               G_TYPE_STRING, "",
+                                               G_TYPE_INVALID);
+  internal_async_call_start (async, priv->proxy, call);
+}
+
+gboolean
+cm_manager_request_scan_finish (CmManager *manager,
+                                GAsyncResult *result,
+                                GError **error)
+{
+  return internal_async_finish (manager, result, cm_manager_request_scan_async,
+                                error);
+}
+
 static void
 _free_g_value (GValue *value)
 {
@@ -804,7 +2475,7 @@ manager_connect_service_notify (DBusGProxy     *proxy,
 {
   GError *error = NULL;
 
-  if (!dbus_g_proxy_end_call (proxy, call, &error, G_TYPE_INVALID))
+  if (!internal_stats_end_call (proxy, call, user_data, &error))
   {
     g_debug ("Error calling dbus_g_proxy_end_call in %s: %s",
              __FUNCTION__, error->message);
@@ -821,7 +2492,10 @@ manager_connect_service (CmManager *manager,
 
   call = dbus_g_proxy_begin_call (priv->proxy, "ConnectService",
                                   manager_connect_service_notify,
-                                  NULL, NULL,
+                                  internal_manager_stats_call (
+                                    manager, STATS_INTERFACE_MANAGER,
+                                    STATS_METHOD_CONNECT, NULL),
+                                  internal_stats_call_free,
                                   dbus_g_type_get_map ("GHashTable",
                                                        G_TYPE_STRING,
                                                        G_TYPE_VALUE),
@@ -835,9 +2509,9 @@ manager_connect_service (CmManager *manager,
   return TRUE;
 }
 
-gboolean
-cm_manager_connect_wifi (CmManager *manager,
-                         const gchar *ssid,
+/* The ConnectService arguments for a wifi network */
+static GHashTable *
+manager_wifi_properties (const gchar *ssid,
                          const gchar *security,
                          const gchar *passphrase)
 {
@@ -851,24 +2525,24 @@ cm_manager_connect_wifi (CmManager *manager,
 
   type_v = g_slice_new0 (GValue);
   g_value_init (type_v, G_TYPE_STRING);
-  g_value_set_string (type_v, g_strdup ("wifi"));
+  g_value_set_string (type_v, "wifi");
   g_hash_table_insert (props, g_strdup ("Type"), type_v);
 
   mode_v = g_slice_new0 (GValue);
   g_value_init (mode_v, G_TYPE_STRING);
-  g_value_set_string (mode_v, g_strdup ("managed"));
+  g_value_set_string (mode_v, "managed");
   g_hash_table_insert (props, g_strdup ("Mode"), mode_v);
 
   ssid_v = g_slice_new0 (GValue);
   g_value_init (ssid_v, G_TYPE_STRING);
-  g_value_set_string (ssid_v, g_strdup (ssid));
+  g_value_set_string (ssid_v, ssid);
   g_hash_table_insert (props, g_strdup ("SSID"), ssid_v);
 
   if (security)
   {
     security_v = g_slice_new0 (GValue);
     g_value_init (security_v, G_TYPE_STRING);
-    g_value_set_string (security_v, g_strdup (security));
+    g_value_set_string (security_v, security);
     g_hash_table_insert (props, g_strdup ("Security"), security_v);
   }
 
@@ -876,11 +2550,94 @@ cm_manager_connect_wifi (CmManager *manager,
   {
     passphrase_v = g_slice_new0 (GValue);
     g_value_init (passphrase_v, G_TYPE_STRING);
-    g_value_set_string (passphrase_v, g_strdup (passphrase));
+    g_value_set_string (passphrase_v, passphrase);
     g_hash_table_insert (props, g_strdup ("Passphrase"), passphrase_v);
   }
 
-  return manager_connect_service (manager, props);
+  return props;
+}
+
+gboolean
+cm_manager_connect_wifi (CmManager *manager,
+                         const gchar *ssid,
+                         const gchar *security,
+                         const gchar *passphrase)
+{
+  GHashTable *props = manager_wifi_properties (ssid, security, passphrase);
+  gboolean ret;
+
+  /* The arguments are marshalled by the time the call is queued */
+  ret = manager_connect_service (manager, props);
+  g_hash_table_unref (props);
+
+  return ret;
+}
+
+static void
+manager_connect_service_async_notify (DBusGProxy *proxy,
+                                      DBusGProxyCall *call,
+                                      gpointer data)
+{
+  CmAsyncCall *async = data;
+  GError *error = NULL;
+  gchar *path = NULL;
+
+  if (dbus_g_proxy_end_call (proxy, call, &error,
+                             DBUS_TYPE_G_OBJECT_PATH, &path,
+                             G_TYPE_INVALID))
+    g_simple_async_result_set_op_res_gpointer (async->result, path, g_free);
+
+  internal_async_call_complete (async, error);
+}
+
+/*
+ * Connect to a wifi network, reporting the outcome to callback.  timeout
+ * is in milliseconds, -1 for the D-Bus default.
+ */
+void
+cm_manager_connect_wifi_async (CmManager *manager,
+                               const gchar *ssid,
+                               const gchar *security,
+                               const gchar *passphrase,
+                               gint timeout,
+                               GCancellable *cancellable,
+                               GAsyncReadyCallback callback,
+                               gpointer user_data)
+{
+  CmManagerPrivate *priv = manager->priv;
+  GHashTable *props = manager_wifi_properties (ssid, security, passphrase);
+  CmAsyncCall *async;
+  DBusGProxyCall *call;
+
+  async = internal_async_call_new (manager, "ConnectService",
+                                   internal_manager_stats_call (
+                                     manager, STATS_INTERFACE_MANAGER,
+                                     STATS_METHOD_CONNECT, NULL),
+                                   cancellable, callback, user_data,
+                                   cm_manager_connect_wifi_async);
+  call = dbus_g_proxy_begin_call_with_timeout (
+    priv->proxy, "ConnectService",
+    manager_connect_service_async_notify, async, internal_async_call_free,
+    timeout,
+    dbus_g_type_get_map ("GHashTable", G_TYPE_STRING, G_TYPE_VALUE), props,
+    G_TYPE_INVALID);
+  g_hash_table_unref (props);
+
+  internal_async_call_start (async, priv->proxy, call);
+}
+
+/* Returns the path of the service connected to, or NULL on error */
+gchar *
+cm_manager_connect_wifi_finish (CmManager *manager,
+                                GAsyncResult *result,
+                                GError **error)
+{
+  if (!internal_async_finish (manager, result, cm_manager_connect_wifi_async,
+                              error))
+    return NULL;
+
+  return g_strdup (g_simple_async_result_get_op_res_gpointer (
+                     G_SIMPLE_ASYNC_RESULT (result)));
 }
 
 gboolean
@@ -893,9 +2650,12 @@ cm_manager_enable_technology (CmManager *manager,
 
   call = dbus_g_proxy_begin_call (priv->proxy, 
 				  "EnableTechnology",
-                                  manager_generic_call_notify, 
-				  NULL, NULL, G_TYPE_STRING, 
-				  technology, G_TYPE_INVALID);
+                                  manager_generic_call_notify,
+                                  internal_manager_stats_call (
+                                    manager, STATS_INTERFACE_MANAGER,
+                                    STATS_METHOD_OTHER, NULL),
+                                  internal_stats_call_free,
+                                  G_TYPE_STRING, technology, G_TYPE_INVALID);
 
   if (!call)
   {
@@ -918,9 +2678,12 @@ cm_manager_disable_technology (CmManager *manager,
 
   call = dbus_g_proxy_begin_call (priv->proxy, 
 				  "DisableTechnology",
-                                  manager_generic_call_notify, 
-				  NULL, NULL, G_TYPE_STRING, technology,
-                                  G_TYPE_INVALID);
+                                  manager_generic_call_notify,
+                                  internal_manager_stats_call (
+                                    manager, STATS_INTERFACE_MANAGER,
+                                    STATS_METHOD_OTHER, NULL),
+                                  internal_stats_call_free,
+                                  G_TYPE_STRING, technology, G_TYPE_INVALID);
 
   if (!call)
   {
@@ -958,21 +2721,42 @@ const GList *
 cm_manager_get_available_technologies (CmManager *manager)
 {
   CmManagerPrivate *priv = manager->priv;
-  return priv->available_technologies;
+  return priv->available_technologies.names;
 }
 
 const GList *
 cm_manager_get_connected_technologies (CmManager *manager)
 {
   CmManagerPrivate *priv = manager->priv;
-  return priv->connected_technologies;
+  return priv->connected_technologies.names;
 }
 
 const GList *
 cm_manager_get_enabled_technologies (CmManager *manager)
 {
   CmManagerPrivate *priv = manager->priv;
-  return priv->enabled_technologies;
+  return priv->enabled_technologies.names;
+}
+
+gboolean
+cm_manager_is_technology_available (CmManager *manager, CmDeviceType type)
+{
+  CmManagerPrivate *priv = manager->priv;
+  return (priv->available_technologies.mask & CM_TECHNOLOGY_BIT (type)) != 0;
+}
+
+gboolean
+cm_manager_is_technology_connected (CmManager *manager, CmDeviceType type)
+{
+  CmManagerPrivate *priv = manager->priv;
+  return (priv->connected_technologies.mask & CM_TECHNOLOGY_BIT (type)) != 0;
+}
+
+gboolean
+cm_manager_is_technology_enabled (CmManager *manager, CmDeviceType type)
+{
+  CmManagerPrivate *priv = manager->priv;
+  return (priv->enabled_technologies.mask & CM_TECHNOLOGY_BIT (type)) != 0;
 }
 
 gboolean
@@ -996,6 +2780,28 @@ cm_manager_set_offline_mode (CmManager *manager, gboolean offline)
   return ret;
 }
 
+CmServiceTable *
+internal_manager_get_service_table (CmManager *manager)
+{
+  return manager->priv->service_table;
+}
+
+/*
+ * The first service in ConnMan's order whose strength is above
+ * min_strength, only considering favorites if favorite_only is set, or
+ * NULL if there is none.  Lazy services count once their properties
+ * have been read.
+ */
+CmService *
+cm_manager_get_best_service (CmManager *manager, guint min_strength,
+                             gboolean favorite_only)
+{
+  CmManagerPrivate *priv = manager->priv;
+
+  return internal_service_table_best (priv->service_table, min_strength,
+                                      favorite_only);
+}
+
 /*
  * The list of services is sorted by connman so the active service
  * should always be the first item in our list
@@ -1065,6 +2871,39 @@ manager_dispose (GObject *object)
 {
   CmManager *manager = CM_MANAGER (object);
   CmManagerPrivate *priv = manager->priv;
+  GHashTableIter iter;
+  gpointer pending;
+
+  /* Objects go away below, so stop handing them signals first */
+#ifndef CM_TRANSPORT_GDBUS
+  if (priv->filtering)
+  {
+    dbus_bus_remove_match (
+      dbus_g_connection_get_connection (priv->connection),
+      MANAGER_PROPERTY_MATCH, NULL);
+    dbus_connection_remove_filter (
+      dbus_g_connection_get_connection (priv->connection),
+      manager_property_filter, manager);
+    priv->filtering = FALSE;
+  }
+#endif
+
+  if (priv->update_idle)
+  {
+    g_source_remove (priv->update_idle);
+    priv->update_idle = 0;
+  }
+
+  /* Drop queued updates without emitting them */
+  g_hash_table_iter_init (&iter, priv->pending_updates);
+  while (g_hash_table_iter_next (&iter, &pending, NULL))
+    g_object_unref (pending);
+  g_hash_table_remove_all (priv->pending_updates);
+
+  manager_fetch_cancel_all (manager);
+
+  manager_pending_clear (manager);
+  manager_clear_registry (manager);
 
   while (priv->devices)
   {
@@ -1080,23 +2919,57 @@ manager_dispose (GObject *object)
 
   while (priv->services)
   {
+    internal_service_unlist (priv->services->data);
     g_object_unref (priv->services->data);
     priv->services = g_list_delete_link (priv->services, priv->services);
   }
 
   if (priv->proxy)
   {
+#ifndef CM_TRANSPORT_GDBUS
     dbus_g_proxy_disconnect_signal (
     priv->proxy, "PropertyChanged",
     G_CALLBACK (manager_property_change_handler_proxy),
     manager);
+#endif
 
     g_object_unref (priv->proxy);
     priv->proxy = NULL;
   }
 
+  if (priv->bus_proxy)
+  {
+    dbus_g_proxy_disconnect_signal (
+    priv->bus_proxy, "NameOwnerChanged",
+    G_CALLBACK (manager_name_owner_changed_cb),
+    manager);
+
+    g_object_unref (priv->bus_proxy);
+    priv->bus_proxy = NULL;
+  }
+
   if (priv->connection)
+  {
     dbus_g_connection_unref (priv->connection);
+    priv->connection = NULL;
+  }
+
+#ifdef CM_TRANSPORT_GDBUS
+  if (priv->gdbus)
+  {
+    if (priv->owner_subscription)
+      g_dbus_connection_signal_unsubscribe (priv->gdbus,
+                                            priv->owner_subscription);
+    if (priv->property_subscription)
+      g_dbus_connection_signal_unsubscribe (priv->gdbus,
+                                            priv->property_subscription);
+    priv->owner_subscription = 0;
+    priv->property_subscription = 0;
+
+    g_object_unref (priv->gdbus);
+    priv->gdbus = NULL;
+  }
+#endif
 
   G_OBJECT_CLASS (manager_parent_class)->dispose (object);
 }
@@ -1106,15 +2979,36 @@ manager_finalize (GObject *object)
 {
   CmManager *manager = CM_MANAGER (object);
   CmManagerPrivate *priv = manager->priv;
+  gint i;
 
   g_free (priv->state);
 
+  g_list_free (priv->available_technologies.names);
+  g_list_free (priv->connected_technologies.names);
+  g_list_free (priv->enabled_technologies.names);
+
+  for (i = 0; i < REGISTRY_LAST; i++)
+    g_hash_table_destroy (priv->index[i]);
+
+  manager_pending_clear (manager);
+  for (i = 0; i < REGISTRY_LAST; i++)
+  {
+    g_hash_table_destroy (priv->pending[i]);
+    g_hash_table_destroy (priv->pending_waiters[i]);
+  }
+  g_hash_table_destroy (priv->pending_updates);
+  g_queue_free (priv->fetch_queue);
+  internal_stats_unref (priv->stats);
+  internal_service_table_unref (priv->service_table);
+
   G_OBJECT_CLASS (manager_parent_class)->finalize (object);
 }
 
 static void
 manager_init (CmManager *self)
 {
+  gint i;
+
   self->priv = CM_MANAGER_GET_PRIVATE (self);
   self->priv->state = NULL;
   self->priv->offline_mode = FALSE;
@@ -1122,6 +3016,38 @@ manager_init (CmManager *self)
   self->priv->devices = NULL;
   self->priv->connections = NULL;
   self->priv->low_level = FALSE;
+  self->priv->lazy_services = FALSE;
+  for (i = 0; i < REGISTRY_LAST; i++)
+  {
+    self->priv->index[i] = manager_index_new ();
+    self->priv->pending[i] = g_hash_table_new (g_direct_hash,
+                                               g_direct_equal);
+    self->priv->pending_waiters[i] = g_hash_table_new (g_direct_hash,
+                                                       g_direct_equal);
+  }
+
+  self->priv->coalesce = FALSE;
+  self->priv->pending_updates = g_hash_table_new (g_direct_hash,
+                                                  g_direct_equal);
+  self->priv->update_idle = 0;
+
+  self->priv->fetch_queue = g_queue_new ();
+  self->priv->fetch_in_flight = NULL;
+  self->priv->n_in_flight = 0;
+  self->priv->ready = FALSE;
+
+  self->priv->incremental_refresh = FALSE;
+  self->priv->refreshing = FALSE;
+
+  self->priv->loading_snapshot = FALSE;
+  self->priv->snapshot_loaded = FALSE;
+
+  self->priv->stats = internal_stats_new ();
+  self->priv->service_table = internal_service_table_new ();
+
+  self->priv->strength_min_delta = 0;
+  self->priv->strength_hysteresis = 0;
+  self->priv->strength_interval = 0;
 }
 
 static void
@@ -1205,6 +3131,77 @@ manager_class_init (CmManagerClass *klass)
     g_cclosure_marshal_VOID__VOID,
     G_TYPE_NONE, 0);
 
+  /*
+   * The *-delta signals carry three GLists (added, removed, moved) that
+   * are only valid during the emission.  Removed objects are still alive
+   * while the handlers run.
+   */
+  manager_signals[SIGNAL_DEVICES_DELTA] = g_signal_new (
+    "devices-delta",
+    G_TYPE_FROM_CLASS (gobject_class),
+    G_SIGNAL_RUN_LAST,
+    0,
+    NULL, NULL,
+    connman_marshal_VOID__POINTER_POINTER_POINTER,
+    G_TYPE_NONE, 3, G_TYPE_POINTER, G_TYPE_POINTER, G_TYPE_POINTER);
+  manager_signals[SIGNAL_SERVICES_DELTA] = g_signal_new (
+    "services-delta",
+    G_TYPE_FROM_CLASS (gobject_class),
+    G_SIGNAL_RUN_LAST,
+    0,
+    NULL, NULL,
+    connman_marshal_VOID__POINTER_POINTER_POINTER,
+    G_TYPE_NONE, 3, G_TYPE_POINTER, G_TYPE_POINTER, G_TYPE_POINTER);
+  manager_signals[SIGNAL_CONNECTIONS_DELTA] = g_signal_new (
+    "connections-delta",
+    G_TYPE_FROM_CLASS (gobject_class),
+    G_SIGNAL_RUN_LAST,
+    0,
+    NULL, NULL,
+    connman_marshal_VOID__POINTER_POINTER_POINTER,
+    G_TYPE_NONE, 3, G_TYPE_POINTER, G_TYPE_POINTER, G_TYPE_POINTER);
+
+  /*
+   * The technologies-delta signals carry the CM_TECHNOLOGY_BIT()s that
+   * were added and removed; neither is emitted when no known technology
+   * came or went.
+   */
+  manager_signals[SIGNAL_AVAILABLE_TECHNOLOGIES_DELTA] = g_signal_new (
+    "available-technologies-delta",
+    G_TYPE_FROM_CLASS (gobject_class),
+    G_SIGNAL_RUN_LAST,
+    0,
+    NULL, NULL,
+    connman_marshal_VOID__UINT_UINT,
+    G_TYPE_NONE, 2, G_TYPE_UINT, G_TYPE_UINT);
+  manager_signals[SIGNAL_CONNECTED_TECHNOLOGIES_DELTA] = g_signal_new (
+    "connected-technologies-delta",
+    G_TYPE_FROM_CLASS (gobject_class),
+    G_SIGNAL_RUN_LAST,
+    0,
+    NULL, NULL,
+    connman_marshal_VOID__UINT_UINT,
+    G_TYPE_NONE, 2, G_TYPE_UINT, G_TYPE_UINT);
+  manager_signals[SIGNAL_ENABLED_TECHNOLOGIES_DELTA] = g_signal_new (
+    "enabled-technologies-delta",
+    G_TYPE_FROM_CLASS (gobject_class),
+    G_SIGNAL_RUN_LAST,
+    0,
+    NULL, NULL,
+    connman_marshal_VOID__UINT_UINT,
+    G_TYPE_NONE, 2, G_TYPE_UINT, G_TYPE_UINT);
+  manager_signals[SIGNAL_READY] = g_signal_new (
+    "manager-ready",
+    G_TYPE_FROM_CLASS (gobject_class),
+    G_SIGNAL_RUN_LAST,
+    0,
+    NULL, NULL,
+    g_cclosure_marshal_VOID__VOID,
+    G_TYPE_NONE, 0);
+
   g_type_class_add_private (gobject_class, sizeof (CmManagerPrivate));
+
+  manager_property_table = internal_property_table_new (
+    manager_properties, G_N_ELEMENTS (manager_properties));
 }
 
@@ -32,6 +32,7 @@ typedef struct _CmManagerPrivate CmManagerPrivate;
 #include <gconnman/gconnman.h>
 #include <gconnman/cm-service.h>
 #include <gconnman/cm-connection.h>
+#include <gconnman/cm-stats.h>
 
 G_BEGIN_DECLS
 
@@ -65,12 +66,28 @@ typedef enum
 {
   MANAGER_ERROR_NO_CONNMAN, /* DBus failed to connect to Connman service */
   MANAGER_ERROR_CONNMAN_GET_PROPERTIES, /* GetProperties failed on Manager */
+  MANAGER_ERROR_SNAPSHOT_INVALID, /* Snapshot is corrupt or incompatible */
 } CmManagerError;
 
+typedef enum
+{
+  MANAGER_FLAG_LOW_LEVEL     = 1 << 0, /* Track devices and connections */
+  MANAGER_FLAG_LAZY_SERVICES = 1 << 1, /* Services are read on first use */
+} CmManagerFlags;
+
 #define CONNMAN_MANAGER_INTERFACE	CONNMAN_SERVICE ".Manager"
 #define CONNMAN_MANAGER_PATH		"/"
 
 CmManager *cm_manager_new (GError **error, gboolean low_level);
+CmManager *cm_manager_new_with_flags (GError **error, CmManagerFlags flags);
+CmManager *cm_manager_new_for_address (GError **error, CmManagerFlags flags,
+                                       const gchar *address);
+CmManager *cm_manager_new_from_snapshot (GError **error, CmManagerFlags flags,
+                                         const gchar *filename);
+gboolean cm_manager_save_snapshot (CmManager *manager, const gchar *filename,
+                                   GError **error);
+gboolean cm_manager_load_snapshot (CmManager *manager, const gchar *filename,
+                                   GError **error);
 /* getters */
 const GList *cm_manager_get_devices (CmManager *manager);
 const GList *cm_manager_get_connections (CmManager *manager);
@@ -78,20 +95,71 @@ const GList *cm_manager_get_services (CmManager *manager);
 const GList *cm_manager_get_available_technologies (CmManager *manager);
 const GList *cm_manager_get_connected_technologies (CmManager *manager);
 const GList *cm_manager_get_enabled_technologies (CmManager *manager);
+
+/* A technology's bit in the masks of the *-technologies-delta signals */
+#define CM_TECHNOLOGY_BIT(type) (1u << (type))
+
+gboolean cm_manager_is_technology_available (CmManager *manager,
+                                             CmDeviceType type);
+gboolean cm_manager_is_technology_connected (CmManager *manager,
+                                             CmDeviceType type);
+gboolean cm_manager_is_technology_enabled (CmManager *manager,
+                                           CmDeviceType type);
 gboolean cm_manager_get_offline_mode (CmManager *manager);
 gboolean cm_manager_set_offline_mode (CmManager *manager, gboolean offline);
 const gchar *cm_manager_get_state (CmManager *manager);
 CmService *cm_manager_get_active_service (CmManager *manager);
+CmService *cm_manager_get_best_service (CmManager *manager,
+                                        guint min_strength,
+                                        gboolean favorite_only);
 CmConnection *cm_manager_get_active_connection (CmManager *manager);
 const gchar *cm_manager_get_policy (CmManager *manager);
 gboolean cm_manager_set_policy (CmManager *manager, gchar *policy);
 
 gboolean cm_manager_refresh (CmManager *manager);
+gboolean cm_manager_is_ready (CmManager *manager);
+void cm_manager_set_incremental_refresh (CmManager *manager,
+                                         gboolean incremental);
+gboolean cm_manager_get_incremental_refresh (CmManager *manager);
+
+void cm_manager_get_stats (CmManager *manager, CmStats *stats);
+void cm_manager_reset_stats (CmManager *manager);
+
+void cm_manager_set_coalesce_updates (CmManager *manager, gboolean coalesce);
+gboolean cm_manager_get_coalesce_updates (CmManager *manager);
+
+/* Only report Strength changes of min_delta or more, at most every interval ms */
+void cm_manager_set_strength_filter (CmManager *manager, guint min_delta,
+                                     guint hysteresis, guint interval);
+void cm_manager_get_strength_filter (CmManager *manager, guint *min_delta,
+                                     guint *hysteresis, guint *interval);
 
 gboolean cm_manager_request_scan (CmManager *manager);
 gboolean cm_manager_request_scan_devices (CmManager *manager, CmDeviceType type);
 gboolean cm_manager_connect_wifi (CmManager *manager, const gchar *ssid,
                                   const gchar *security, const gchar *passphrase);
+
+/*
+ * Asynchronous variants.  timeout is the call's deadline in milliseconds,
+ * -1 for the D-Bus default; callback always runs, from the main loop,
+ * with G_IO_ERROR_CANCELLED if cancellable was cancelled first.
+ */
+void cm_manager_request_scan_async (CmManager *manager, gint timeout,
+                                    GCancellable *cancellable,
+                                    GAsyncReadyCallback callback,
+                                    gpointer user_data);
+gboolean cm_manager_request_scan_finish (CmManager *manager,
+                                         GAsyncResult *result,
+                                         GError **error);
+void cm_manager_connect_wifi_async (CmManager *manager, const gchar *ssid,
+                                    const gchar *security,
+                                    const gchar *passphrase, gint timeout,
+                                    GCancellable *cancellable,
+                                    GAsyncReadyCallback callback,
+                                    gpointer user_data);
+gchar *cm_manager_connect_wifi_finish (CmManager *manager,
+                                       GAsyncResult *result, GError **error);
+
 gboolean cm_manager_enable_technology (CmManager *manager, 
 				       const gchar *technology);
 gboolean cm_manager_disable_technology (CmManager *manager, 
@@ -100,6 +168,7 @@ CmDevice *cm_manager_find_device (CmManager *manager, const gchar *opath);
 CmService *cm_manager_find_service (CmManager *manager, const gchar *opath);
 CmConnection *cm_manager_find_connection (CmManager *manager,
                                           const gchar *opath);
+CmNetwork *cm_manager_find_network (CmManager *manager, const gchar *opath);
 
 G_END_DECLS
 
@@ -62,16 +62,19 @@ struct _CmNetworkPrivate
   gint ssid_len;
   gchar *ssid_printable;
   guchar strength;
+  CmStrengthFilter strength_filter;
   guchar priority;
   gboolean connected;
   gchar *name;
-  gchar *mode;
-  gchar *security;
+  const gchar *mode;     /* interned */
+  const gchar *security; /* interned */
+  CmSecurity security_enum;
   gchar *passphrase;
   gchar *address;
-  uint frequency;
-  uint channel;
+  guint frequency;
+  guint channel;
   CmNetworkInfoMask flags;
+  CmNetworkInfoMask changed; /* fields changed since the last "updated" */
   time_t last_update;
 };
 
@@ -90,6 +93,7 @@ enum
   SIGNAL_CHANNEL_CHANGED,
   SIGNAL_FREQUENCY_CHANGED,
   SIGNAL_PRIORITY_CHANGED,
+  SIGNAL_UPDATE_MASK,
   SIGNAL_LAST
 };
 
@@ -101,10 +105,40 @@ network_error_quark (void)
   return g_quark_from_static_string ("network-error-quark");
 }
 
+/* Emit "network-updated", and the mask signal if anything changed */
 static void
-network_emit_updated (CmNetwork *network)
+network_emit_update_signals (CmNetwork *network)
 {
+  CmNetworkPrivate *priv = network->priv;
+  CmNetworkInfoMask changed = priv->changed;
+
+  priv->changed = 0;
   g_signal_emit (network, network_signals[SIGNAL_UPDATE], 0 /* detail */);
+  if (changed)
+    g_signal_emit (network, network_signals[SIGNAL_UPDATE_MASK], 0, changed);
+}
+
+/*
+ * A coalesced flush with nothing to report, e.g. after a refresh that
+ * confirmed the cached values, stays quiet
+ */
+static void
+network_flush_updated (CmNetwork *network)
+{
+  if (network->priv->changed)
+    network_emit_update_signals (network);
+}
+
+static void
+network_emit_updated (CmNetwork *network)
+{
+  CmNetworkPrivate *priv = network->priv;
+
+  /* Uncoalesced, "network-updated" goes out every time, as it always has */
+  if (!priv->manager ||
+      !internal_manager_queue_update (priv->manager, G_OBJECT (network),
+                                      (CmUpdateFunc) network_flush_updated))
+    network_emit_update_signals (network);
 }
 
 
@@ -115,9 +149,6 @@ static inline gulong network_timer_elapsed_ms(const struct timeval *t1,
     (t2->tv_usec - t1->tv_usec) / 1000;
 }
 
-static void network_property_change_handler_proxy (DBusGProxy *, const gchar *,
-						   GValue *, gpointer);
-
 static gchar *
 network_printable_ssid_new (const guchar *ssid, int len)
 {
@@ -142,171 +173,307 @@ network_update_timestamp (CmNetwork *network)
   priv->last_update = time (NULL);
 }
 
+static gboolean
+network_decode_ssid (gpointer object, const GValue *value)
+{
+  CmNetworkPrivate *priv = CM_NETWORK (object)->priv;
+  GArray *ssid_bytes = NULL;
+  gint i;
+
+  if (G_VALUE_HOLDS_BOXED (value))
+    ssid_bytes = g_value_get_boxed (value);
+
+  if (ssid_bytes && priv->ssid && ssid_bytes->len == priv->ssid_len &&
+      memcmp (ssid_bytes->data, priv->ssid, priv->ssid_len) == 0)
+    return FALSE;
+
+  g_free (priv->ssid);
+  g_free (priv->ssid_printable);
+  priv->ssid = NULL;
+  priv->ssid_printable = NULL;
+
+  if (!ssid_bytes)
+    return TRUE;
+
+  priv->ssid_len = ssid_bytes->len;
+  priv->ssid = g_new0 (guchar, ssid_bytes->len);
+  for (i = 0; i < priv->ssid_len; i++)
+    priv->ssid[i] = g_array_index (ssid_bytes, guchar, i);
+  priv->ssid_printable = network_printable_ssid_new (
+    priv->ssid, priv->ssid_len);
+  priv->flags |= NETWORK_INFO_SSID;
+  priv->changed |= NETWORK_INFO_SSID;
+
+  return TRUE;
+}
+
+static gboolean
+network_decode_security (gpointer object, const GValue *value)
+{
+  CmNetworkPrivate *priv = CM_NETWORK (object)->priv;
+
+  priv->security_enum = internal_security_from_string (priv->security);
+
+  return TRUE;
+}
+
+static gboolean
+network_decode_passphrase (gpointer object, const GValue *value)
+{
+  CmNetworkPrivate *priv = CM_NETWORK (object)->priv;
+  const gchar *passphrase = g_value_get_string (value);
+
+  /* An empty passphrase means there is none */
+  if (passphrase && !strlen (passphrase))
+    passphrase = NULL;
+
+  if (g_strcmp0 (priv->passphrase, passphrase) == 0)
+    return FALSE;
+
+  g_free (priv->passphrase);
+  priv->passphrase = g_strdup (passphrase);
+  if (priv->passphrase)
+    priv->flags |= NETWORK_INFO_PASSPHRASE;
+  else
+    priv->flags &= ~NETWORK_INFO_PASSPHRASE;
+  priv->changed |= NETWORK_INFO_PASSPHRASE;
+
+  return TRUE;
+}
+
+/*
+ * The device is not ours and a connection can keep the network alive
+ * past it, so it is held by a weak pointer that clears when it goes.
+ */
+static void
+network_set_device (CmNetwork *network, CmDevice *device)
+{
+  CmNetworkPrivate *priv = network->priv;
+
+  if (priv->device)
+    g_object_remove_weak_pointer (G_OBJECT (priv->device),
+                                  (gpointer *) &priv->device);
+
+  priv->device = device;
+
+  if (priv->device)
+    g_object_add_weak_pointer (G_OBJECT (priv->device),
+                               (gpointer *) &priv->device);
+}
+
+/* The device registered after our Device property named it */
+static void
+network_device_resolved (GObject *object, gpointer device)
+{
+  CmNetwork *network = CM_NETWORK (object);
+
+  if (network->priv->device == device)
+    return;
+
+  network_set_device (network, device);
+  g_signal_emit (network, network_signals[SIGNAL_DEVICE_CHANGED], 0);
+}
+
+/* A device still to register keeps the old one until it does */
+static gboolean
+network_decode_device (gpointer object, const GValue *value)
+{
+  CmNetworkPrivate *priv = CM_NETWORK (object)->priv;
+  gchar *path = g_value_get_boxed (value);
+  CmDevice *device;
+
+  device = internal_manager_resolve (priv->manager, REGISTRY_DEVICES, path,
+                                     G_OBJECT (object),
+                                     network_device_resolved);
+  if (!device || device == priv->device)
+    return FALSE;
+
+  network_set_device (CM_NETWORK (object), device);
+  return TRUE;
+}
+
+/* Strength goes through the manager's filter */
+static gboolean
+network_decode_strength (gpointer object, const GValue *value)
+{
+  CmNetworkPrivate *priv = CM_NETWORK (object)->priv;
+  guchar strength = g_value_get_uchar (value);
+
+  if (!internal_manager_filter_strength (priv->manager, &priv->strength_filter,
+                                         strength))
+    return FALSE;
+
+  priv->strength = strength;
+  return TRUE;
+}
+
+/* A Strength the filter held back, now due */
+static void
+network_publish_strength (gpointer object, guchar strength)
+{
+  CmNetwork *network = object;
+  CmNetworkPrivate *priv = network->priv;
+
+  priv->strength = strength;
+  priv->changed |= NETWORK_INFO_STRENGTH;
+  g_signal_emit (network, network_signals[SIGNAL_STRENGTH_CHANGED], 0);
+  network_emit_updated (network);
+}
+
+#define NETWORK_FIELD(field) G_STRUCT_OFFSET (CmNetworkPrivate, field)
+
+/* SSID and Passphrase maintain their own mask bits */
+static const CmProperty network_properties[] =
+{
+  { "WiFi.SSID", PROPERTY_CUSTOM, 0,
+    SIGNAL_SSID_CHANGED, 0, network_decode_ssid },
+  { "Strength", PROPERTY_CUSTOM, 0,
+    SIGNAL_STRENGTH_CHANGED, NETWORK_INFO_STRENGTH, network_decode_strength },
+  { "Priority", PROPERTY_BYTE, NETWORK_FIELD (priority),
+    SIGNAL_PRIORITY_CHANGED, NETWORK_INFO_PRIORITY, NULL },
+  { "Connected", PROPERTY_BOOLEAN, NETWORK_FIELD (connected),
+    SIGNAL_CONNECTED_CHANGED, NETWORK_INFO_CONNECTED, NULL },
+  { "WiFi.Mode", PROPERTY_INTERNED, NETWORK_FIELD (mode),
+    SIGNAL_MODE_CHANGED, NETWORK_INFO_MODE, NULL },
+  { "WiFi.Security", PROPERTY_INTERNED, NETWORK_FIELD (security),
+    SIGNAL_SECURITY_CHANGED, NETWORK_INFO_SECURITY, network_decode_security },
+  { "WiFi.Passphrase", PROPERTY_CUSTOM, 0,
+    SIGNAL_PASSPHRASE_CHANGED, 0, network_decode_passphrase },
+  { "WiFi.Channel", PROPERTY_UINT, NETWORK_FIELD (channel),
+    SIGNAL_CHANNEL_CHANGED, NETWORK_INFO_CHANNEL, NULL },
+  { "Name", PROPERTY_STRING, NETWORK_FIELD (name),
+    SIGNAL_NAME_CHANGED, NETWORK_INFO_NAME, NULL },
+  { "Address", PROPERTY_STRING, NETWORK_FIELD (address),
+    SIGNAL_ADDRESS_CHANGED, NETWORK_INFO_ADDRESS, NULL },
+  { "Frequency", PROPERTY_UINT, NETWORK_FIELD (frequency),
+    SIGNAL_FREQUENCY_CHANGED, NETWORK_INFO_FREQUENCY, NULL },
+  { "Device", PROPERTY_CUSTOM, 0,
+    SIGNAL_DEVICE_CHANGED, 0, network_decode_device },
+};
+
+static GHashTable *network_property_table;
+
 static void
 network_update_property (const gchar *key, GValue *value, CmNetwork *network)
 {
   CmNetworkPrivate *priv = network->priv;
+  const CmProperty *property;
+  gboolean changed;
   gchar *tmp;
 
   network_update_timestamp (network);
 
-  if (!strcmp ("WiFi.SSID", key))
-  {
-    GArray *ssid_bytes;
-    gint i;
-
-    g_free (priv->ssid);
-    g_free (priv->ssid_printable);
-
-    if (!G_VALUE_HOLDS_BOXED (value))
-    {
-      tmp = g_strdup_value_contents (value);
-      g_free (tmp);
-    }
-    else
-    {
-      ssid_bytes = g_value_get_boxed (value);
-
-      priv->ssid_len = ssid_bytes->len;
-      priv->ssid = g_new0 (guchar, ssid_bytes->len);
-      for (i = 0; i < priv->ssid_len; i++)
-        priv->ssid[i] = g_array_index (ssid_bytes, guchar, i);
-      priv->ssid_printable = network_printable_ssid_new (
-        priv->ssid, priv->ssid_len);
-      priv->flags |= NETWORK_INFO_SSID;
-    }
-    g_signal_emit (network, network_signals[SIGNAL_SSID_CHANGED], 0);
-  }
-  else if (!strcmp ("Strength", key))
-  {
-    priv->strength = g_value_get_uchar (value);
-    priv->flags |= NETWORK_INFO_STRENGTH;
-    g_signal_emit (network, network_signals[SIGNAL_STRENGTH_CHANGED], 0);
-  }
-  else if (!strcmp ("Priority", key))
-  {
-    priv->priority = g_value_get_uchar (value);
-    priv->flags |= NETWORK_INFO_PRIORITY;
-    g_signal_emit (network, network_signals[SIGNAL_PRIORITY_CHANGED], 0);
-  }
-  else if (!strcmp ("Connected", key))
-  {
-    priv->connected = g_value_get_boolean (value);
-    priv->flags |= NETWORK_INFO_CONNECTED;
-    g_signal_emit (network, network_signals[SIGNAL_CONNECTED_CHANGED], 0);
-  }
-  else if (!strcmp ("WiFi.Mode", key))
-  {
-    g_free (priv->mode);
-    priv->mode = g_value_dup_string (value);
-    priv->flags |= NETWORK_INFO_MODE;
-    g_signal_emit (network, network_signals[SIGNAL_MODE_CHANGED], 0);
-  }
-  else if (!strcmp ("WiFi.Security", key))
-  {
-    g_free (priv->security);
-    priv->security = g_value_dup_string (value);
-    priv->flags |= NETWORK_INFO_SECURITY;
-    g_signal_emit (network, network_signals[SIGNAL_SECURITY_CHANGED], 0);
-  }
-  else if (!strcmp ("WiFi.Passphrase", key))
-  {
-    gchar *passphrase = g_value_dup_string (value);
-    g_free (priv->passphrase);
-    if (strlen (passphrase))
-    {
-      priv->passphrase = passphrase;
-      priv->flags |= NETWORK_INFO_PASSPHRASE;
-    }
-    else
-    {
-      priv->passphrase = NULL;
-      priv->flags &= ~NETWORK_INFO_PASSPHRASE;
-    }
-    g_signal_emit (network, network_signals[SIGNAL_PASSPHRASE_CHANGED], 0);
-  }
-  else if (!strcmp ("WiFi.Channel", key))
-  {
-    priv->channel = g_value_get_uint (value);
-    priv->flags |= NETWORK_INFO_CHANNEL;
-    g_signal_emit (network, network_signals[SIGNAL_CHANNEL_CHANGED], 0);
-  }
-  else if (!strcmp ("Name", key))
-  {
-    g_free (priv->name);
-    priv->name = g_value_dup_string (value);
-    priv->flags |= NETWORK_INFO_NAME;
-    g_signal_emit (network, network_signals[SIGNAL_NAME_CHANGED], 0);
-  }
-  else if (!strcmp ("Address", key))
-  {
-    g_free (priv->address);
-    priv->address = g_value_dup_string (value);
-    priv->flags |= NETWORK_INFO_ADDRESS;
-    g_signal_emit (network, network_signals[SIGNAL_ADDRESS_CHANGED], 0);
-  }
-  else if (!strcmp ("Frequency", key))
-  {
-    priv->frequency = g_value_get_uint (value);
-    priv->flags |= NETWORK_INFO_FREQUENCY;
-    g_signal_emit (network, network_signals[SIGNAL_FREQUENCY_CHANGED], 0);
-  }
-  else if (!strcmp ("Device", key))
-  {
-    gchar *path = g_value_get_boxed (value);
-    priv->device = cm_manager_find_device (priv->manager, path);
-    g_signal_emit (network, network_signals[SIGNAL_DEVICE_CHANGED], 0);
-  }
-  else
+  property = internal_property_apply (network_property_table, network, priv,
+                                      key, value, &changed);
+  if (!property)
   {
     tmp = g_strdup_value_contents (value);
     g_debug ("Unhandled Network property on %s: %s = %s\n",
              cm_network_get_name (network), key, tmp);
     g_free (tmp);
+    return;
   }
+
+  priv->flags |= property->mask;
+  if (!changed)
+    return;
+
+  priv->changed |= property->mask;
+  g_signal_emit (network, network_signals[property->signal], 0);
+}
+
+void
+internal_network_property_changed (CmNetwork *network, const gchar *key,
+                                   GValue *value)
+{
+  internal_manager_stats_signal (network->priv->manager,
+                                 STATS_INTERFACE_NETWORK);
+  network_update_property (key, value, network);
+
   network_emit_updated (network);
 }
 
-static void
-network_property_change_handler_proxy (DBusGProxy *proxy,
-				       const gchar *key,
-				       GValue *value,
-				       gpointer data)
+void
+internal_network_apply_properties (CmNetwork *network, GHashTable *properties)
 {
-  CmNetwork *network = data;
+  g_hash_table_foreach (properties, (GHFunc)network_update_property, network);
+  network_emit_updated (network);
+}
 
-  network_update_property (key, value, network);
+#ifdef CM_TRANSPORT_GDBUS
+/* internal_network_apply_properties(), from a GetProperties reply */
+void
+internal_network_apply_variant (CmNetwork *network, GVariant *properties)
+{
+  CmNetworkPrivate *priv = network->priv;
+  const CmProperty *property;
+  GVariantIter iter;
+  const gchar *key;
+  GVariant *value;
+  gboolean changed;
+
+  network_update_timestamp (network);
+
+  g_variant_iter_init (&iter, properties);
+  while (g_variant_iter_loop (&iter, "{&sv}", &key, &value))
+  {
+    property = internal_property_apply_variant (network_property_table,
+                                                network, priv, key, value,
+                                                &changed);
+    if (!property)
+    {
+      g_debug ("Unhandled Network property on %s: %s\n",
+               cm_network_get_name (network), key);
+      continue;
+    }
+
+    priv->flags |= property->mask;
+    if (!changed)
+      continue;
+
+    priv->changed |= property->mask;
+    g_signal_emit (network, network_signals[property->signal], 0);
+  }
 
   network_emit_updated (network);
 }
+#endif
 
-static void
-network_get_properties_call_notify (DBusGProxy *proxy,
-                                    DBusGProxyCall *call,
-                                    gpointer data)
+/* The inverse of network_update_property, for snapshots */
+void
+internal_network_export_properties (CmNetwork *network, GHashTable *values)
 {
-  CmNetwork *network = data;
-  GError *error = NULL;
-  GHashTable *properties = NULL;
-  gint count;
-
-  if (!dbus_g_proxy_end_call (proxy, call, &error,
-                              /* OUT values */
-                              dbus_g_type_get_map ("GHashTable",
-                                                   G_TYPE_STRING,
-                                                   G_TYPE_VALUE),
-                              &properties, G_TYPE_INVALID))
+  CmNetworkPrivate *priv = network->priv;
+  GArray *ssid;
+
+  internal_property_export (network_property_table, priv, values);
+  g_value_set_uchar (
+    internal_property_values_add (values, "Strength", G_TYPE_UCHAR),
+    priv->strength);
+
+  if (priv->ssid)
   {
-    g_print ("Error calling dbus_g_proxy_end_call in %s on %s: %s\n",
-             __FUNCTION__, cm_network_get_name (network), error->message);
-    g_error_free (error);
-    return;
+    ssid = g_array_sized_new (FALSE, FALSE, sizeof (guchar), priv->ssid_len);
+    g_array_append_vals (ssid, priv->ssid, priv->ssid_len);
+    g_value_take_boxed (
+      internal_property_values_add (values, "WiFi.SSID",
+                                    DBUS_TYPE_G_UCHAR_ARRAY),
+      ssid);
   }
 
-  count = g_hash_table_size (properties);
+  if (priv->passphrase)
+    g_value_set_string (
+      internal_property_values_add (values, "WiFi.Passphrase", G_TYPE_STRING),
+      priv->passphrase);
+}
+
+void
+internal_network_fetch_properties (CmNetwork *network)
+{
+  CmNetworkPrivate *priv = network->priv;
 
-  g_hash_table_foreach (properties, (GHFunc)network_update_property, network);
-  g_hash_table_unref (properties);
+  internal_manager_get_properties (priv->manager, G_OBJECT (network), priv->proxy,
+                                   (CmPropertiesFunc) internal_network_apply_properties);
 }
 
 CmNetwork *
@@ -316,7 +483,6 @@ internal_network_new (DBusGProxy *proxy,
 {
   CmNetwork *network;
   CmNetworkPrivate *priv;
-  DBusGProxyCall *call;
 
   network = g_object_new (CM_TYPE_NETWORK, NULL);
   if (!network)
@@ -327,7 +493,7 @@ internal_network_new (DBusGProxy *proxy,
   }
 
   priv = network->priv;
-  priv->device = device;
+  network_set_device (network, device);
   priv->manager = manager;
 
   priv->path = g_strdup (path);
@@ -349,26 +515,7 @@ internal_network_new (DBusGProxy *proxy,
     return NULL;
   }
 
-  dbus_g_proxy_add_signal (
-    priv->proxy, "PropertyChanged",
-    G_TYPE_STRING, G_TYPE_VALUE, G_TYPE_INVALID);
-
-  dbus_g_proxy_connect_signal (
-    priv->proxy, "PropertyChanged",
-    G_CALLBACK (network_property_change_handler_proxy),
-    network, NULL);
-
-  call = dbus_g_proxy_begin_call (priv->proxy, "GetProperties",
-                                  network_get_properties_call_notify,
-                                  network, NULL,
-                                  G_TYPE_INVALID);
-  if (!call)
-  {
-    g_set_error (error, NETWORK_ERROR, NETWORK_ERROR_CONNMAN_GET_PROPERTIES,
-                 "Invocation of GetProperties failed.");
-    g_object_unref (network);
-    return NULL;
-  }
+  internal_network_fetch_properties (network);
 
   return network;
 }
@@ -417,7 +564,14 @@ cm_network_is_secure (const CmNetwork *network)
   CmNetworkPrivate *priv = network->priv;
   if (!(priv->flags & NETWORK_INFO_SECURITY))
     return FALSE;
-  return strcmp ("none", priv->security) ? 1 : 0;
+  return priv->security_enum != SECURITY_NONE;
+}
+
+CmSecurity
+cm_network_get_security_enum (const CmNetwork *network)
+{
+  CmNetworkPrivate *priv = network->priv;
+  return priv->security_enum;
 }
 
 guchar
@@ -453,10 +607,10 @@ network_set_property_call_notify (DBusGProxy *proxy,
 				  DBusGProxyCall *call,
 				  gpointer data)
 {
-  CmNetwork *network = data;
+  CmNetwork *network = internal_stats_call_data (data);
   GError *error = NULL;
 
-  if (!dbus_g_proxy_end_call (proxy, call, &error, G_TYPE_INVALID))
+  if (!internal_stats_end_call (proxy, call, data, &error))
   {
     g_debug ("Error calling dbus_g_proxy_end_call in %s on %s: %s\n",
              __FUNCTION__, cm_network_get_name (network), error->message);
@@ -473,8 +627,12 @@ cm_network_set_property (CmNetwork *network, const gchar *property,
   DBusGProxyCall *call;
 
   call = dbus_g_proxy_begin_call (priv->proxy, "SetProperty",
-                                  network_set_property_call_notify, network,
-                                  NULL, G_TYPE_STRING, property,
+                                  network_set_property_call_notify,
+                                  internal_manager_stats_call (
+                                    priv->manager, STATS_INTERFACE_NETWORK,
+                                    STATS_METHOD_SET_PROPERTY, network),
+                                  internal_stats_call_free,
+                                  G_TYPE_STRING, property,
                                   G_TYPE_VALUE, value, G_TYPE_INVALID);
 
   if (!call)
@@ -519,14 +677,14 @@ gchar *
 cm_network_get_mode (CmNetwork *network)
 {
   CmNetworkPrivate *priv = network->priv;
-  return priv->mode;
+  return (gchar *) priv->mode;
 }
 
 gchar *
 cm_network_get_address (CmNetwork *network)
 {
   CmNetworkPrivate *priv = network->priv;
-  return priv->mode;
+  return (gchar *) priv->mode;
 }
 
 const gchar *
@@ -553,14 +711,12 @@ network_dispose (GObject *object)
 
   if (priv->proxy)
   {
-    dbus_g_proxy_disconnect_signal (
-      priv->proxy, "PropertyChanged",
-      G_CALLBACK (network_property_change_handler_proxy),
-      network);
-
+    g_object_unref (priv->proxy);
     priv->proxy = NULL;
   }
 
+  internal_strength_filter_clear (&priv->strength_filter);
+  network_set_device (network, NULL);
   priv->manager = NULL;
 
   G_OBJECT_CLASS (network_parent_class)->dispose (object);
@@ -576,10 +732,8 @@ network_finalize (GObject *object)
   g_free (priv->ssid);
   g_free (priv->ssid_printable);
   g_free (priv->path);
-  g_free (priv->security);
   g_free (priv->passphrase);
   g_free (priv->address);
-  g_free (priv->mode);
 
   G_OBJECT_CLASS (network_parent_class)->finalize (object);
 }
@@ -588,11 +742,14 @@ static void
 network_init (CmNetwork *self)
 {
   self->priv = CM_NETWORK_GET_PRIVATE (self);
+  internal_strength_filter_init (&self->priv->strength_filter, self,
+                                 network_publish_strength);
   self->priv->name = NULL;
   self->priv->ssid = NULL;
   self->priv->ssid_printable = NULL;
   self->priv->path = NULL;
   self->priv->security = NULL;
+  self->priv->security_enum = SECURITY_UNKNOWN;
   self->priv->passphrase = NULL;
   self->priv->address = NULL;
   self->priv->address = NULL;
@@ -705,7 +862,19 @@ network_class_init (CmNetworkClass *klass)
     NULL, NULL,
     g_cclosure_marshal_VOID__VOID,
     G_TYPE_NONE, 0);
+  /* "network-updated" with the CmNetworkInfoMask that changed, if any */
+  network_signals[SIGNAL_UPDATE_MASK] = g_signal_new (
+    "network-updated-mask",
+    G_TYPE_FROM_CLASS (gobject_class),
+    G_SIGNAL_RUN_LAST,
+    0,
+    NULL, NULL,
+    g_cclosure_marshal_VOID__UINT,
+    G_TYPE_NONE, 1, G_TYPE_UINT);
 
   g_type_class_add_private (gobject_class, sizeof (CmNetworkPrivate));
+
+  network_property_table = internal_property_table_new (
+    network_properties, G_N_ELEMENTS (network_properties));
 }
 
@@ -89,6 +89,7 @@ const gchar *cm_network_get_name (const CmNetwork *network);
 const gchar *cm_network_get_path (CmNetwork *network);
 gboolean cm_network_is_connected (const CmNetwork *network);
 gboolean cm_network_is_secure (const CmNetwork *network);
+CmSecurity cm_network_get_security_enum (const CmNetwork *network);
 gulong cm_network_get_timestamp (const CmNetwork *network);
 guchar cm_network_get_strength (const CmNetwork *network);
 guchar cm_network_get_priority (const CmNetwork *network);
@@ -0,0 +1,669 @@
+/*
+ * Gconnman - a GObject wrapper for the Connman D-Bus API
+ * Copyright © 2009, Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ */
+
+/*
+ * Table driven decoding of ConnMan properties.
+ *
+ * Each object type describes the properties it understands with a static
+ * array of CmProperty descriptors, which is turned into a GQuark keyed
+ * table once at class_init time.  Decoding a property is then a quark
+ * lookup followed by a store through the descriptor's field offset, in
+ * place of a chain of strcmp() calls per object type.
+ */
+#include <glib.h>
+#include <glib-object.h>
+#include <string.h> /* strcmp */
+
+#include "gconnman-internal.h"
+
+GHashTable *
+internal_property_table_new (const CmProperty *properties, guint n_properties)
+{
+  GHashTable *table = g_hash_table_new (g_direct_hash, g_direct_equal);
+  guint i;
+
+  for (i = 0; i < n_properties; i++)
+    g_hash_table_insert (
+      table, GUINT_TO_POINTER (g_quark_from_static_string (properties[i].name)),
+      (gpointer) &properties[i]);
+
+  return table;
+}
+
+const CmProperty *
+internal_property_lookup (GHashTable *table, const gchar *key)
+{
+  /* Keys we have never seen are not interned, and can't be in the table */
+  GQuark quark = g_quark_try_string (key);
+
+  if (!quark)
+    return NULL;
+
+  return g_hash_table_lookup (table, GUINT_TO_POINTER (quark));
+}
+
+/*
+ * Decode value into the field described by key's descriptor.  object is
+ * handed to decode functions, priv is the private struct the descriptor
+ * offsets are relative to.  *changed is set to whether the stored value
+ * differs from the previous one, as reported by the decode function for
+ * custom properties.  Returns NULL if key is not in the table.
+ */
+const CmProperty *
+internal_property_apply (GHashTable *table, gpointer object, gpointer priv,
+                         const gchar *key, const GValue *value,
+                         gboolean *changed)
+{
+  const CmProperty *property = internal_property_lookup (table, key);
+
+  *changed = FALSE;
+
+  if (!property)
+    return NULL;
+
+  switch (property->type)
+  {
+  case PROPERTY_STRING:
+  {
+    gchar **field = G_STRUCT_MEMBER_P (priv, property->offset);
+    const gchar *str = g_value_get_string (value);
+
+    if (g_strcmp0 (*field, str) != 0)
+    {
+      g_free (*field);
+      *field = g_strdup (str);
+      *changed = TRUE;
+    }
+    break;
+  }
+
+  case PROPERTY_INTERNED:
+  {
+    const gchar **field = G_STRUCT_MEMBER_P (priv, property->offset);
+    const gchar *str = g_intern_string (g_value_get_string (value));
+
+    *changed = *field != str;
+    *field = str;
+    break;
+  }
+
+  case PROPERTY_BOOLEAN:
+  {
+    gboolean *field = G_STRUCT_MEMBER_P (priv, property->offset);
+    gboolean b = g_value_get_boolean (value) ? TRUE : FALSE;
+
+    *changed = *field != b;
+    *field = b;
+    break;
+  }
+
+  case PROPERTY_BYTE:
+  {
+    guchar *field = G_STRUCT_MEMBER_P (priv, property->offset);
+    guchar byte = g_value_get_uchar (value);
+
+    *changed = *field != byte;
+    *field = byte;
+    break;
+  }
+
+  case PROPERTY_UINT:
+  {
+    guint *field = G_STRUCT_MEMBER_P (priv, property->offset);
+    guint u = g_value_get_uint (value);
+
+    *changed = *field != u;
+    *field = u;
+    break;
+  }
+
+  case PROPERTY_CUSTOM:
+    *changed = property->decode (object, value);
+    break;
+
+  case PROPERTY_IGNORE:
+    break;
+  }
+
+  if (property->type != PROPERTY_CUSTOM && *changed && property->decode)
+    property->decode (object, value);
+
+  return property;
+}
+
+/*
+ * Read the value iter points at (the contents of a PropertyChanged
+ * variant) into value, with the GType dbus-glib would have given it.
+ * Returns FALSE, leaving value unset, for a type no property uses.
+ */
+gboolean
+internal_property_value_from_iter (DBusMessageIter *iter, GValue *value)
+{
+  DBusMessageIter array;
+  const gchar *str;
+  dbus_bool_t b;
+  dbus_uint32_t u;
+  dbus_uint16_t q;
+  dbus_int32_t i;
+  guchar byte;
+  GPtrArray *paths;
+  GArray *bytes;
+  GPtrArray *strv;
+
+  switch (dbus_message_iter_get_arg_type (iter))
+  {
+  case DBUS_TYPE_STRING:
+    dbus_message_iter_get_basic (iter, &str);
+    g_value_init (value, G_TYPE_STRING);
+    g_value_set_string (value, str);
+    return TRUE;
+
+  case DBUS_TYPE_OBJECT_PATH:
+    dbus_message_iter_get_basic (iter, &str);
+    g_value_init (value, DBUS_TYPE_G_OBJECT_PATH);
+    g_value_set_boxed (value, str);
+    return TRUE;
+
+  case DBUS_TYPE_BOOLEAN:
+    dbus_message_iter_get_basic (iter, &b);
+    g_value_init (value, G_TYPE_BOOLEAN);
+    g_value_set_boolean (value, b);
+    return TRUE;
+
+  case DBUS_TYPE_BYTE:
+    dbus_message_iter_get_basic (iter, &byte);
+    g_value_init (value, G_TYPE_UCHAR);
+    g_value_set_uchar (value, byte);
+    return TRUE;
+
+  case DBUS_TYPE_UINT16:
+    dbus_message_iter_get_basic (iter, &q);
+    g_value_init (value, G_TYPE_UINT);
+    g_value_set_uint (value, q);
+    return TRUE;
+
+  case DBUS_TYPE_UINT32:
+    dbus_message_iter_get_basic (iter, &u);
+    g_value_init (value, G_TYPE_UINT);
+    g_value_set_uint (value, u);
+    return TRUE;
+
+  case DBUS_TYPE_INT32:
+    dbus_message_iter_get_basic (iter, &i);
+    g_value_init (value, G_TYPE_INT);
+    g_value_set_int (value, i);
+    return TRUE;
+
+  case DBUS_TYPE_ARRAY:
+    break;
+
+  default:
+    return FALSE;
+  }
+
+  dbus_message_iter_recurse (iter, &array);
+
+  switch (dbus_message_iter_get_element_type (iter))
+  {
+  case DBUS_TYPE_OBJECT_PATH:
+    paths = g_ptr_array_new ();
+    for (; dbus_message_iter_get_arg_type (&array) != DBUS_TYPE_INVALID;
+         dbus_message_iter_next (&array))
+    {
+      dbus_message_iter_get_basic (&array, &str);
+      g_ptr_array_add (paths, g_strdup (str));
+    }
+    g_value_init (value, dbus_g_type_get_collection ("GPtrArray",
+                                                     DBUS_TYPE_G_OBJECT_PATH));
+    g_value_take_boxed (value, paths);
+    return TRUE;
+
+  case DBUS_TYPE_STRING:
+    strv = g_ptr_array_new ();
+    for (; dbus_message_iter_get_arg_type (&array) != DBUS_TYPE_INVALID;
+         dbus_message_iter_next (&array))
+    {
+      dbus_message_iter_get_basic (&array, &str);
+      g_ptr_array_add (strv, g_strdup (str));
+    }
+    g_ptr_array_add (strv, NULL);
+    g_value_init (value, G_TYPE_STRV);
+    g_value_take_boxed (value, g_ptr_array_free (strv, FALSE));
+    return TRUE;
+
+  case DBUS_TYPE_BYTE:
+    bytes = g_array_new (FALSE, FALSE, sizeof (guchar));
+    for (; dbus_message_iter_get_arg_type (&array) != DBUS_TYPE_INVALID;
+         dbus_message_iter_next (&array))
+    {
+      dbus_message_iter_get_basic (&array, &byte);
+      g_array_append_val (bytes, byte);
+    }
+    g_value_init (value, DBUS_TYPE_G_UCHAR_ARRAY);
+    g_value_take_boxed (value, bytes);
+    return TRUE;
+
+  default:
+    return FALSE;
+  }
+}
+
+/* The value of str in names, 0 (the enum's unknown) if it isn't there */
+gint
+internal_enum_from_string (const CmEnumName *names, guint n_names,
+                           const gchar *str)
+{
+  guint i;
+
+  if (!str)
+    return 0;
+
+  for (i = 0; i < n_names; i++)
+  {
+    if (!strcmp (str, names[i].name))
+      return names[i].value;
+  }
+
+  g_debug ("Unknown value: %s\n", str);
+  return 0;
+}
+
+static const CmEnumName ipv4_methods[] =
+{
+  { "dhcp", IPV4_METHOD_DHCP },
+  { "manual", IPV4_METHOD_MANUAL },
+  { "fixed", IPV4_METHOD_FIXED },
+  { "off", IPV4_METHOD_OFF },
+};
+
+CmIPv4Method
+internal_ipv4_method_from_string (const gchar *method)
+{
+  return internal_enum_from_string (ipv4_methods, G_N_ELEMENTS (ipv4_methods),
+                                    method);
+}
+
+static const CmEnumName securities[] =
+{
+  { "none", SECURITY_NONE },
+  { "wep", SECURITY_WEP },
+  { "psk", SECURITY_PSK },
+  { "wpa", SECURITY_WPA },
+  { "rsn", SECURITY_RSN },
+  { "ieee8021x", SECURITY_IEEE8021X },
+};
+
+CmSecurity
+internal_security_from_string (const gchar *security)
+{
+  return internal_enum_from_string (securities, G_N_ELEMENTS (securities),
+                                    security);
+}
+
+static void
+property_value_free (GValue *value)
+{
+  g_value_unset (value);
+  g_slice_free (GValue, value);
+}
+
+/* A property name -> GValue table, as GetProperties would return */
+GHashTable *
+internal_property_values_new (void)
+{
+  return g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                (GDestroyNotify) property_value_free);
+}
+
+/* Add key to values, returning its GValue initialised to type */
+GValue *
+internal_property_values_add (GHashTable *values, const gchar *key,
+                              GType type)
+{
+  GValue *value = g_slice_new0 (GValue);
+
+  g_value_init (value, type);
+  g_hash_table_insert (values, g_strdup (key), value);
+
+  return value;
+}
+
+/*
+ * The inverse of internal_property_apply(): add every plain property in
+ * table that holds a value to values.  Custom properties are left to the
+ * caller.
+ */
+void
+internal_property_export (GHashTable *table, gpointer priv,
+                          GHashTable *values)
+{
+  GHashTableIter iter;
+  gpointer key, data;
+
+  g_hash_table_iter_init (&iter, table);
+  while (g_hash_table_iter_next (&iter, &key, &data))
+  {
+    const CmProperty *property = data;
+
+    switch (property->type)
+    {
+    case PROPERTY_STRING:
+    {
+      const gchar *str = G_STRUCT_MEMBER (gchar *, priv, property->offset);
+
+      if (str)
+        g_value_set_string (internal_property_values_add (
+                              values, property->name, G_TYPE_STRING), str);
+      break;
+    }
+
+    case PROPERTY_INTERNED:
+    {
+      const gchar *str = G_STRUCT_MEMBER (const gchar *, priv,
+                                          property->offset);
+
+      if (str)
+        g_value_set_static_string (internal_property_values_add (
+                                     values, property->name, G_TYPE_STRING),
+                                   str);
+      break;
+    }
+
+    case PROPERTY_BOOLEAN:
+      g_value_set_boolean (
+        internal_property_values_add (values, property->name,
+                                      G_TYPE_BOOLEAN),
+        G_STRUCT_MEMBER (gboolean, priv, property->offset));
+      break;
+
+    case PROPERTY_BYTE:
+      g_value_set_uchar (
+        internal_property_values_add (values, property->name, G_TYPE_UCHAR),
+        G_STRUCT_MEMBER (guchar, priv, property->offset));
+      break;
+
+    case PROPERTY_UINT:
+      g_value_set_uint (
+        internal_property_values_add (values, property->name, G_TYPE_UINT),
+        G_STRUCT_MEMBER (guint, priv, property->offset));
+      break;
+
+    case PROPERTY_CUSTOM:
+    case PROPERTY_IGNORE:
+      break;
+    }
+  }
+}
+
+#ifdef CM_TRANSPORT_GDBUS
+
+/*
+ * GVariant decoding, for properties read over GDBus.
+ *
+ * Plain properties are compared against the variant in place, so an
+ * unchanged string costs no copy.  Decode functions still take a GValue
+ * of the type dbus-glib would have produced; it borrows the variant's
+ * strings rather than copying them, and only lives for the call.
+ */
+typedef struct
+{
+  GValue value;
+  gpointer container; /* freed after the value, if borrowed into */
+} CmBorrowedValue;
+
+static gboolean
+property_borrow_value (GVariant *variant, CmBorrowedValue *borrowed)
+{
+  GValue *value = &borrowed->value;
+  const GVariantType *type = g_variant_get_type (variant);
+  GPtrArray *paths;
+  GArray *bytes;
+  GVariantIter iter;
+  const gchar *path;
+  gconstpointer data;
+  gsize len;
+
+  borrowed->container = NULL;
+
+  if (g_variant_type_equal (type, G_VARIANT_TYPE_STRING))
+  {
+    g_value_init (value, G_TYPE_STRING);
+    g_value_set_static_string (value, g_variant_get_string (variant, NULL));
+  }
+  else if (g_variant_type_equal (type, G_VARIANT_TYPE_OBJECT_PATH))
+  {
+    g_value_init (value, DBUS_TYPE_G_OBJECT_PATH);
+    g_value_set_static_boxed (value, g_variant_get_string (variant, NULL));
+  }
+  else if (g_variant_type_equal (type, G_VARIANT_TYPE_BOOLEAN))
+  {
+    g_value_init (value, G_TYPE_BOOLEAN);
+    g_value_set_boolean (value, g_variant_get_boolean (variant));
+  }
+  else if (g_variant_type_equal (type, G_VARIANT_TYPE_BYTE))
+  {
+    g_value_init (value, G_TYPE_UCHAR);
+    g_value_set_uchar (value, g_variant_get_byte (variant));
+  }
+  else if (g_variant_type_equal (type, G_VARIANT_TYPE_UINT16))
+  {
+    g_value_init (value, G_TYPE_UINT);
+    g_value_set_uint (value, g_variant_get_uint16 (variant));
+  }
+  else if (g_variant_type_equal (type, G_VARIANT_TYPE_UINT32))
+  {
+    g_value_init (value, G_TYPE_UINT);
+    g_value_set_uint (value, g_variant_get_uint32 (variant));
+  }
+  else if (g_variant_type_equal (type, G_VARIANT_TYPE_INT32))
+  {
+    g_value_init (value, G_TYPE_INT);
+    g_value_set_int (value, g_variant_get_int32 (variant));
+  }
+  else if (g_variant_type_equal (type, G_VARIANT_TYPE ("ao")))
+  {
+    paths = g_ptr_array_sized_new (g_variant_n_children (variant));
+    g_variant_iter_init (&iter, variant);
+    while (g_variant_iter_next (&iter, "&o", &path))
+      g_ptr_array_add (paths, (gpointer) path);
+
+    g_value_init (value, dbus_g_type_get_collection ("GPtrArray",
+                                                     DBUS_TYPE_G_OBJECT_PATH));
+    g_value_set_static_boxed (value, paths);
+    borrowed->container = paths;
+  }
+  else if (g_variant_type_equal (type, G_VARIANT_TYPE_STRING_ARRAY))
+  {
+    g_value_init (value, G_TYPE_STRV);
+    borrowed->container = g_variant_get_strv (variant, NULL);
+    g_value_set_static_boxed (value, borrowed->container);
+  }
+  else if (g_variant_type_equal (type, G_VARIANT_TYPE_BYTESTRING))
+  {
+    /* A GArray can't borrow, so this one is a copy */
+    data = g_variant_get_fixed_array (variant, &len, sizeof (guchar));
+    bytes = g_array_sized_new (FALSE, FALSE, sizeof (guchar), len);
+    g_array_append_vals (bytes, data, len);
+    g_value_init (value, DBUS_TYPE_G_UCHAR_ARRAY);
+    g_value_take_boxed (value, bytes);
+  }
+  else
+    return FALSE;
+
+  return TRUE;
+}
+
+static void
+property_unborrow_value (CmBorrowedValue *borrowed)
+{
+  GValue *value = &borrowed->value;
+
+  if (borrowed->container && G_VALUE_HOLDS (value, G_TYPE_STRV))
+    g_free (borrowed->container);
+  else if (borrowed->container)
+    g_ptr_array_free (borrowed->container, TRUE);
+
+  g_value_unset (value);
+}
+
+/*
+ * internal_property_value_from_iter() for the variant of a PropertyChanged
+ * signal received with GDBus.  value owns its contents.
+ */
+gboolean
+internal_property_value_from_variant (GVariant *variant, GValue *value)
+{
+  CmBorrowedValue borrowed = { { 0, }, };
+
+  if (!property_borrow_value (variant, &borrowed))
+    return FALSE;
+
+  g_value_init (value, G_VALUE_TYPE (&borrowed.value));
+  g_value_copy (&borrowed.value, value);
+  property_unborrow_value (&borrowed);
+
+  return TRUE;
+}
+
+/*
+ * internal_property_apply() for a value from a GVariant.  A value of a
+ * type the descriptor can't take is reported and ignored.
+ */
+const CmProperty *
+internal_property_apply_variant (GHashTable *table, gpointer object,
+                                 gpointer priv, const gchar *key,
+                                 GVariant *variant, gboolean *changed)
+{
+  const CmProperty *property = internal_property_lookup (table, key);
+  CmBorrowedValue borrowed = { { 0, } };
+  const GVariantType *type;
+
+  *changed = FALSE;
+
+  if (!property)
+    return NULL;
+
+  type = g_variant_get_type (variant);
+
+  switch (property->type)
+  {
+  case PROPERTY_STRING:
+  {
+    gchar **field = G_STRUCT_MEMBER_P (priv, property->offset);
+    const gchar *str;
+
+    if (!g_variant_type_equal (type, G_VARIANT_TYPE_STRING))
+      goto mismatch;
+
+    str = g_variant_get_string (variant, NULL);
+    if (g_strcmp0 (*field, str) != 0)
+    {
+      g_free (*field);
+      *field = g_strdup (str);
+      *changed = TRUE;
+    }
+    break;
+  }
+
+  case PROPERTY_INTERNED:
+  {
+    const gchar **field = G_STRUCT_MEMBER_P (priv, property->offset);
+    const gchar *str;
+
+    if (!g_variant_type_equal (type, G_VARIANT_TYPE_STRING))
+      goto mismatch;
+
+    str = g_intern_string (g_variant_get_string (variant, NULL));
+    *changed = *field != str;
+    *field = str;
+    break;
+  }
+
+  case PROPERTY_BOOLEAN:
+  {
+    gboolean *field = G_STRUCT_MEMBER_P (priv, property->offset);
+    gboolean b;
+
+    if (!g_variant_type_equal (type, G_VARIANT_TYPE_BOOLEAN))
+      goto mismatch;
+
+    b = g_variant_get_boolean (variant) ? TRUE : FALSE;
+    *changed = *field != b;
+    *field = b;
+    break;
+  }
+
+  case PROPERTY_BYTE:
+  {
+    guchar *field = G_STRUCT_MEMBER_P (priv, property->offset);
+    guchar byte;
+
+    if (!g_variant_type_equal (type, G_VARIANT_TYPE_BYTE))
+      goto mismatch;
+
+    byte = g_variant_get_byte (variant);
+    *changed = *field != byte;
+    *field = byte;
+    break;
+  }
+
+  case PROPERTY_UINT:
+  {
+    guint *field = G_STRUCT_MEMBER_P (priv, property->offset);
+    guint u;
+
+    if (g_variant_type_equal (type, G_VARIANT_TYPE_UINT16))
+      u = g_variant_get_uint16 (variant);
+    else if (g_variant_type_equal (type, G_VARIANT_TYPE_UINT32))
+      u = g_variant_get_uint32 (variant);
+    else
+      goto mismatch;
+
+    *changed = *field != u;
+    *field = u;
+    break;
+  }
+
+  case PROPERTY_CUSTOM:
+    if (!property_borrow_value (variant, &borrowed))
+      goto mismatch;
+    *changed = property->decode (object, &borrowed.value);
+    property_unborrow_value (&borrowed);
+    break;
+
+  case PROPERTY_IGNORE:
+    break;
+  }
+
+  if (property->type != PROPERTY_CUSTOM && *changed && property->decode &&
+      property_borrow_value (variant, &borrowed))
+  {
+    property->decode (object, &borrowed.value);
+    property_unborrow_value (&borrowed);
+  }
+
+  return property;
+
+mismatch:
+  g_debug ("Unexpected type %s for property %s\n",
+           g_variant_get_type_string (variant), key);
+  return property;
+}
+
+#endif /* CM_TRANSPORT_GDBUS */
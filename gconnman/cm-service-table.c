@@ -0,0 +1,142 @@
+/*
+ * Gconnman - a GObject wrapper for the Connman D-Bus API
+ * Copyright © 2009, Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ */
+
+/*
+ * Packed service scalars.
+ *
+ * The fields used to rank services (order, state, strength, favorite,
+ * connected) live in one array owned by the manager rather than in each
+ * CmService, which only keeps its slot number.  Ranking all services is
+ * then a walk over a few bytes per service instead of a pointer chase
+ * through every object.  Freed slots are reused.  The table is
+ * reference counted so that a service outliving its manager still has
+ * its fields.
+ */
+#include <string.h> /* memset */
+#include <glib.h>
+
+#include "gconnman-internal.h"
+
+struct _CmServiceTable
+{
+  gint ref_count;
+  GArray *hot;        /* CmServiceHot */
+  GArray *free_slots; /* guint */
+};
+
+CmServiceTable *
+internal_service_table_new (void)
+{
+  CmServiceTable *table = g_slice_new0 (CmServiceTable);
+
+  table->ref_count = 1;
+  table->hot = g_array_new (FALSE, TRUE, sizeof (CmServiceHot));
+  table->free_slots = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  return table;
+}
+
+CmServiceTable *
+internal_service_table_ref (CmServiceTable *table)
+{
+  table->ref_count++;
+  return table;
+}
+
+void
+internal_service_table_unref (CmServiceTable *table)
+{
+  if (--table->ref_count > 0)
+    return;
+
+  g_array_free (table->hot, TRUE);
+  g_array_free (table->free_slots, TRUE);
+  g_slice_free (CmServiceTable, table);
+}
+
+/* A cleared slot for service, listed */
+guint
+internal_service_table_add (CmServiceTable *table, CmService *service)
+{
+  CmServiceHot *hot;
+  guint slot;
+
+  if (table->free_slots->len)
+  {
+    slot = g_array_index (table->free_slots, guint,
+                          table->free_slots->len - 1);
+    g_array_set_size (table->free_slots, table->free_slots->len - 1);
+  }
+  else
+  {
+    slot = table->hot->len;
+    g_array_set_size (table->hot, slot + 1);
+  }
+
+  hot = &g_array_index (table->hot, CmServiceHot, slot);
+  memset (hot, 0, sizeof (CmServiceHot));
+  hot->service = service;
+  hot->flags = SERVICE_HOT_LISTED;
+
+  return slot;
+}
+
+void
+internal_service_table_remove (CmServiceTable *table, guint slot)
+{
+  CmServiceHot *hot = &g_array_index (table->hot, CmServiceHot, slot);
+
+  hot->service = NULL;
+  hot->flags = 0;
+  g_array_append_val (table->free_slots, slot);
+}
+
+CmServiceHot *
+internal_service_table_get (CmServiceTable *table, guint slot)
+{
+  return &g_array_index (table->hot, CmServiceHot, slot);
+}
+
+/*
+ * The listed service first in ConnMan's order with a strength above
+ * min_strength, and a favorite if favorite_only is set.
+ */
+CmService *
+internal_service_table_best (CmServiceTable *table, guint min_strength,
+                             gboolean favorite_only)
+{
+  const CmServiceHot *hot = (const CmServiceHot *) table->hot->data;
+  const CmServiceHot *best = NULL;
+  guchar mask = SERVICE_HOT_LISTED;
+  guint i;
+
+  if (favorite_only)
+    mask |= SERVICE_HOT_FAVORITE;
+
+  for (i = 0; i < table->hot->len; i++)
+  {
+    if ((hot[i].flags & mask) != mask || hot[i].strength <= min_strength)
+      continue;
+
+    if (!best || hot[i].order < best->order)
+      best = &hot[i];
+  }
+
+  return best ? best->service : NULL;
+}
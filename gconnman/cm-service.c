@@ -38,26 +38,40 @@ struct _CmServicePrivate
   CmManager *manager;
 
   DBusGProxy *proxy;
+  DBusGProxy *manager_proxy; /* to create proxy from, for lazy services */
   gchar *path;
 
-  gchar *state;
+  /* order, strength, favorite, connected and the state enum */
+  CmServiceTable *table;
+  guint slot;
+
+  const gchar *state; /* interned, as are type, mode, security and method */
   gchar *name;
-  gchar *type;
-  gchar *mode;
-  gchar *security;
+  const gchar *type;
+  CmServiceType type_enum;
+  const gchar *mode;
+  CmServiceMode mode_enum;
+  const gchar *security;
+  CmSecurity security_enum;
   gchar *passphrase;
-  guint strength;
-  gint order;
-  gboolean favorite;
+  CmStrengthFilter strength_filter;
   gchar *error;
-  gchar *method;
+  const gchar *method;
+  CmIPv4Method method_enum;
 
-  gboolean connected;
   CmServiceInfoMask flags;
+  CmServiceInfoMask changed; /* fields changed since the last "updated" */
 
   gulong last_update;
+
+  /* GetProperties queued or in flight; refreshes wait for the next one */
+  guint fetching;
+  GList *refresh_waiters; /* GSimpleAsyncResult */
 };
 
+#define SERVICE_HOT(priv) \
+  internal_service_table_get ((priv)->table, (priv)->slot)
+
 enum
 {
   SIGNAL_UPDATE,
@@ -71,6 +85,7 @@ enum
   SIGNAL_FAVORITE_CHANGED,
   SIGNAL_ERROR_CHANGED,
   SIGNAL_METHOD_CHANGED,
+  SIGNAL_UPDATE_MASK,
   SIGNAL_LAST
 };
 
@@ -82,155 +97,387 @@ service_error_quark (void)
   return g_quark_from_static_string ("service-error-quark");
 }
 
+/* Emit "service-updated", and the mask signal if anything changed */
 static void
-service_emit_updated (CmService *service)
+service_emit_update_signals (CmService *service)
 {
+  CmServicePrivate *priv = service->priv;
+  CmServiceInfoMask changed = priv->changed;
+
+  priv->changed = 0;
   g_signal_emit (service, service_signals[SIGNAL_UPDATE], 0 /* detail */);
+  if (changed)
+    g_signal_emit (service, service_signals[SIGNAL_UPDATE_MASK], 0, changed);
+}
+
+/*
+ * A coalesced flush with nothing to report, e.g. after a refresh that
+ * confirmed the cached values, stays quiet
+ */
+static void
+service_flush_updated (CmService *service)
+{
+  if (service->priv->changed)
+    service_emit_update_signals (service);
+}
+
+static void
+service_emit_updated (CmService *service)
+{
+  CmServicePrivate *priv = service->priv;
+
+  /* Uncoalesced, "service-updated" goes out every time, as it always has */
+  if (!priv->manager ||
+      !internal_manager_queue_update (priv->manager, G_OBJECT (service),
+                                      (CmUpdateFunc) service_flush_updated))
+    service_emit_update_signals (service);
+}
+
+static const CmEnumName service_states[] =
+{
+  { "idle", SERVICE_STATE_IDLE },
+  { "carrier", SERVICE_STATE_CARRIER },
+  { "association", SERVICE_STATE_ASSOCIATION },
+  { "configuration", SERVICE_STATE_CONFIGURATION },
+  { "ready", SERVICE_STATE_READY },
+  { "login", SERVICE_STATE_LOGIN },
+  { "online", SERVICE_STATE_ONLINE },
+  { "disconnect", SERVICE_STATE_DISCONNECT },
+  { "failure", SERVICE_STATE_FAILURE },
+};
+
+static gboolean
+service_decode_state (gpointer object, const GValue *value)
+{
+  CmServicePrivate *priv = CM_SERVICE (object)->priv;
+  CmServiceHot *hot = SERVICE_HOT (priv);
+
+  hot->state = internal_enum_from_string (
+    service_states, G_N_ELEMENTS (service_states), priv->state);
+  if (hot->state == SERVICE_STATE_READY)
+    hot->flags |= SERVICE_HOT_CONNECTED;
+  else
+    hot->flags &= ~SERVICE_HOT_CONNECTED;
+
+  return TRUE;
+}
+
+static const CmEnumName service_types[] =
+{
+  { "ethernet", SERVICE_TYPE_ETHERNET },
+  { "wifi", SERVICE_TYPE_WIFI },
+  { "wimax", SERVICE_TYPE_WIMAX },
+  { "bluetooth", SERVICE_TYPE_BLUETOOTH },
+  { "cellular", SERVICE_TYPE_CELLULAR },
+};
+
+static gboolean
+service_decode_type (gpointer object, const GValue *value)
+{
+  CmServicePrivate *priv = CM_SERVICE (object)->priv;
+
+  priv->type_enum = internal_enum_from_string (
+    service_types, G_N_ELEMENTS (service_types), priv->type);
+
+  return TRUE;
+}
+
+static gboolean
+service_decode_security (gpointer object, const GValue *value)
+{
+  CmServicePrivate *priv = CM_SERVICE (object)->priv;
+
+  priv->security_enum = internal_security_from_string (priv->security);
+
+  return TRUE;
 }
 
-static void service_property_change_handler_proxy (DBusGProxy *, const gchar *,
-						   GValue *, gpointer);
+static const CmEnumName service_modes[] =
+{
+  { "managed", SERVICE_MODE_MANAGED },
+  { "adhoc", SERVICE_MODE_ADHOC },
+};
+
+static gboolean
+service_decode_mode (gpointer object, const GValue *value)
+{
+  CmServicePrivate *priv = CM_SERVICE (object)->priv;
+
+  priv->mode_enum = internal_enum_from_string (
+    service_modes, G_N_ELEMENTS (service_modes), priv->mode);
+
+  return TRUE;
+}
+
+static gboolean
+service_decode_method (gpointer object, const GValue *value)
+{
+  CmServicePrivate *priv = CM_SERVICE (object)->priv;
+
+  priv->method_enum = internal_ipv4_method_from_string (priv->method);
+
+  return TRUE;
+}
+
+/* Strength goes through the manager's filter */
+static gboolean
+service_decode_strength (gpointer object, const GValue *value)
+{
+  CmServicePrivate *priv = CM_SERVICE (object)->priv;
+  guchar strength = g_value_get_uchar (value);
+
+  if (!internal_manager_filter_strength (priv->manager, &priv->strength_filter,
+                                         strength))
+    return FALSE;
+
+  SERVICE_HOT (priv)->strength = strength;
+  return TRUE;
+}
+
+static gboolean
+service_decode_favorite (gpointer object, const GValue *value)
+{
+  CmServiceHot *hot = SERVICE_HOT (CM_SERVICE (object)->priv);
+  guchar flags = hot->flags;
+
+  if (g_value_get_boolean (value))
+    hot->flags |= SERVICE_HOT_FAVORITE;
+  else
+    hot->flags &= ~SERVICE_HOT_FAVORITE;
+
+  return hot->flags != flags;
+}
+
+/* A Strength the filter held back, now due */
+static void
+service_publish_strength (gpointer object, guchar strength)
+{
+  CmService *service = object;
+  CmServicePrivate *priv = service->priv;
+
+  SERVICE_HOT (priv)->strength = strength;
+  priv->changed |= SERVICE_INFO_STRENGTH;
+  g_signal_emit (service, service_signals[SIGNAL_STRENGTH_CHANGED], 0);
+  service_emit_updated (service);
+}
+
+#define SERVICE_FIELD(field) G_STRUCT_OFFSET (CmServicePrivate, field)
+
+static const CmProperty service_properties[] =
+{
+  { "State", PROPERTY_INTERNED, SERVICE_FIELD (state),
+    SIGNAL_STATE_CHANGED, SERVICE_INFO_STATE, service_decode_state },
+  { "Name", PROPERTY_STRING, SERVICE_FIELD (name),
+    SIGNAL_NAME_CHANGED, SERVICE_INFO_NAME, NULL },
+  { "Type", PROPERTY_INTERNED, SERVICE_FIELD (type),
+    SIGNAL_TYPE_CHANGED, SERVICE_INFO_TYPE, service_decode_type },
+  { "Mode", PROPERTY_INTERNED, SERVICE_FIELD (mode),
+    SIGNAL_MODE_CHANGED, SERVICE_INFO_MODE, service_decode_mode },
+  { "Security", PROPERTY_INTERNED, SERVICE_FIELD (security),
+    SIGNAL_SECURITY_CHANGED, SERVICE_INFO_SECURITY, service_decode_security },
+  { "Passphrase", PROPERTY_STRING, SERVICE_FIELD (passphrase),
+    SIGNAL_PASSPHRASE_CHANGED, SERVICE_INFO_PASSPHRASE, NULL },
+  { "Strength", PROPERTY_CUSTOM, 0,
+    SIGNAL_STRENGTH_CHANGED, SERVICE_INFO_STRENGTH, service_decode_strength },
+  { "Favorite", PROPERTY_CUSTOM, 0,
+    SIGNAL_FAVORITE_CHANGED, SERVICE_INFO_FAVORITE, service_decode_favorite },
+  { "Error", PROPERTY_STRING, SERVICE_FIELD (error),
+    SIGNAL_ERROR_CHANGED, SERVICE_INFO_ERROR, NULL },
+  { "IPv4.Method", PROPERTY_INTERNED, SERVICE_FIELD (method),
+    SIGNAL_METHOD_CHANGED, SERVICE_INFO_METHOD, service_decode_method },
+};
+
+static GHashTable *service_property_table;
 
 static void
 service_update_property (const gchar *key, GValue *value, CmService *service)
 {
   CmServicePrivate *priv = service->priv;
+  const CmProperty *property;
+  gboolean changed;
   gchar *tmp;
 
-  if (!strcmp ("State", key))
-  {
-    g_free (priv->state);
-    priv->state = g_value_dup_string (value);
-    priv->flags |= SERVICE_INFO_STATE;
-    if (!strcmp ("ready", priv->state))
-    {
-      priv->connected = TRUE;
-    }
-    else
-    {
-      priv->connected = FALSE;
-    }
-    g_signal_emit (service, service_signals[SIGNAL_STATE_CHANGED], 0);
-  }
-  else if (!strcmp ("Name", key))
-  {
-    g_free (priv->name);
-    priv->name = g_value_dup_string (value);
-    priv->flags |= SERVICE_INFO_NAME;
-    g_signal_emit (service, service_signals[SIGNAL_NAME_CHANGED], 0);
-  }
-  else if (!strcmp ("Type", key))
-  {
-    g_free (priv->type);
-    priv->type = g_value_dup_string (value);
-    priv->flags |= SERVICE_INFO_TYPE;
-    g_signal_emit (service, service_signals[SIGNAL_TYPE_CHANGED], 0);
-  }
-  else if (!strcmp ("Mode", key))
-  {
-    g_free (priv->mode);
-    priv->mode = g_value_dup_string (value);
-    priv->flags |= SERVICE_INFO_MODE;
-    g_signal_emit (service, service_signals[SIGNAL_MODE_CHANGED], 0);
-  }
-  else if (!strcmp ("Security", key))
-  {
-    g_free (priv->security);
-    priv->security = g_value_dup_string (value);
-    priv->flags |= SERVICE_INFO_SECURITY;
-    g_signal_emit (service, service_signals[SIGNAL_SECURITY_CHANGED], 0);
-  }
-  else if (!strcmp ("Passphrase", key))
-  {
-    g_free (priv->passphrase);
-    priv->passphrase = g_value_dup_string (value);
-    priv->flags |= SERVICE_INFO_PASSPHRASE;
-    g_signal_emit (service, service_signals[SIGNAL_PASSPHRASE_CHANGED], 0);
-  }
-  else if (!strcmp ("Strength", key))
-  {
-    priv->strength = g_value_get_uchar (value);
-    priv->flags |= SERVICE_INFO_STRENGTH;
-    g_signal_emit (service, service_signals[SIGNAL_STRENGTH_CHANGED], 0);
-  }
-  else if (!strcmp ("Favorite", key))
-  {
-    priv->favorite = g_value_get_boolean (value);
-    priv->flags |= SERVICE_INFO_FAVORITE;
-    g_signal_emit (service, service_signals[SIGNAL_FAVORITE_CHANGED], 0);
-  }
-  else if (!strcmp ("Error", key))
-  {
-    g_free (priv->error);
-    priv->error = g_value_dup_string (value);
-    priv->flags |= SERVICE_INFO_ERROR;
-    g_signal_emit (service, service_signals[SIGNAL_ERROR_CHANGED], 0);
-  }
-  else if (!strcmp ("IPv4.Method", key))
-  {
-    g_free (priv->method);
-    priv->method = g_value_dup_string (value);
-    priv->flags |= SERVICE_INFO_METHOD;
-    g_signal_emit (service, service_signals[SIGNAL_METHOD_CHANGED], 0);
-  }
-  else
+  property = internal_property_apply (service_property_table, service, priv,
+                                      key, value, &changed);
+  if (!property)
   {
     tmp = g_strdup_value_contents (value);
     g_debug ("Unhandled Service property on %s: %s = %s\n",
              cm_service_get_name (service), key, tmp);
     g_free (tmp);
+    return;
   }
+
+  priv->flags |= property->mask;
+  if (!changed)
+    return;
+
+  priv->changed |= property->mask;
+  g_signal_emit (service, service_signals[property->signal], 0);
 }
 
-static void
-service_property_change_handler_proxy (DBusGProxy *proxy,
-				       const gchar *key,
-				       GValue *value,
-				       gpointer data)
+void
+internal_service_property_changed (CmService *service, const gchar *key,
+                                   GValue *value)
 {
-  CmService *service = data;
+  /* A lazy service isn't listening until it has been materialized */
+  if (!service->priv->proxy)
+    return;
 
+  internal_manager_stats_signal (service->priv->manager,
+                                 STATS_INTERFACE_SERVICE);
   service_update_property (key, value, service);
 
   service_emit_updated (service);
 }
 
+void
+internal_service_apply_properties (CmService *service, GHashTable *properties)
+{
+  g_hash_table_foreach (properties, (GHFunc)service_update_property, service);
+  service_emit_updated (service);
+}
+
+#ifdef CM_TRANSPORT_GDBUS
+/* internal_service_apply_properties(), from a GetProperties reply */
+void
+internal_service_apply_variant (CmService *service, GVariant *properties)
+{
+  CmServicePrivate *priv = service->priv;
+  const CmProperty *property;
+  GVariantIter iter;
+  const gchar *key;
+  GVariant *value;
+  gboolean changed;
+
+  g_variant_iter_init (&iter, properties);
+  while (g_variant_iter_loop (&iter, "{&sv}", &key, &value))
+  {
+    property = internal_property_apply_variant (service_property_table, service,
+                                                priv, key, value, &changed);
+    if (!property)
+    {
+      g_debug ("Unhandled Service property on %s: %s\n",
+               cm_service_get_name (service), key);
+      continue;
+    }
+
+    priv->flags |= property->mask;
+    if (!changed)
+      continue;
+
+    priv->changed |= property->mask;
+    g_signal_emit (service, service_signals[property->signal], 0);
+  }
+
+  service_emit_updated (service);
+}
+#endif
+
+/* The inverse of service_update_property, for snapshots */
+void
+internal_service_export_properties (CmService *service, GHashTable *values)
+{
+  CmServicePrivate *priv = service->priv;
+  CmServiceHot *hot = SERVICE_HOT (priv);
+
+  internal_property_export (service_property_table, priv, values);
+  g_value_set_uchar (
+    internal_property_values_add (values, "Strength", G_TYPE_UCHAR),
+    hot->strength);
+  g_value_set_boolean (
+    internal_property_values_add (values, "Favorite", G_TYPE_BOOLEAN),
+    (hot->flags & SERVICE_HOT_FAVORITE) != 0);
+}
+
+/* The manager no longer lists service, so rankings skip it */
+void
+internal_service_unlist (CmService *service)
+{
+  SERVICE_HOT (service->priv)->flags &= ~SERVICE_HOT_LISTED;
+}
+
+/* Report error, or success, to the refreshes waiting */
 static void
-service_get_properties_call_notify (DBusGProxy *proxy,
-				   DBusGProxyCall *call,
-				   gpointer data)
+service_complete_refreshes (CmService *service, const GError *error)
 {
-  CmService *service = data;
-  GError *error = NULL;
-  GHashTable *properties = NULL;
-  gint count;
-
-  if (!dbus_g_proxy_end_call (
-	proxy, call, &error,
-	/* OUT values */
-	dbus_g_type_get_map ("GHashTable", G_TYPE_STRING, G_TYPE_VALUE),
-	&properties, G_TYPE_INVALID))
+  CmServicePrivate *priv = service->priv;
+  GList *waiters = priv->refresh_waiters;
+
+  priv->refresh_waiters = NULL;
+
+  while (waiters)
   {
-    g_debug ("Error calling dbus_g_proxy_end_call in %s on %s: %s\n",
-             __FUNCTION__, cm_service_get_name (service), error->message);
-    g_error_free (error);
+    GSimpleAsyncResult *result = waiters->data;
+
+    if (error)
+      g_simple_async_result_set_from_error (result, error);
+    g_simple_async_result_complete_in_idle (result);
+    g_object_unref (result);
+    waiters = g_list_delete_link (waiters, waiters);
+  }
+}
+
+static void
+service_fetch_done (gpointer object, const GError *error)
+{
+  CmService *service = object;
+
+  service->priv->fetching--;
+  service_complete_refreshes (service, error);
+}
+
+void
+internal_service_fetch_properties (CmService *service)
+{
+  CmServicePrivate *priv = service->priv;
+
+  /* Nothing to re-read until a lazy service is first used */
+  if (!priv->proxy)
     return;
+
+  /* done may already have run when this returns, if the call failed */
+  priv->fetching++;
+  if (!internal_manager_get_properties_full (
+        priv->manager, G_OBJECT (service), priv->proxy,
+        (CmPropertiesFunc) internal_service_apply_properties,
+        service_fetch_done))
+    priv->fetching--;
+}
+
+/*
+ * A lazy service is only a path and an order until something needs more
+ * than that: create its proxy and read its properties on first use.
+ */
+static gboolean
+service_materialize (CmService *service, GError **error)
+{
+  CmServicePrivate *priv = service->priv;
+
+  if (priv->proxy)
+    return TRUE;
+
+  priv->proxy = dbus_g_proxy_new_from_proxy (
+    priv->manager_proxy, CONNMAN_SERVICE_INTERFACE, priv->path);
+  if (!priv->proxy)
+  {
+    g_set_error (error, SERVICE_ERROR, SERVICE_ERROR_CONNMAN_INTERFACE,
+                 "No interface for %s/%s from Connman.",
+                 CONNMAN_SERVICE_INTERFACE, priv->path);
+    return FALSE;
   }
 
-  count = g_hash_table_size (properties);
+  internal_service_fetch_properties (service);
 
-  g_hash_table_foreach (properties, (GHFunc)service_update_property, service);
-  g_hash_table_unref (properties);
-  service_emit_updated (service);
+  return TRUE;
 }
 
 CmService *
 internal_service_new (DBusGProxy *proxy, const gchar *path, int order,
-                      CmManager *manager, GError **error)
+                      gboolean lazy, CmManager *manager, GError **error)
 {
   CmService *service;
   CmServicePrivate *priv;
-  DBusGProxyCall *call;
 
   service = g_object_new (CM_TYPE_SERVICE, NULL);
   if (!service)
@@ -242,6 +489,11 @@ internal_service_new (DBusGProxy *proxy, const gchar *path, int order,
 
   priv = service->priv;
   priv->manager = manager;
+  priv->table = internal_service_table_ref (
+    internal_manager_get_service_table (manager));
+  priv->slot = internal_service_table_add (priv->table, service);
+  priv->manager_proxy = g_object_ref (proxy);
+  SERVICE_HOT (priv)->order = order;
 
   priv->path = g_strdup (path);
   if (!priv->path)
@@ -252,40 +504,32 @@ internal_service_new (DBusGProxy *proxy, const gchar *path, int order,
     return NULL;
   }
 
-  priv->proxy = dbus_g_proxy_new_from_proxy (
-    proxy, CONNMAN_SERVICE_INTERFACE, path);
-  if (!priv->proxy)
+  if (!lazy && !service_materialize (service, error))
   {
-    g_set_error (error, SERVICE_ERROR, SERVICE_ERROR_CONNMAN_INTERFACE,
-                 "No interface for %s/%s from Connman.",
-                 CONNMAN_SERVICE_INTERFACE, path);
     g_object_unref (service);
     return NULL;
   }
 
-  dbus_g_proxy_add_signal (
-    priv->proxy, "PropertyChanged",
-    G_TYPE_STRING, G_TYPE_VALUE, G_TYPE_INVALID);
+  return service;
+}
 
-  dbus_g_proxy_connect_signal (
-    priv->proxy, "PropertyChanged",
-    G_CALLBACK (service_property_change_handler_proxy),
-    service, NULL);
+/*
+ * Materialise a lazy service now rather than on first use, so that it
+ * starts tracking its properties.  A no-op for services that already are.
+ */
+gboolean
+cm_service_pin (CmService *service)
+{
+  GError *error = NULL;
 
-  call = dbus_g_proxy_begin_call (priv->proxy, "GetProperties",
-                                  service_get_properties_call_notify, service,
-                                  NULL, G_TYPE_INVALID);
-  if (!call)
+  if (!service_materialize (service, &error))
   {
-    g_set_error (error, SERVICE_ERROR, SERVICE_ERROR_CONNMAN_GET_PROPERTIES,
-                 "Invocation of GetProperties failed.");
-    g_object_unref (service);
-    return NULL;
+    g_debug ("Unable to pin service: %s\n", error->message);
+    g_error_free (error);
+    return FALSE;
   }
 
-  priv->order = order;
-
-  return service;
+  return TRUE;
 }
 
 static void
@@ -293,10 +537,10 @@ service_disconnect_call_notify (DBusGProxy *proxy,
                                 DBusGProxyCall *call,
                                 gpointer data)
 {
-  CmService *service = data;
+  CmService *service = internal_stats_call_data (data);
   GError *error = NULL;
 
-  if (!dbus_g_proxy_end_call (proxy, call, &error, G_TYPE_INVALID))
+  if (!internal_stats_end_call (proxy, call, data, &error))
   {
     g_debug ("Error calling dbus_g_proxy_end_call in %s on %s: %s\n",
              __FUNCTION__, cm_service_get_name (service), error->message);
@@ -311,9 +555,16 @@ cm_service_disconnect (CmService *service)
   GError *error = NULL;
   DBusGProxyCall *call;
 
+  if (!service_materialize (service, NULL))
+    return FALSE;
+
   call = dbus_g_proxy_begin_call (priv->proxy, "Disconnect",
-                                  service_disconnect_call_notify, service,
-                                  NULL, G_TYPE_INVALID);
+                                  service_disconnect_call_notify,
+                                  internal_manager_stats_call (
+                                    priv->manager, STATS_INTERFACE_SERVICE,
+                                    STATS_METHOD_DISCONNECT, service),
+                                  internal_stats_call_free,
+                                  G_TYPE_INVALID);
 
   if (!call)
   {
@@ -330,10 +581,10 @@ service_connect_call_notify (DBusGProxy *proxy,
                              DBusGProxyCall *call,
                              gpointer data)
 {
-  CmService *service = data;
+  CmService *service = internal_stats_call_data (data);
   GError *error = NULL;
 
-  if (!dbus_g_proxy_end_call (proxy, call, &error, G_TYPE_INVALID))
+  if (!internal_stats_end_call (proxy, call, data, &error))
   {
     g_debug ("Error calling dbus_g_proxy_end_call in %s on %s: %s\n",
              __FUNCTION__, cm_service_get_name (service), error->message);
@@ -348,7 +599,10 @@ cm_service_connect (CmService *service)
   GError *error = NULL;
   DBusGProxyCall *call;
 
-  if (priv->connected)
+  if (!service_materialize (service, NULL))
+    return FALSE;
+
+  if (SERVICE_HOT (priv)->flags & SERVICE_HOT_CONNECTED)
     return TRUE;
 
   /* 
@@ -359,8 +613,11 @@ cm_service_connect (CmService *service)
   call = dbus_g_proxy_begin_call_with_timeout (priv->proxy, 
 					       "Connect",
 					       service_connect_call_notify, 
-					       service, 
-					       NULL,
+					       internal_manager_stats_call (
+					         priv->manager,
+					         STATS_INTERFACE_SERVICE,
+					         STATS_METHOD_CONNECT, service),
+					       internal_stats_call_free,
 					       120000,
 					       G_TYPE_INVALID);
   if (!call)
@@ -373,12 +630,140 @@ cm_service_connect (CmService *service)
   return TRUE;
 }
 
+/*
+ * Connect, reporting the outcome to callback.  timeout is in milliseconds,
+ * -1 for the D-Bus default; ConnMan only replies once the service has an
+ * address, so a deadline well under the two minutes cm_service_connect()
+ * allows is the usual way to give up on a stuck attempt.
+ */
+void
+cm_service_connect_async (CmService *service, gint timeout,
+                          GCancellable *cancellable,
+                          GAsyncReadyCallback callback, gpointer user_data)
+{
+  CmServicePrivate *priv = service->priv;
+  GError *error = NULL;
+  CmAsyncCall *async;
+  DBusGProxyCall *call;
+
+  if (!service_materialize (service, &error) ||
+      SERVICE_HOT (priv)->flags & SERVICE_HOT_CONNECTED)
+  {
+    internal_async_report (service, callback, user_data,
+                           cm_service_connect_async, error);
+    return;
+  }
+
+  async = internal_async_call_new (service, "Connect",
+                                   internal_manager_stats_call (
+                                     priv->manager, STATS_INTERFACE_SERVICE,
+                                     STATS_METHOD_CONNECT, NULL),
+                                   cancellable, callback, user_data,
+                                   cm_service_connect_async);
+  call = dbus_g_proxy_begin_call_with_timeout (priv->proxy, "Connect",
+                                               internal_async_call_notify,
+                                               async, internal_async_call_free,
+                                               timeout, G_TYPE_INVALID);
+  internal_async_call_start (async, priv->proxy, call);
+}
+
+gboolean
+cm_service_connect_finish (CmService *service, GAsyncResult *result,
+                           GError **error)
+{
+  return internal_async_finish (service, result, cm_service_connect_async,
+                                error);
+}
+
+void
+cm_service_disconnect_async (CmService *service, gint timeout,
+                             GCancellable *cancellable,
+                             GAsyncReadyCallback callback, gpointer user_data)
+{
+  CmServicePrivate *priv = service->priv;
+  GError *error = NULL;
+  CmAsyncCall *async;
+  DBusGProxyCall *call;
+
+  if (!service_materialize (service, &error))
+  {
+    internal_async_report (service, callback, user_data,
+                           cm_service_disconnect_async, error);
+    return;
+  }
+
+  async = internal_async_call_new (service, "Disconnect",
+                                   internal_manager_stats_call (
+                                     priv->manager, STATS_INTERFACE_SERVICE,
+                                     STATS_METHOD_DISCONNECT, NULL),
+                                   cancellable, callback, user_data,
+                                   cm_service_disconnect_async);
+  call = dbus_g_proxy_begin_call_with_timeout (priv->proxy, "Disconnect",
+                                               internal_async_call_notify,
+                                               async, internal_async_call_free,
+                                               timeout, G_TYPE_INVALID);
+  internal_async_call_start (async, priv->proxy, call);
+}
+
+gboolean
+cm_service_disconnect_finish (CmService *service, GAsyncResult *result,
+                              GError **error)
+{
+  return internal_async_finish (service, result, cm_service_disconnect_async,
+                                error);
+}
+
+/*
+ * Re-read the service's properties, reporting to callback once they have
+ * been applied.  The call goes through the manager's GetProperties queue
+ * like any other fetch, and a refresh requested while one of the
+ * service's fetches is pending, including the first read of a lazy
+ * service, shares its reply rather than queuing another.
+ */
+void
+cm_service_refresh_async (CmService *service, GAsyncReadyCallback callback,
+                          gpointer user_data)
+{
+  CmServicePrivate *priv = service->priv;
+  GError *error = NULL;
+
+  /* A lazy service queues its first read here */
+  if (!service_materialize (service, &error))
+  {
+    internal_async_report (service, callback, user_data,
+                           cm_service_refresh_async, error);
+    return;
+  }
+
+  priv->refresh_waiters = g_list_append (
+    priv->refresh_waiters,
+    g_simple_async_result_new (G_OBJECT (service), callback, user_data,
+                               cm_service_refresh_async));
+
+  if (priv->fetching)
+    return;
+
+  internal_service_fetch_properties (service);
+
+  /* Nothing was queued, as while a snapshot loads: the cache is current */
+  if (!priv->fetching)
+    service_complete_refreshes (service, NULL);
+}
+
+gboolean
+cm_service_refresh_finish (CmService *service, GAsyncResult *result,
+                           GError **error)
+{
+  return internal_async_finish (service, result, cm_service_refresh_async,
+                                error);
+}
+
 static void
 service_remove_call_notify (DBusGProxy *proxy,
                             DBusGProxyCall *call,
                             gpointer data)
 {
-  CmService *service = data;
+  CmService *service = internal_stats_call_data (data);
   CmServicePrivate *priv = service->priv;
   GError *error = NULL;
 
@@ -386,7 +771,7 @@ service_remove_call_notify (DBusGProxy *proxy,
   g_free (priv->passphrase);
   priv->passphrase = NULL;
 
-  if (!dbus_g_proxy_end_call (proxy, call, &error, G_TYPE_INVALID))
+  if (!internal_stats_end_call (proxy, call, data, &error))
   {
     g_debug ("Error calling dbus_g_proxy_end_call in %s on %s: %s\n",
              __FUNCTION__, cm_service_get_name (service), error->message);
@@ -401,8 +786,15 @@ cm_service_remove (CmService *service)
   GError *error = NULL;
   DBusGProxyCall *call;
 
+  if (!service_materialize (service, NULL))
+    return FALSE;
+
   call = dbus_g_proxy_begin_call (priv->proxy, "Remove",
-                                  service_remove_call_notify, service, NULL,
+                                  service_remove_call_notify,
+                                  internal_manager_stats_call (
+                                    priv->manager, STATS_INTERFACE_SERVICE,
+                                    STATS_METHOD_OTHER, service),
+                                  internal_stats_call_free,
                                   G_TYPE_INVALID);
   if (!call)
   {
@@ -419,10 +811,10 @@ service_set_property_call_notify (DBusGProxy *proxy,
 				  DBusGProxyCall *call,
 				  gpointer data)
 {
-  CmService *service = data;
+  CmService *service = internal_stats_call_data (data);
   GError *error = NULL;
 
-  if (!dbus_g_proxy_end_call (proxy, call, &error, G_TYPE_INVALID))
+  if (!internal_stats_end_call (proxy, call, data, &error))
   {
     g_debug ("Error calling dbus_g_proxy_end_call in %s on %s: %s\n",
              __FUNCTION__, cm_service_get_name (service), error->message);
@@ -438,9 +830,16 @@ cm_service_set_property (CmService *service, const gchar *property,
   GError *error = NULL;
   DBusGProxyCall *call;
 
+  if (!service_materialize (service, NULL))
+    return FALSE;
+
   call = dbus_g_proxy_begin_call (priv->proxy, "SetProperty",
-                                  service_set_property_call_notify, service,
-                                  NULL, G_TYPE_STRING, property,
+                                  service_set_property_call_notify,
+                                  internal_manager_stats_call (
+                                    priv->manager, STATS_INTERFACE_SERVICE,
+                                    STATS_METHOD_SET_PROPERTY, service),
+                                  internal_stats_call_free,
+                                  G_TYPE_STRING, property,
                                   G_TYPE_VALUE, value, G_TYPE_INVALID);
 
   if (!call)
@@ -457,10 +856,10 @@ static void
 service_move_before_call_notify (DBusGProxy *proxy, DBusGProxyCall *call,
                                  gpointer data)
 {
-  CmService *service = data;
+  CmService *service = internal_stats_call_data (data);
   GError *error = NULL;
 
-  if (!dbus_g_proxy_end_call (proxy, call, &error, G_TYPE_INVALID))
+  if (!internal_stats_end_call (proxy, call, data, &error))
   {
     g_debug ("Error calling dbus_g_proxy_end_call in %s on %s: %s\n",
              __FUNCTION__, cm_service_get_name (service), error->message);
@@ -476,9 +875,15 @@ cm_service_move_before (CmService *service, CmService *before)
   const gchar *path = cm_service_get_path (before);
   DBusGProxyCall *call;
 
+  if (!service_materialize (service, NULL))
+    return FALSE;
+
   call = dbus_g_proxy_begin_call (priv->proxy, "MoveBefore",
                                   service_move_before_call_notify,
-                                  service, NULL,
+                                  internal_manager_stats_call (
+                                    priv->manager, STATS_INTERFACE_SERVICE,
+                                    STATS_METHOD_OTHER, service),
+                                  internal_stats_call_free,
                                   DBUS_TYPE_G_OBJECT_PATH, path,
                                   G_TYPE_INVALID);
 
@@ -496,10 +901,10 @@ static void
 service_move_after_call_notify (DBusGProxy *proxy, DBusGProxyCall *call,
                                    gpointer data)
 {
-  CmService *service = data;
+  CmService *service = internal_stats_call_data (data);
   GError *error = NULL;
 
-  if (!dbus_g_proxy_end_call (proxy, call, &error, G_TYPE_INVALID))
+  if (!internal_stats_end_call (proxy, call, data, &error))
   {
     g_debug ("Error calling dbus_g_proxy_end_call in %s on %s: %s\n",
              __FUNCTION__, cm_service_get_name (service), error->message);
@@ -515,9 +920,15 @@ cm_service_move_after (CmService *service, CmService *after)
   const gchar *path = cm_service_get_path (after);
   DBusGProxyCall *call;
 
+  if (!service_materialize (service, NULL))
+    return FALSE;
+
   call = dbus_g_proxy_begin_call (priv->proxy, "MoveAfter",
                                   service_move_after_call_notify,
-                                  service, NULL,
+                                  internal_manager_stats_call (
+                                    priv->manager, STATS_INTERFACE_SERVICE,
+                                    STATS_METHOD_OTHER, service),
+                                  internal_stats_call_free,
                                   DBUS_TYPE_G_OBJECT_PATH, path,
                                   G_TYPE_INVALID);
 
@@ -553,12 +964,12 @@ cm_service_is_same (const CmService *first, const CmService *second)
 gint
 cm_service_compare (CmService *first, CmService *second)
 {
-  CmServicePrivate *fpriv = first->priv;
-  CmServicePrivate *spriv = second->priv;
+  gint forder = SERVICE_HOT (first->priv)->order;
+  gint sorder = SERVICE_HOT (second->priv)->order;
 
-  if (fpriv->order < spriv->order)
+  if (forder < sorder)
     return -1;
-  else if (fpriv->order == spriv->order)
+  else if (forder == sorder)
     return 0;
   else
     return 1;
@@ -569,15 +980,28 @@ const gchar *
 cm_service_get_state (CmService *service)
 {
   CmServicePrivate *priv = service->priv;
+
+  service_materialize (service, NULL);
   return priv->state;
 }
 
+CmServiceState
+cm_service_get_state_enum (CmService *service)
+{
+  CmServicePrivate *priv = service->priv;
+
+  service_materialize (service, NULL);
+  return SERVICE_HOT (priv)->state;
+}
+
 /* Ethernet services may not have a name set, in which case return the type */
 const gchar *
 cm_service_get_name (const CmService *service)
 {
   CmServicePrivate *priv = service->priv;
-  if (priv->name == NULL && g_strcmp0 ("ethernet", priv->type) == 0)
+
+  service_materialize ((CmService *) service, NULL);
+  if (priv->name == NULL && priv->type_enum == SERVICE_TYPE_ETHERNET)
     return priv->type;
   else
     return priv->name;
@@ -587,30 +1011,45 @@ const gchar *
 cm_service_get_mode (CmService *service)
 {
   CmServicePrivate *priv = service->priv;
+
+  service_materialize (service, NULL);
   return priv->mode;
 }
 
+CmServiceMode
+cm_service_get_mode_enum (CmService *service)
+{
+  CmServicePrivate *priv = service->priv;
+
+  service_materialize (service, NULL);
+  return priv->mode_enum;
+}
+
 const gchar *
 cm_service_get_security (CmService *service)
 {
   CmServicePrivate *priv = service->priv;
+
+  service_materialize (service, NULL);
   return priv->security;
 }
 
+CmSecurity
+cm_service_get_security_enum (CmService *service)
+{
+  CmServicePrivate *priv = service->priv;
+
+  service_materialize (service, NULL);
+  return priv->security_enum;
+}
+
+/* The cached passphrase; cm_service_refresh_async() re-reads it */
 const gchar *
 cm_service_get_passphrase (CmService *service)
 {
   CmServicePrivate *priv = service->priv;
-  DBusGProxyCall *call;
-
-  call = dbus_g_proxy_begin_call (priv->proxy, "GetProperties",
-                                  service_get_properties_call_notify, service,
-                                  NULL, G_TYPE_INVALID);
-  if (!call)
-  {
-    g_debug ("GetProperties refresh failed in %s", __FUNCTION__);
-  }
 
+  service_materialize (service, NULL);
   return priv->passphrase;
 }
 
@@ -640,42 +1079,59 @@ const char *
 cm_service_get_type (CmService *service)
 {
   CmServicePrivate *priv = service->priv;
+
+  service_materialize (service, NULL);
   return priv->type;
 }
 
+CmServiceType
+cm_service_get_type_enum (CmService *service)
+{
+  CmServicePrivate *priv = service->priv;
+
+  service_materialize (service, NULL);
+  return priv->type_enum;
+}
+
 guint
 cm_service_get_strength (CmService *service)
 {
   CmServicePrivate *priv = service->priv;
-  return priv->strength;
+
+  service_materialize (service, NULL);
+  return SERVICE_HOT (priv)->strength;
 }
 
 gint
 cm_service_get_order (CmService *service)
 {
   CmServicePrivate *priv = service->priv;
-  return priv->order;
+  return SERVICE_HOT (priv)->order;
 }
 
 void
 cm_service_set_order (CmService *service, gint order)
 {
   CmServicePrivate *priv = service->priv;
-  priv->order = order;
+  SERVICE_HOT (priv)->order = order;
 }
 
 gboolean
 cm_service_get_favorite (CmService *service)
 {
   CmServicePrivate *priv = service->priv;
-  return priv->favorite;
+
+  service_materialize (service, NULL);
+  return (SERVICE_HOT (priv)->flags & SERVICE_HOT_FAVORITE) != 0;
 }
 
 gboolean
 cm_service_get_connected (CmService *service)
 {
   CmServicePrivate *priv = service->priv;
-  return priv->connected;
+
+  service_materialize (service, NULL);
+  return (SERVICE_HOT (priv)->flags & SERVICE_HOT_CONNECTED) != 0;
 }
 
 const gchar *
@@ -691,9 +1147,21 @@ cm_service_get_method (CmService *service)
 {
   CmServicePrivate *priv = service->priv;
 
+  service_materialize (service, NULL);
+
   return priv->method;
 }
 
+CmIPv4Method
+cm_service_get_method_enum (CmService *service)
+{
+  CmServicePrivate *priv = service->priv;
+
+  service_materialize (service, NULL);
+
+  return priv->method_enum;
+}
+
 gboolean
 cm_service_make_default (CmService *service)
 {
@@ -702,7 +1170,7 @@ cm_service_make_default (CmService *service)
   const GList *services = cm_manager_get_services (priv->manager);
   CmService *first = services->data;
 
-  if (!priv->connected)
+  if (!(SERVICE_HOT (priv)->flags & SERVICE_HOT_CONNECTED))
     ret = cm_service_connect (service);
 
   if (ret)
@@ -715,6 +1183,8 @@ const gchar *
 cm_service_get_error (CmService *service)
 {
   CmServicePrivate *priv = service->priv;
+
+  service_materialize (service, NULL);
   return priv->error;
 }
 
@@ -734,15 +1204,17 @@ service_dispose (GObject *object)
 
   if (priv->proxy)
   {
-    dbus_g_proxy_disconnect_signal (
-      priv->proxy, "PropertyChanged",
-      G_CALLBACK (service_property_change_handler_proxy),
-      service);
-
     g_object_unref (priv->proxy);
     priv->proxy = NULL;
   }
 
+  if (priv->manager_proxy)
+  {
+    g_object_unref (priv->manager_proxy);
+    priv->manager_proxy = NULL;
+  }
+
+  internal_strength_filter_clear (&priv->strength_filter);
   priv->manager = NULL;
 
   G_OBJECT_CLASS (service_parent_class)->dispose (object);
@@ -754,15 +1226,16 @@ service_finalize (GObject *object)
   CmService *service = CM_SERVICE (object);
   CmServicePrivate *priv = service->priv;
 
-  g_free (priv->state);
   g_free (priv->name);
-  g_free (priv->type);
-  g_free (priv->mode);
-  g_free (priv->security);
   g_free (priv->path);
   g_free (priv->passphrase);
   g_free (priv->error);
-  g_free (priv->method);
+
+  if (priv->table)
+  {
+    internal_service_table_remove (priv->table, priv->slot);
+    internal_service_table_unref (priv->table);
+  }
 
   G_OBJECT_CLASS (service_parent_class)->finalize (object);
 }
@@ -771,18 +1244,23 @@ static void
 service_init (CmService *self)
 {
   self->priv = CM_SERVICE_GET_PRIVATE (self);
+  internal_strength_filter_init (&self->priv->strength_filter, self,
+                                 service_publish_strength);
   self->priv->manager = NULL;
   self->priv->path = NULL;
+  self->priv->table = NULL;
   self->priv->state = NULL;
   self->priv->name = NULL;
   self->priv->type = NULL;
+  self->priv->type_enum = SERVICE_TYPE_UNKNOWN;
   self->priv->mode = NULL;
+  self->priv->mode_enum = SERVICE_MODE_UNKNOWN;
   self->priv->security = NULL;
+  self->priv->security_enum = SECURITY_UNKNOWN;
   self->priv->passphrase = NULL;
-  self->priv->favorite = FALSE;
-  self->priv->connected = FALSE;
   self->priv->error = NULL;
   self->priv->method = NULL;
+  self->priv->method_enum = IPV4_METHOD_UNKNOWN;
 }
 
 static void
@@ -881,7 +1359,19 @@ service_class_init (CmServiceClass *klass)
     NULL, NULL,
     g_cclosure_marshal_VOID__VOID,
     G_TYPE_NONE, 0);
+  /* "service-updated" with the CmServiceInfoMask that changed, if any */
+  service_signals[SIGNAL_UPDATE_MASK] = g_signal_new (
+    "service-updated-mask",
+    G_TYPE_FROM_CLASS (gobject_class),
+    G_SIGNAL_RUN_LAST,
+    0,
+    NULL, NULL,
+    g_cclosure_marshal_VOID__UINT,
+    G_TYPE_NONE, 1, G_TYPE_UINT);
 
   g_type_class_add_private (gobject_class, sizeof (CmServicePrivate));
+
+  service_property_table = internal_property_table_new (
+    service_properties, G_N_ELEMENTS (service_properties));
 }
 
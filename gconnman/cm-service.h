@@ -82,28 +82,105 @@ typedef enum
   SERVICE_INFO_METHOD     = 1 << 9,
 } CmServiceInfoMask;
 
+typedef enum
+{
+  SERVICE_STATE_UNKNOWN = 0,
+  SERVICE_STATE_IDLE,
+  SERVICE_STATE_CARRIER,
+  SERVICE_STATE_ASSOCIATION,
+  SERVICE_STATE_CONFIGURATION,
+  SERVICE_STATE_READY,
+  SERVICE_STATE_LOGIN,
+  SERVICE_STATE_ONLINE,
+  SERVICE_STATE_DISCONNECT,
+  SERVICE_STATE_FAILURE,
+} CmServiceState;
+
+typedef enum
+{
+  SERVICE_TYPE_UNKNOWN = 0,
+  SERVICE_TYPE_ETHERNET,
+  SERVICE_TYPE_WIFI,
+  SERVICE_TYPE_WIMAX,
+  SERVICE_TYPE_BLUETOOTH,
+  SERVICE_TYPE_CELLULAR,
+} CmServiceType;
+
+/* Security of services and networks */
+typedef enum
+{
+  SECURITY_UNKNOWN = 0,
+  SECURITY_NONE,
+  SECURITY_WEP,
+  SECURITY_PSK,
+  SECURITY_WPA,
+  SECURITY_RSN,
+  SECURITY_IEEE8021X,
+} CmSecurity;
+
+typedef enum
+{
+  SERVICE_MODE_UNKNOWN = 0,
+  SERVICE_MODE_MANAGED,
+  SERVICE_MODE_ADHOC,
+} CmServiceMode;
+
+/* IPv4.Method of services and connections */
+typedef enum
+{
+  IPV4_METHOD_UNKNOWN = 0,
+  IPV4_METHOD_DHCP,
+  IPV4_METHOD_MANUAL,
+  IPV4_METHOD_FIXED,
+  IPV4_METHOD_OFF,
+} CmIPv4Method;
+
 /* methods */
 gboolean cm_service_connect (CmService *service);
 gboolean cm_service_disconnect (CmService *service);
+void cm_service_connect_async (CmService *service, gint timeout,
+                               GCancellable *cancellable,
+                               GAsyncReadyCallback callback,
+                               gpointer user_data);
+gboolean cm_service_connect_finish (CmService *service, GAsyncResult *result,
+                                    GError **error);
+void cm_service_disconnect_async (CmService *service, gint timeout,
+                                  GCancellable *cancellable,
+                                  GAsyncReadyCallback callback,
+                                  gpointer user_data);
+gboolean cm_service_disconnect_finish (CmService *service,
+                                       GAsyncResult *result, GError **error);
+void cm_service_refresh_async (CmService *service,
+                               GAsyncReadyCallback callback,
+                               gpointer user_data);
+gboolean cm_service_refresh_finish (CmService *service, GAsyncResult *result,
+                                    GError **error);
 gboolean cm_service_move_before (CmService *service, CmService *before);
 gboolean cm_service_move_after (CmService *service, CmService *after);
 gboolean cm_service_is_same (const CmService *first, const CmService *second);
 gboolean cm_service_remove (CmService *service);
 gint cm_service_compare (CmService *first, CmService *second);
+gboolean cm_service_pin (CmService *service);
 
 /* const getters */
 const gchar *cm_service_get_path (CmService *service);
 const gchar *cm_service_get_state (CmService *service);
+CmServiceState cm_service_get_state_enum (CmService *service);
 const gchar *cm_service_get_name (const CmService *service);
 const gchar *cm_service_get_type (CmService *service);
+CmServiceType cm_service_get_type_enum (CmService *service);
 const gchar *cm_service_get_mode (CmService *service);
+CmServiceMode cm_service_get_mode_enum (CmService *service);
 const gchar *cm_service_get_security (CmService *service);
+CmSecurity cm_service_get_security_enum (CmService *service);
 const gchar *cm_service_get_passphrase (CmService *service);
 guint cm_service_get_strength (CmService *service);
 gboolean cm_service_get_favorite (CmService *service);
 gboolean cm_service_get_connected (CmService *service);
 gint cm_service_get_order (CmService *service);
 const gchar *cm_service_get_error (CmService *service);
+const gchar *cm_service_get_method (CmService *service);
+CmIPv4Method cm_service_get_method_enum (CmService *service);
 
 gboolean cm_service_set_passphrase (CmService *service, const char* passphrase);
 void cm_service_set_order (CmService *service, gint order);
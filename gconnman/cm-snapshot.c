@@ -0,0 +1,433 @@
+/*
+ * Gconnman - a GObject wrapper for the Connman D-Bus API
+ * Copyright © 2009, Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ */
+
+/*
+ * Snapshot encoding.
+ *
+ * A snapshot is a list of records, one per object, each holding the
+ * object's properties as GetProperties would have returned them.  The
+ * encoding is:
+ *
+ *   "GCMSNAP" version:byte count:u32 record*
+ *   record = kind:byte path:string n:u32 (name:string type:byte value)*
+ *   string = length:u32 bytes
+ *
+ * with little endian integers.  Values are typed by the D-Bus signature
+ * character of what they hold: s, b, y, u, "ao" as 'o', "ay" as 'a' and
+ * "as" as 'v'.
+ */
+#include <string.h>
+#include <glib.h>
+#include <glib-object.h>
+
+#include "gconnman-internal.h"
+
+#define SNAPSHOT_MAGIC   "GCMSNAP"
+#define SNAPSHOT_VERSION 1
+
+CmSnapshotRecord *
+internal_snapshot_record_new (CmSnapshotKind kind, const gchar *path)
+{
+  CmSnapshotRecord *record = g_slice_new (CmSnapshotRecord);
+
+  record->kind = kind;
+  record->path = g_strdup (path);
+  record->values = internal_property_values_new ();
+
+  return record;
+}
+
+void
+internal_snapshot_record_free (CmSnapshotRecord *record)
+{
+  g_free (record->path);
+  g_hash_table_destroy (record->values);
+  g_slice_free (CmSnapshotRecord, record);
+}
+
+static GType
+snapshot_path_array_type (void)
+{
+  return dbus_g_type_get_collection ("GPtrArray", DBUS_TYPE_G_OBJECT_PATH);
+}
+
+static void
+snapshot_write_uint32 (GString *out, guint32 v)
+{
+  v = GUINT32_TO_LE (v);
+  g_string_append_len (out, (const gchar *) &v, sizeof (v));
+}
+
+static void
+snapshot_write_string (GString *out, const gchar *str, gsize len)
+{
+  snapshot_write_uint32 (out, len);
+  g_string_append_len (out, str, len);
+}
+
+static void
+snapshot_write_value (GString *out, const gchar *name, const GValue *value)
+{
+  GType type = G_VALUE_TYPE (value);
+  guint i;
+
+  if (type == G_TYPE_STRING)
+  {
+    const gchar *str = g_value_get_string (value);
+
+    snapshot_write_string (out, name, strlen (name));
+    g_string_append_c (out, 's');
+    snapshot_write_string (out, str, str ? strlen (str) : 0);
+  }
+  else if (type == G_TYPE_BOOLEAN)
+  {
+    snapshot_write_string (out, name, strlen (name));
+    g_string_append_c (out, 'b');
+    g_string_append_c (out, g_value_get_boolean (value) ? 1 : 0);
+  }
+  else if (type == G_TYPE_UCHAR)
+  {
+    snapshot_write_string (out, name, strlen (name));
+    g_string_append_c (out, 'y');
+    g_string_append_c (out, g_value_get_uchar (value));
+  }
+  else if (type == G_TYPE_UINT)
+  {
+    snapshot_write_string (out, name, strlen (name));
+    g_string_append_c (out, 'u');
+    snapshot_write_uint32 (out, g_value_get_uint (value));
+  }
+  else if (type == DBUS_TYPE_G_UCHAR_ARRAY)
+  {
+    GArray *bytes = g_value_get_boxed (value);
+
+    snapshot_write_string (out, name, strlen (name));
+    g_string_append_c (out, 'a');
+    snapshot_write_string (out, bytes->data, bytes->len);
+  }
+  else if (type == snapshot_path_array_type ())
+  {
+    GPtrArray *paths = g_value_get_boxed (value);
+
+    snapshot_write_string (out, name, strlen (name));
+    g_string_append_c (out, 'o');
+    snapshot_write_uint32 (out, paths->len);
+    for (i = 0; i < paths->len; i++)
+    {
+      const gchar *path = g_ptr_array_index (paths, i);
+      snapshot_write_string (out, path, strlen (path));
+    }
+  }
+  else if (type == G_TYPE_STRV)
+  {
+    gchar **strv = g_value_get_boxed (value);
+    guint len = strv ? g_strv_length (strv) : 0;
+
+    snapshot_write_string (out, name, strlen (name));
+    g_string_append_c (out, 'v');
+    snapshot_write_uint32 (out, len);
+    for (i = 0; i < len; i++)
+      snapshot_write_string (out, strv[i], strlen (strv[i]));
+  }
+  else
+  {
+    g_debug ("Not saving %s of type %s in snapshot\n",
+             name, g_type_name (type));
+  }
+}
+
+static guint
+snapshot_count_values (GHashTable *values)
+{
+  GHashTableIter iter;
+  gpointer value;
+  guint count = 0;
+
+  /* Must agree with what snapshot_write_value() knows how to write */
+  g_hash_table_iter_init (&iter, values);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+  {
+    GType type = G_VALUE_TYPE ((GValue *) value);
+
+    if (type == G_TYPE_STRING || type == G_TYPE_BOOLEAN ||
+        type == G_TYPE_UCHAR || type == G_TYPE_UINT ||
+        type == DBUS_TYPE_G_UCHAR_ARRAY ||
+        type == snapshot_path_array_type () || type == G_TYPE_STRV)
+      count++;
+  }
+
+  return count;
+}
+
+/* Encode records (of CmSnapshotRecord) into a newly allocated GString */
+GString *
+internal_snapshot_encode (GPtrArray *records)
+{
+  GString *out = g_string_new (SNAPSHOT_MAGIC);
+  GHashTableIter iter;
+  gpointer name, value;
+  guint i;
+
+  g_string_append_c (out, SNAPSHOT_VERSION);
+  snapshot_write_uint32 (out, records->len);
+
+  for (i = 0; i < records->len; i++)
+  {
+    CmSnapshotRecord *record = g_ptr_array_index (records, i);
+
+    g_string_append_c (out, record->kind);
+    snapshot_write_string (out, record->path, strlen (record->path));
+    snapshot_write_uint32 (out, snapshot_count_values (record->values));
+
+    g_hash_table_iter_init (&iter, record->values);
+    while (g_hash_table_iter_next (&iter, &name, &value))
+      snapshot_write_value (out, name, value);
+  }
+
+  return out;
+}
+
+typedef struct
+{
+  const guchar *p;
+  const guchar *end;
+} CmSnapshotReader;
+
+static gboolean
+snapshot_read_byte (CmSnapshotReader *reader, guchar *v)
+{
+  if (reader->p >= reader->end)
+    return FALSE;
+
+  *v = *reader->p++;
+  return TRUE;
+}
+
+static gboolean
+snapshot_read_uint32 (CmSnapshotReader *reader, guint32 *v)
+{
+  if (reader->end - reader->p < sizeof (*v))
+    return FALSE;
+
+  memcpy (v, reader->p, sizeof (*v));
+  *v = GUINT32_FROM_LE (*v);
+  reader->p += sizeof (*v);
+  return TRUE;
+}
+
+/* Returns the string's bytes in place, not NUL terminated */
+static gboolean
+snapshot_read_bytes (CmSnapshotReader *reader, const gchar **bytes,
+                     guint32 *len)
+{
+  if (!snapshot_read_uint32 (reader, len) ||
+      reader->end - reader->p < *len)
+    return FALSE;
+
+  *bytes = (const gchar *) reader->p;
+  reader->p += *len;
+  return TRUE;
+}
+
+static gchar *
+snapshot_read_string (CmSnapshotReader *reader)
+{
+  const gchar *bytes;
+  guint32 len;
+
+  if (!snapshot_read_bytes (reader, &bytes, &len))
+    return NULL;
+
+  return g_strndup (bytes, len);
+}
+
+static gboolean
+snapshot_read_value (CmSnapshotReader *reader, GHashTable *values)
+{
+  gchar *name;
+  guchar type, byte;
+  guint32 u, n, i;
+  gboolean ok = FALSE;
+
+  name = snapshot_read_string (reader);
+  if (!name || !snapshot_read_byte (reader, &type))
+    goto out;
+
+  switch (type)
+  {
+  case 's':
+  {
+    gchar *str = snapshot_read_string (reader);
+
+    if (!str)
+      goto out;
+    g_value_take_string (
+      internal_property_values_add (values, name, G_TYPE_STRING), str);
+    break;
+  }
+
+  case 'b':
+    if (!snapshot_read_byte (reader, &byte))
+      goto out;
+    g_value_set_boolean (
+      internal_property_values_add (values, name, G_TYPE_BOOLEAN), byte != 0);
+    break;
+
+  case 'y':
+    if (!snapshot_read_byte (reader, &byte))
+      goto out;
+    g_value_set_uchar (
+      internal_property_values_add (values, name, G_TYPE_UCHAR), byte);
+    break;
+
+  case 'u':
+    if (!snapshot_read_uint32 (reader, &u))
+      goto out;
+    g_value_set_uint (
+      internal_property_values_add (values, name, G_TYPE_UINT), u);
+    break;
+
+  case 'a':
+  {
+    const gchar *bytes;
+    GArray *array;
+
+    if (!snapshot_read_bytes (reader, &bytes, &n))
+      goto out;
+    array = g_array_sized_new (FALSE, FALSE, sizeof (guchar), n);
+    g_array_append_vals (array, bytes, n);
+    g_value_take_boxed (
+      internal_property_values_add (values, name, DBUS_TYPE_G_UCHAR_ARRAY),
+      array);
+    break;
+  }
+
+  case 'o':
+  {
+    GPtrArray *paths;
+    gchar *path;
+
+    if (!snapshot_read_uint32 (reader, &n))
+      goto out;
+    paths = g_ptr_array_new ();
+    for (i = 0; i < n; i++)
+    {
+      path = snapshot_read_string (reader);
+      if (!path)
+        break;
+      g_ptr_array_add (paths, path);
+    }
+    g_value_take_boxed (
+      internal_property_values_add (values, name, snapshot_path_array_type ()),
+      paths);
+    if (i < n)
+      goto out;
+    break;
+  }
+
+  case 'v':
+  {
+    gchar **strv;
+
+    if (!snapshot_read_uint32 (reader, &n) ||
+        n > (guint32) (reader->end - reader->p) / sizeof (guint32))
+      goto out;
+    strv = g_new0 (gchar *, n + 1);
+    for (i = 0; i < n; i++)
+    {
+      strv[i] = snapshot_read_string (reader);
+      if (!strv[i])
+        break;
+    }
+    g_value_take_boxed (
+      internal_property_values_add (values, name, G_TYPE_STRV), strv);
+    if (i < n)
+      goto out;
+    break;
+  }
+
+  default:
+    goto out;
+  }
+
+  ok = TRUE;
+
+ out:
+  g_free (name);
+  return ok;
+}
+
+/*
+ * Decode a snapshot into a GPtrArray of CmSnapshotRecord, in the order
+ * they were written.  Returns NULL if data is not a valid snapshot.
+ */
+GPtrArray *
+internal_snapshot_decode (const gchar *data, gsize len)
+{
+  CmSnapshotReader reader;
+  CmSnapshotRecord *record;
+  GPtrArray *records;
+  guint32 count, n, i, j;
+  guchar version, kind;
+  gchar *path;
+
+  reader.p = (const guchar *) data;
+  reader.end = reader.p + len;
+
+  if (len < strlen (SNAPSHOT_MAGIC) ||
+      memcmp (data, SNAPSHOT_MAGIC, strlen (SNAPSHOT_MAGIC)) != 0)
+    return NULL;
+  reader.p += strlen (SNAPSHOT_MAGIC);
+
+  if (!snapshot_read_byte (&reader, &version) ||
+      version != SNAPSHOT_VERSION ||
+      !snapshot_read_uint32 (&reader, &count))
+    return NULL;
+
+  records = g_ptr_array_new ();
+  for (i = 0; i < count; i++)
+  {
+    if (!snapshot_read_byte (&reader, &kind))
+      goto fail;
+
+    path = snapshot_read_string (&reader);
+    if (!path)
+      goto fail;
+
+    record = internal_snapshot_record_new (kind, path);
+    g_free (path);
+    g_ptr_array_add (records, record);
+
+    if (!snapshot_read_uint32 (&reader, &n))
+      goto fail;
+
+    for (j = 0; j < n; j++)
+    {
+      if (!snapshot_read_value (&reader, record->values))
+        goto fail;
+    }
+  }
+
+  return records;
+
+ fail:
+  g_ptr_array_foreach (records, (GFunc) internal_snapshot_record_free, NULL);
+  g_ptr_array_free (records, TRUE);
+  return NULL;
+}
@@ -0,0 +1,271 @@
+/*
+ * Gconnman - a GObject wrapper for the Connman D-Bus API
+ * Copyright © 2009, Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ */
+
+/*
+ * D-Bus traffic counters.
+ *
+ * The counters are a CmStats updated in place with atomic increments, so
+ * counting costs no locks or allocations and the histograms never grow.
+ * Each in-flight call carries a CmStatsCall holding its start time; the
+ * call's destroy notify frees it, which also covers cancelled calls.
+ * The counters are reference counted so that a call outliving its
+ * manager still has somewhere to report to.
+ */
+#include <string.h>
+#include <glib.h>
+
+#include "gconnman-internal.h"
+
+#define STATS_FIRST_LIMIT 64 /* microseconds, the limit of bucket 0 */
+
+struct _CmStatsCounters
+{
+  gint ref_count;
+  GTimer *timer;
+  CmStats stats;
+};
+
+#define STATS_INC(field) g_atomic_int_inc ((gint *) &(field))
+#define STATS_DEC(field) g_atomic_int_add ((gint *) &(field), -1)
+
+CmStatsCounters *
+internal_stats_new (void)
+{
+  CmStatsCounters *counters = g_slice_new0 (CmStatsCounters);
+
+  counters->ref_count = 1;
+  counters->timer = g_timer_new ();
+
+  return counters;
+}
+
+CmStatsCounters *
+internal_stats_ref (CmStatsCounters *counters)
+{
+  g_atomic_int_inc (&counters->ref_count);
+  return counters;
+}
+
+void
+internal_stats_unref (CmStatsCounters *counters)
+{
+  if (!g_atomic_int_dec_and_test (&counters->ref_count))
+    return;
+
+  g_timer_destroy (counters->timer);
+  g_slice_free (CmStatsCounters, counters);
+}
+
+void
+internal_stats_copy (CmStatsCounters *counters, CmStats *stats)
+{
+  const guint *from = (const guint *) &counters->stats;
+  guint *to = (guint *) stats;
+  guint i;
+
+  /* Every field before elapsed is a guint counter */
+  for (i = 0; i < G_STRUCT_OFFSET (CmStats, elapsed) / sizeof (guint); i++)
+    to[i] = g_atomic_int_get ((gint *) &from[i]);
+
+  stats->elapsed = g_timer_elapsed (counters->timer, NULL);
+}
+
+/* Zero everything but the calls still in flight */
+void
+internal_stats_reset (CmStatsCounters *counters)
+{
+  guint in_flight = g_atomic_int_get ((gint *) &counters->stats.in_flight);
+
+  memset (&counters->stats, 0, sizeof (counters->stats));
+  counters->stats.in_flight = in_flight;
+  g_timer_start (counters->timer);
+}
+
+void
+internal_stats_signal (CmStatsCounters *counters, CmStatsInterface iface)
+{
+  if (counters)
+    STATS_INC (counters->stats.signals[iface]);
+}
+
+static guint
+stats_bucket (gdouble seconds)
+{
+  guint us = seconds * 1e6;
+  guint bucket = 0;
+
+  for (us /= STATS_FIRST_LIMIT; us && bucket < STATS_LATENCY_BUCKETS - 1;
+       us >>= 1)
+    bucket++;
+
+  return bucket;
+}
+
+/*
+ * Count a call to method on iface, if there are counters.  data is what
+ * the call's notify function would have been passed; it gets it back
+ * from internal_stats_call_data().  Pass internal_stats_call_free as the
+ * call's destroy notify.
+ */
+CmStatsCall *
+internal_stats_call_new (CmStatsCounters *counters, CmStatsInterface iface,
+                         CmStatsMethod method, gpointer data)
+{
+  CmStatsCall *call = g_slice_new (CmStatsCall);
+
+  call->counters = counters ? internal_stats_ref (counters) : NULL;
+  call->iface = iface;
+  call->method = method;
+  call->data = data;
+  call->done = FALSE;
+
+  if (counters)
+  {
+    call->start = g_timer_elapsed (counters->timer, NULL);
+    STATS_INC (counters->stats.methods[iface][method].calls);
+    STATS_INC (counters->stats.in_flight);
+  }
+
+  return call;
+}
+
+gpointer
+internal_stats_call_data (CmStatsCall *call)
+{
+  return call->data;
+}
+
+/* The reply arrived; ok is whether it was not an error */
+void
+internal_stats_call_done (CmStatsCall *call, gboolean ok)
+{
+  CmStatsMethodCounts *counts;
+  gdouble elapsed;
+
+  if (!call->counters || call->done)
+    return;
+
+  call->done = TRUE;
+  counts = &call->counters->stats.methods[call->iface][call->method];
+  elapsed = g_timer_elapsed (call->counters->timer, NULL) - call->start;
+
+  if (!ok)
+    STATS_INC (counts->errors);
+  STATS_INC (counts->latency[stats_bucket (elapsed)]);
+  STATS_DEC (call->counters->stats.in_flight);
+}
+
+/* For calls with no return values, in place of dbus_g_proxy_end_call() */
+gboolean
+internal_stats_end_call (DBusGProxy *proxy, DBusGProxyCall *call,
+                         CmStatsCall *stats, GError **error)
+{
+  gboolean ok = dbus_g_proxy_end_call (proxy, call, error, G_TYPE_INVALID);
+
+  internal_stats_call_done (stats, ok);
+  return ok;
+}
+
+void
+internal_stats_call_free (gpointer data)
+{
+  CmStatsCall *call = data;
+
+  if (call->counters)
+  {
+    /* Cancelled, or never answered */
+    if (!call->done)
+      STATS_DEC (call->counters->stats.in_flight);
+    internal_stats_unref (call->counters);
+  }
+
+  g_slice_free (CmStatsCall, call);
+}
+
+/* Public helpers for reading a CmStats */
+
+guint
+cm_stats_get_calls (const CmStats *stats, CmStatsInterface iface)
+{
+  guint method, calls = 0;
+
+  for (method = 0; method < STATS_METHOD_LAST; method++)
+    calls += stats->methods[iface][method].calls;
+
+  return calls;
+}
+
+guint
+cm_stats_get_errors (const CmStats *stats, CmStatsInterface iface)
+{
+  guint method, errors = 0;
+
+  for (method = 0; method < STATS_METHOD_LAST; method++)
+    errors += stats->methods[iface][method].errors;
+
+  return errors;
+}
+
+/* PropertyChanged signals per second received on iface */
+gdouble
+cm_stats_get_signal_rate (const CmStats *stats, CmStatsInterface iface)
+{
+  if (stats->elapsed <= 0)
+    return 0;
+
+  return stats->signals[iface] / stats->elapsed;
+}
+
+/* The round trip time, in microseconds, that bucket counts replies under */
+guint
+cm_stats_get_bucket_limit (guint bucket)
+{
+  if (bucket >= STATS_LATENCY_BUCKETS - 1)
+    return G_MAXUINT;
+
+  return STATS_FIRST_LIMIT << bucket;
+}
+
+/*
+ * An upper bound, in microseconds, on the round trip time of percent of
+ * the replies to method on iface; 0 if there were none
+ */
+guint
+cm_stats_get_latency_percentile (const CmStats *stats, CmStatsInterface iface,
+                                 CmStatsMethod method, guint percent)
+{
+  const CmStatsMethodCounts *counts = &stats->methods[iface][method];
+  guint64 total = 0, seen = 0;
+  guint bucket;
+
+  for (bucket = 0; bucket < STATS_LATENCY_BUCKETS; bucket++)
+    total += counts->latency[bucket];
+
+  if (total == 0)
+    return 0;
+
+  for (bucket = 0; bucket < STATS_LATENCY_BUCKETS; bucket++)
+  {
+    seen += counts->latency[bucket];
+    if (seen * 100 >= total * MIN (percent, 100))
+      break;
+  }
+
+  return cm_stats_get_bucket_limit (MIN (bucket, STATS_LATENCY_BUCKETS - 1));
+}
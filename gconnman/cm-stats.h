@@ -0,0 +1,88 @@
+/*
+ * Gconnman - a GObject wrapper for the Connman D-Bus API
+ * Copyright © 2009, Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ */
+
+#ifndef __cm_stats_h__
+#define __cm_stats_h__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * D-Bus traffic counters, kept by every CmManager for itself and the
+ * objects it owns.  cm_manager_get_stats() copies them into a CmStats.
+ */
+
+typedef enum
+{
+  STATS_INTERFACE_MANAGER,
+  STATS_INTERFACE_DEVICE,
+  STATS_INTERFACE_NETWORK,
+  STATS_INTERFACE_SERVICE,
+  STATS_INTERFACE_CONNECTION,
+  STATS_INTERFACE_LAST
+} CmStatsInterface;
+
+typedef enum
+{
+  STATS_METHOD_GET_PROPERTIES,
+  STATS_METHOD_SET_PROPERTY,
+  STATS_METHOD_CONNECT,      /* Service.Connect and Manager.ConnectService */
+  STATS_METHOD_DISCONNECT,
+  STATS_METHOD_REQUEST_SCAN,
+  STATS_METHOD_PROPOSE_SCAN,
+  STATS_METHOD_OTHER,        /* Remove, MoveBefore, EnableTechnology, ... */
+  STATS_METHOD_LAST
+} CmStatsMethod;
+
+/*
+ * Round trip latency histogram buckets.  Bucket 0 counts replies within
+ * 64us, and each bucket after that doubles the limit; the last one
+ * counts everything slower than about a second.
+ */
+#define STATS_LATENCY_BUCKETS 16
+
+typedef struct
+{
+  guint calls;       /* made */
+  guint errors;      /* replies that were errors */
+  guint latency[STATS_LATENCY_BUCKETS]; /* replies, by round trip time */
+} CmStatsMethodCounts;
+
+typedef struct
+{
+  CmStatsMethodCounts methods[STATS_INTERFACE_LAST][STATS_METHOD_LAST];
+  guint signals[STATS_INTERFACE_LAST]; /* PropertyChanged received */
+  guint in_flight;                     /* calls awaiting a reply */
+  gdouble elapsed;                     /* seconds counted over */
+} CmStats;
+
+guint cm_stats_get_calls (const CmStats *stats, CmStatsInterface iface);
+guint cm_stats_get_errors (const CmStats *stats, CmStatsInterface iface);
+gdouble cm_stats_get_signal_rate (const CmStats *stats,
+                                  CmStatsInterface iface);
+guint cm_stats_get_bucket_limit (guint bucket);
+guint cm_stats_get_latency_percentile (const CmStats *stats,
+                                       CmStatsInterface iface,
+                                       CmStatsMethod method,
+                                       guint percent);
+
+G_END_DECLS
+
+#endif /* __cm_stats_h__ */
@@ -4,6 +4,8 @@
 #include <glib.h>
 #include <dbus/dbus.h>
 #include <dbus/dbus-glib.h>
+#include <dbus/dbus-glib-lowlevel.h>
+#include <gio/gio.h>
 #include <gconnman/gconnman.h>
 
 
@@ -14,8 +16,324 @@ CmNetwork *internal_network_new (DBusGProxy *proxy, CmDevice *device,
 CmDevice *internal_device_new (DBusGProxy *proxy, const gchar *path,
                                CmManager *manager, GError **error);
 CmService *internal_service_new (DBusGProxy *proxy, const gchar *path,
-				 gint order, CmManager *manager, GError **error);
+				 gint order, gboolean lazy, CmManager *manager,
+				 GError **error);
 CmConnection *internal_connection_new (DBusGProxy *proxy, const gchar *path,
                                        CmManager *manager, GError **error);
 
+/* (re)read an object's properties through the manager's fetch queue */
+void internal_network_fetch_properties (CmNetwork *network);
+void internal_device_fetch_properties (CmDevice *device);
+void internal_service_fetch_properties (CmService *service);
+void internal_connection_fetch_properties (CmConnection *connection);
+
+/* apply a GetProperties result, as if it had just been received */
+void internal_network_apply_properties (CmNetwork *network,
+                                        GHashTable *properties);
+void internal_device_apply_properties (CmDevice *device,
+                                       GHashTable *properties);
+void internal_service_apply_properties (CmService *service,
+                                        GHashTable *properties);
+void internal_connection_apply_properties (CmConnection *connection,
+                                           GHashTable *properties);
+
+#ifdef CM_TRANSPORT_GDBUS
+/* the same, from the a{sv} of a GetProperties reply read with GDBus */
+void internal_manager_apply_variant (CmManager *manager, GVariant *properties);
+void internal_network_apply_variant (CmNetwork *network, GVariant *properties);
+void internal_device_apply_variant (CmDevice *device, GVariant *properties);
+void internal_service_apply_variant (CmService *service,
+                                     GVariant *properties);
+void internal_connection_apply_variant (CmConnection *connection,
+                                        GVariant *properties);
+#endif
+
+/* a PropertyChanged signal, handed on by the manager's dispatcher */
+void internal_network_property_changed (CmNetwork *network, const gchar *key,
+                                        GValue *value);
+void internal_device_property_changed (CmDevice *device, const gchar *key,
+                                       GValue *value);
+void internal_service_property_changed (CmService *service, const gchar *key,
+                                        GValue *value);
+void internal_connection_property_changed (CmConnection *connection,
+                                           const gchar *key, GValue *value);
+
+/* the inverse of apply, for snapshots: name -> GValue of each known property */
+void internal_network_export_properties (CmNetwork *network,
+                                         GHashTable *values);
+void internal_device_export_properties (CmDevice *device, GHashTable *values);
+void internal_service_export_properties (CmService *service,
+                                         GHashTable *values);
+
+/* object registry */
+typedef enum
+{
+  REGISTRY_DEVICES,
+  REGISTRY_SERVICES,
+  REGISTRY_CONNECTIONS,
+  REGISTRY_NETWORKS,
+  REGISTRY_LAST
+} CmRegistryKind;
+
+typedef struct
+{
+  GList *added;
+  GList *removed;
+  GList *moved;
+} CmReconcileResult;
+
+typedef gpointer (*CmReconcileNewFunc) (const gchar *path, guint position,
+                                        gpointer data);
+
+void internal_manager_reconcile (CmManager *manager, CmRegistryKind kind,
+                                 GList **list, GPtrArray *paths,
+                                 CmReconcileNewFunc new_func, gpointer data,
+                                 CmReconcileResult *result);
+void internal_manager_unregister_network (CmManager *manager,
+                                          CmNetwork *network);
+
+/* references that wait for their target to register */
+typedef void (*CmResolvedFunc) (GObject *object, gpointer target);
+
+gpointer internal_manager_resolve (CmManager *manager, CmRegistryKind kind,
+                                   const gchar *path, GObject *object,
+                                   CmResolvedFunc resolved);
+void internal_manager_forget (CmManager *manager, CmRegistryKind kind,
+                              GObject *object);
+
+/* coalesced "*-updated" emission */
+typedef void (*CmUpdateFunc) (gpointer object);
+
+gboolean internal_manager_queue_update (CmManager *manager, GObject *object,
+                                        CmUpdateFunc flush);
+
+/* Strength filtering, set up by cm_manager_set_strength_filter() */
+typedef void (*CmStrengthFunc) (gpointer object, guchar strength);
+
+typedef struct
+{
+  gpointer object;
+  CmStrengthFunc publish;  /* publishes a value held back until later */
+  gboolean known;          /* whether value has been set */
+  guchar value;            /* last published */
+  guchar pending;          /* held back */
+  gint direction;          /* of the last published change: -1, 0 or 1 */
+  gdouble published;       /* when value was published */
+  guint timeout;           /* publishes pending */
+} CmStrengthFilter;
+
+void internal_strength_filter_init (CmStrengthFilter *filter, gpointer object,
+                                    CmStrengthFunc publish);
+void internal_strength_filter_clear (CmStrengthFilter *filter);
+gboolean internal_manager_filter_strength (CmManager *manager,
+                                           CmStrengthFilter *filter,
+                                           guchar value);
+
+/* one of the manager's technology lists */
+typedef struct
+{
+  GList *names; /* interned, in ConnMan's order */
+  guint mask;   /* CM_TECHNOLOGY_BIT() of each known technology */
+} CmTechnologies;
+
+/* packed service scalars, see cm-service-table.c */
+typedef struct _CmServiceTable CmServiceTable;
+
+enum
+{
+  SERVICE_HOT_LISTED    = 1 << 0, /* in the manager's services */
+  SERVICE_HOT_FAVORITE  = 1 << 1,
+  SERVICE_HOT_CONNECTED = 1 << 2,
+};
+
+typedef struct
+{
+  CmService *service; /* NULL for a free slot */
+  gint order;
+  CmServiceState state;
+  guchar strength;
+  guchar flags;
+} CmServiceHot;
+
+CmServiceTable *internal_service_table_new (void);
+CmServiceTable *internal_service_table_ref (CmServiceTable *table);
+void internal_service_table_unref (CmServiceTable *table);
+guint internal_service_table_add (CmServiceTable *table, CmService *service);
+void internal_service_table_remove (CmServiceTable *table, guint slot);
+CmServiceHot *internal_service_table_get (CmServiceTable *table, guint slot);
+CmService *internal_service_table_best (CmServiceTable *table,
+                                        guint min_strength,
+                                        gboolean favorite_only);
+
+CmServiceTable *internal_manager_get_service_table (CmManager *manager);
+void internal_service_unlist (CmService *service);
+
+/* batched GetProperties */
+typedef void (*CmPropertiesFunc) (gpointer object, GHashTable *properties);
+
+typedef void (*CmFetchDoneFunc) (gpointer object, const GError *error);
+
+void internal_manager_get_properties (CmManager *manager, GObject *object,
+                                      DBusGProxy *proxy,
+                                      CmPropertiesFunc apply);
+gboolean internal_manager_get_properties_full (CmManager *manager,
+                                               GObject *object,
+                                               DBusGProxy *proxy,
+                                               CmPropertiesFunc apply,
+                                               CmFetchDoneFunc done);
+
+/* D-Bus traffic counters */
+typedef struct _CmStatsCounters CmStatsCounters;
+
+typedef struct
+{
+  CmStatsCounters *counters; /* NULL if not counted */
+  CmStatsInterface iface;
+  CmStatsMethod method;
+  gdouble start;
+  gboolean done;
+  gpointer data;
+} CmStatsCall;
+
+CmStatsCounters *internal_stats_new (void);
+CmStatsCounters *internal_stats_ref (CmStatsCounters *counters);
+void internal_stats_unref (CmStatsCounters *counters);
+void internal_stats_copy (CmStatsCounters *counters, CmStats *stats);
+void internal_stats_reset (CmStatsCounters *counters);
+void internal_stats_signal (CmStatsCounters *counters, CmStatsInterface iface);
+CmStatsCall *internal_stats_call_new (CmStatsCounters *counters,
+                                      CmStatsInterface iface,
+                                      CmStatsMethod method, gpointer data);
+gpointer internal_stats_call_data (CmStatsCall *call);
+void internal_stats_call_done (CmStatsCall *call, gboolean ok);
+void internal_stats_call_free (gpointer call);
+gboolean internal_stats_end_call (DBusGProxy *proxy, DBusGProxyCall *call,
+                                  CmStatsCall *stats, GError **error);
+
+CmStatsCall *internal_manager_stats_call (CmManager *manager,
+                                          CmStatsInterface iface,
+                                          CmStatsMethod method,
+                                          gpointer data);
+void internal_manager_stats_signal (CmManager *manager,
+                                    CmStatsInterface iface);
+
+/* *_async() calls */
+typedef struct
+{
+  GSimpleAsyncResult *result;
+  const gchar *method;      /* for messages */
+  CmStatsCall *stats;
+  GCancellable *cancellable;
+  gulong cancelled_id;
+  guint cancel_idle;
+  DBusGProxy *proxy;
+  DBusGProxyCall *call;
+  gboolean completed;
+} CmAsyncCall;
+
+CmAsyncCall *internal_async_call_new (gpointer source, const gchar *method,
+                                      CmStatsCall *stats,
+                                      GCancellable *cancellable,
+                                      GAsyncReadyCallback callback,
+                                      gpointer user_data, gpointer source_tag);
+gboolean internal_async_call_start (CmAsyncCall *async, DBusGProxy *proxy,
+                                    DBusGProxyCall *call);
+void internal_async_call_complete (CmAsyncCall *async, GError *error);
+void internal_async_call_notify (DBusGProxy *proxy, DBusGProxyCall *call,
+                                 gpointer data);
+void internal_async_call_free (gpointer data);
+void internal_async_report (gpointer source, GAsyncReadyCallback callback,
+                            gpointer user_data, gpointer source_tag,
+                            GError *error);
+gboolean internal_async_finish (gpointer source, GAsyncResult *result,
+                                gpointer source_tag, GError **error);
+
+/* table driven property decoding */
+typedef enum
+{
+  PROPERTY_STRING,  /* gchar *, owned */
+  PROPERTY_INTERNED, /* const gchar *, from g_intern_string() */
+  PROPERTY_BOOLEAN, /* gboolean */
+  PROPERTY_BYTE,    /* guchar */
+  PROPERTY_UINT,    /* guint */
+  PROPERTY_CUSTOM,  /* handed to the descriptor's decode function */
+  PROPERTY_IGNORE,  /* known, but not tracked */
+} CmPropertyType;
+
+typedef struct
+{
+  const gchar *name;
+  CmPropertyType type;
+  glong offset;     /* of the field in the private struct */
+  gint signal;      /* index into the class' signal table, -1 for none */
+  guint mask;       /* *_INFO_* bit, 0 for none */
+  /*
+   * Decodes PROPERTY_CUSTOM, returning whether anything changed.  For the
+   * plain types it is a hook run after the stored value changed.
+   */
+  gboolean (*decode) (gpointer object, const GValue *value);
+} CmProperty;
+
+GHashTable *internal_property_table_new (const CmProperty *properties,
+                                         guint n_properties);
+const CmProperty *internal_property_lookup (GHashTable *table,
+                                            const gchar *key);
+const CmProperty *internal_property_apply (GHashTable *table, gpointer object,
+                                           gpointer priv, const gchar *key,
+                                           const GValue *value,
+                                           gboolean *changed);
+#ifdef CM_TRANSPORT_GDBUS
+const CmProperty *internal_property_apply_variant (GHashTable *table,
+                                                   gpointer object,
+                                                   gpointer priv,
+                                                   const gchar *key,
+                                                   GVariant *variant,
+                                                   gboolean *changed);
+gboolean internal_property_value_from_variant (GVariant *variant,
+                                               GValue *value);
+#endif
+gboolean internal_property_value_from_iter (DBusMessageIter *iter,
+                                            GValue *value);
+
+/* string values from a small, fixed vocabulary */
+typedef struct
+{
+  const gchar *name;
+  gint value;
+} CmEnumName;
+
+gint internal_enum_from_string (const CmEnumName *names, guint n_names,
+                                const gchar *str);
+CmIPv4Method internal_ipv4_method_from_string (const gchar *method);
+CmSecurity internal_security_from_string (const gchar *security);
+CmDeviceType internal_device_type_from_string (const gchar *type);
+
+GHashTable *internal_property_values_new (void);
+GValue *internal_property_values_add (GHashTable *values, const gchar *key,
+                                      GType type);
+void internal_property_export (GHashTable *table, gpointer priv,
+                               GHashTable *values);
+
+/* snapshots */
+typedef enum
+{
+  SNAPSHOT_MANAGER = 'm',
+  SNAPSHOT_DEVICE  = 'd',
+  SNAPSHOT_NETWORK = 'n',
+  SNAPSHOT_SERVICE = 's',
+} CmSnapshotKind;
+
+typedef struct
+{
+  CmSnapshotKind kind;
+  gchar *path;
+  GHashTable *values; /* property name -> GValue */
+} CmSnapshotRecord;
+
+CmSnapshotRecord *internal_snapshot_record_new (CmSnapshotKind kind,
+                                                const gchar *path);
+void internal_snapshot_record_free (CmSnapshotRecord *record);
+GString *internal_snapshot_encode (GPtrArray *records);
+GPtrArray *internal_snapshot_decode (const gchar *data, gsize len);
+
 #endif
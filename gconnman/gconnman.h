@@ -1,10 +1,13 @@
 #ifndef __gconnman_h__
 #define __gconnman_h__
 
+#include <gio/gio.h>
+
 #include <gconnman/cm-manager.h>
 #include <gconnman/cm-device.h>
 #include <gconnman/cm-network.h>
 #include <gconnman/cm-service.h>
 #include <gconnman/cm-connection.h>
+#include <gconnman/cm-stats.h>
 
 #endif
@@ -0,0 +1,763 @@
+/*
+ * A fake ConnMan daemon on a private bus, for tests and benchmarks.
+ *
+ * See mock-connman.h.  Everything is answered straight from the mock's
+ * counters, so any number of services and networks costs no memory
+ * until they are asked for.
+ */
+#include <signal.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <glib.h>
+#include <dbus/dbus.h>
+#include <dbus/dbus-glib-lowlevel.h>
+
+#include "mock-connman.h"
+
+#define MOCK_SERVICE          "org.moblin.connman"
+#define MOCK_INTERFACE(kind)  MOCK_SERVICE "." kind
+#define MOCK_SERVICE_PREFIX   "/service/mock_"
+#define MOCK_NETWORK_PREFIX   MOCK_CONNMAN_DEVICE_PATH "/network_"
+
+#define MOCK_CONNMAN_ERROR    g_quark_from_static_string ("mock-connman-error")
+
+struct _MockConnman
+{
+  GPid bus_pid;
+  gchar *address;
+  DBusConnection *bus;
+
+  guint pool;                   /* 0 if paths never wrap */
+  guint offset;
+  guint n_services;
+  guint n_networks;
+  guint strength_seq;
+
+  gboolean offline_mode;
+  gboolean wifi_enabled;
+  gchar *connected;             /* path of the connected service, if any */
+};
+
+static gchar *
+mock_path (MockConnman *mock, const gchar *prefix, guint i)
+{
+  guint n = mock->offset + i;
+
+  if (mock->pool)
+    n %= mock->pool;
+
+  return g_strdup_printf ("%s%u", prefix, n);
+}
+
+gchar *
+mock_connman_service_path (MockConnman *mock, guint i)
+{
+  return mock_path (mock, MOCK_SERVICE_PREFIX, i);
+}
+
+gchar *
+mock_connman_network_path (MockConnman *mock, guint i)
+{
+  return mock_path (mock, MOCK_NETWORK_PREFIX, i);
+}
+
+static GPtrArray *
+mock_paths (MockConnman *mock, const gchar *prefix, guint n)
+{
+  GPtrArray *paths = g_ptr_array_sized_new (n);
+  guint i;
+
+  for (i = 0; i < n; i++)
+    g_ptr_array_add (paths, mock_path (mock, prefix, i));
+
+  return paths;
+}
+
+static void
+mock_list_free (GPtrArray *paths)
+{
+  g_ptr_array_foreach (paths, (GFunc) g_free, NULL);
+  g_ptr_array_free (paths, TRUE);
+}
+
+static guchar
+mock_strength (MockConnman *mock, const gchar *path)
+{
+  return (g_str_hash (path) + mock->strength_seq) % 100;
+}
+
+/* Message building */
+
+static void
+mock_append_variant (DBusMessageIter *iter, int type, const void *value)
+{
+  DBusMessageIter variant;
+  char signature[2] = { type, '\0' };
+
+  dbus_message_iter_open_container (iter, DBUS_TYPE_VARIANT, signature,
+                                    &variant);
+  dbus_message_iter_append_basic (&variant, type, value);
+  dbus_message_iter_close_container (iter, &variant);
+}
+
+/* An array of strings or object paths, in a variant */
+static void
+mock_append_variant_list (DBusMessageIter *iter, int type, GPtrArray *items)
+{
+  DBusMessageIter variant, array;
+  char signature[3] = { DBUS_TYPE_ARRAY, type, '\0' };
+  guint i;
+
+  dbus_message_iter_open_container (iter, DBUS_TYPE_VARIANT, signature,
+                                    &variant);
+  dbus_message_iter_open_container (&variant, DBUS_TYPE_ARRAY, signature + 1,
+                                    &array);
+  for (i = 0; i < items->len; i++)
+    dbus_message_iter_append_basic (&array, type, &items->pdata[i]);
+  dbus_message_iter_close_container (&variant, &array);
+  dbus_message_iter_close_container (iter, &variant);
+}
+
+static void
+mock_append_bytes_variant (DBusMessageIter *iter, const gchar *bytes)
+{
+  DBusMessageIter variant, array;
+
+  dbus_message_iter_open_container (iter, DBUS_TYPE_VARIANT, "ay", &variant);
+  dbus_message_iter_open_container (&variant, DBUS_TYPE_ARRAY, "y", &array);
+  dbus_message_iter_append_fixed_array (&array, DBUS_TYPE_BYTE, &bytes,
+                                        strlen (bytes));
+  dbus_message_iter_close_container (&variant, &array);
+  dbus_message_iter_close_container (iter, &variant);
+}
+
+static void
+mock_append_entry (DBusMessageIter *dict, const char *key, int type,
+                   const void *value)
+{
+  DBusMessageIter entry;
+
+  dbus_message_iter_open_container (dict, DBUS_TYPE_DICT_ENTRY, NULL, &entry);
+  dbus_message_iter_append_basic (&entry, DBUS_TYPE_STRING, &key);
+  mock_append_variant (&entry, type, value);
+  dbus_message_iter_close_container (dict, &entry);
+}
+
+static void
+mock_append_string_entry (DBusMessageIter *dict, const char *key,
+                          const char *value)
+{
+  mock_append_entry (dict, key, DBUS_TYPE_STRING, &value);
+}
+
+/* Consumes items */
+static void
+mock_append_list_entry (DBusMessageIter *dict, const char *key, int type,
+                        GPtrArray *items)
+{
+  DBusMessageIter entry;
+
+  dbus_message_iter_open_container (dict, DBUS_TYPE_DICT_ENTRY, NULL, &entry);
+  dbus_message_iter_append_basic (&entry, DBUS_TYPE_STRING, &key);
+  mock_append_variant_list (&entry, type, items);
+  dbus_message_iter_close_container (dict, &entry);
+  mock_list_free (items);
+}
+
+static void
+mock_append_paths_entry (DBusMessageIter *dict, const char *key,
+                         GPtrArray *items)
+{
+  mock_append_list_entry (dict, key, DBUS_TYPE_OBJECT_PATH, items);
+}
+
+/* A list holding item, or nothing */
+static GPtrArray *
+mock_single (gboolean present, const gchar *item)
+{
+  GPtrArray *items = g_ptr_array_new ();
+
+  if (present)
+    g_ptr_array_add (items, g_strdup (item));
+
+  return items;
+}
+
+static const gchar *
+mock_manager_state (MockConnman *mock)
+{
+  return mock->connected ? "online" : "offline";
+}
+
+/* Properties, by object */
+
+static void
+mock_manager_properties (MockConnman *mock, DBusMessageIter *dict)
+{
+  mock_append_string_entry (dict, "State", mock_manager_state (mock));
+  mock_append_entry (dict, "OfflineMode", DBUS_TYPE_BOOLEAN,
+                     &mock->offline_mode);
+  mock_append_paths_entry (dict, "Services",
+                           mock_paths (mock, MOCK_SERVICE_PREFIX,
+                                       mock->n_services));
+  mock_append_paths_entry (dict, "Devices",
+                           mock_single (TRUE, MOCK_CONNMAN_DEVICE_PATH));
+  mock_append_paths_entry (dict, "Connections",
+                           mock_single (mock->connected != NULL,
+                                        MOCK_CONNMAN_CONNECTION_PATH));
+
+  mock_append_list_entry (dict, "AvailableTechnologies", DBUS_TYPE_STRING,
+                          mock_single (TRUE, "wifi"));
+  mock_append_list_entry (dict, "EnabledTechnologies", DBUS_TYPE_STRING,
+                          mock_single (mock->wifi_enabled, "wifi"));
+  mock_append_list_entry (dict, "ConnectedTechnologies", DBUS_TYPE_STRING,
+                          mock_single (mock->connected != NULL, "wifi"));
+}
+
+static void
+mock_device_properties (MockConnman *mock, DBusMessageIter *dict)
+{
+  dbus_bool_t no = FALSE;
+
+  mock_append_string_entry (dict, "Name", "Mock WiFi");
+  mock_append_string_entry (dict, "Type", "wifi");
+  mock_append_string_entry (dict, "Interface", "wlan0");
+  mock_append_string_entry (dict, "Address", "00:11:22:33:44:55");
+  mock_append_entry (dict, "Powered", DBUS_TYPE_BOOLEAN, &mock->wifi_enabled);
+  mock_append_entry (dict, "Scanning", DBUS_TYPE_BOOLEAN, &no);
+  mock_append_paths_entry (dict, "Networks",
+                           mock_paths (mock, MOCK_NETWORK_PREFIX,
+                                       mock->n_networks));
+}
+
+static void
+mock_network_properties (MockConnman *mock, const char *path,
+                         DBusMessageIter *dict)
+{
+  const char *name = strrchr (path, '/') + 1;
+  const char *device = MOCK_CONNMAN_DEVICE_PATH;
+  guchar strength = mock_strength (mock, path);
+  dbus_bool_t no = FALSE;
+  DBusMessageIter entry;
+  const char *key = "WiFi.SSID";
+
+  mock_append_string_entry (dict, "Name", name);
+  mock_append_entry (dict, "Strength", DBUS_TYPE_BYTE, &strength);
+  mock_append_entry (dict, "Connected", DBUS_TYPE_BOOLEAN, &no);
+  mock_append_string_entry (dict, "WiFi.Mode", "managed");
+  mock_append_string_entry (dict, "WiFi.Security", "none");
+  mock_append_entry (dict, "Device", DBUS_TYPE_OBJECT_PATH, &device);
+
+  dbus_message_iter_open_container (dict, DBUS_TYPE_DICT_ENTRY, NULL, &entry);
+  dbus_message_iter_append_basic (&entry, DBUS_TYPE_STRING, &key);
+  mock_append_bytes_variant (&entry, name);
+  dbus_message_iter_close_container (dict, &entry);
+}
+
+static const gchar *
+mock_service_state (MockConnman *mock, const char *path)
+{
+  return g_strcmp0 (mock->connected, path) == 0 ? "ready" : "idle";
+}
+
+static void
+mock_service_properties (MockConnman *mock, const char *path,
+                         DBusMessageIter *dict)
+{
+  guchar strength = mock_strength (mock, path);
+  dbus_bool_t favorite = g_strcmp0 (mock->connected, path) == 0;
+
+  mock_append_string_entry (dict, "Name", strrchr (path, '/') + 1);
+  mock_append_string_entry (dict, "State", mock_service_state (mock, path));
+  mock_append_string_entry (dict, "Type", "wifi");
+  mock_append_string_entry (dict, "Mode", "managed");
+  mock_append_string_entry (dict, "Security", "none");
+  mock_append_entry (dict, "Strength", DBUS_TYPE_BYTE, &strength);
+  mock_append_entry (dict, "Favorite", DBUS_TYPE_BOOLEAN, &favorite);
+}
+
+static void
+mock_connection_properties (MockConnman *mock, DBusMessageIter *dict)
+{
+  const char *device = MOCK_CONNMAN_DEVICE_PATH;
+  gchar *network = mock_connman_network_path (mock, 0);
+  guchar strength = mock_strength (mock, network);
+  dbus_bool_t yes = TRUE;
+
+  mock_append_string_entry (dict, "Type", "wifi");
+  mock_append_string_entry (dict, "Interface", "wlan0");
+  mock_append_entry (dict, "Strength", DBUS_TYPE_BYTE, &strength);
+  mock_append_entry (dict, "Default", DBUS_TYPE_BOOLEAN, &yes);
+  mock_append_entry (dict, "Device", DBUS_TYPE_OBJECT_PATH, &device);
+  if (mock->n_networks)
+    mock_append_entry (dict, "Network", DBUS_TYPE_OBJECT_PATH, &network);
+  mock_append_string_entry (dict, "IPv4.Method", "dhcp");
+  mock_append_string_entry (dict, "IPv4.Address", "10.0.0.2");
+  mock_append_string_entry (dict, "IPv4.Netmask", "255.255.255.0");
+  mock_append_string_entry (dict, "IPv4.Gateway", "10.0.0.1");
+
+  g_free (network);
+}
+
+/* Signals */
+
+static DBusMessage *
+mock_signal_new (const char *path, const char *interface, const char *key,
+                 DBusMessageIter *iter)
+{
+  DBusMessage *signal;
+
+  signal = dbus_message_new_signal (path, interface, "PropertyChanged");
+  dbus_message_iter_init_append (signal, iter);
+  dbus_message_iter_append_basic (iter, DBUS_TYPE_STRING, &key);
+
+  return signal;
+}
+
+static void
+mock_signal_send (MockConnman *mock, DBusMessage *signal)
+{
+  dbus_connection_send (mock->bus, signal, NULL);
+  dbus_message_unref (signal);
+}
+
+static void
+mock_emit (MockConnman *mock, const char *path, const char *interface,
+           const char *key, int type, const void *value)
+{
+  DBusMessageIter iter;
+  DBusMessage *signal = mock_signal_new (path, interface, key, &iter);
+
+  mock_append_variant (&iter, type, value);
+  mock_signal_send (mock, signal);
+}
+
+/* Consumes items */
+static void
+mock_emit_list (MockConnman *mock, const char *path, const char *interface,
+                const char *key, int type, GPtrArray *items)
+{
+  DBusMessageIter iter;
+  DBusMessage *signal = mock_signal_new (path, interface, key, &iter);
+
+  mock_append_variant_list (&iter, type, items);
+  mock_signal_send (mock, signal);
+  mock_list_free (items);
+}
+
+static void
+mock_emit_services (MockConnman *mock)
+{
+  mock_emit_list (mock, "/", MOCK_INTERFACE ("Manager"), "Services",
+                  DBUS_TYPE_OBJECT_PATH,
+                  mock_paths (mock, MOCK_SERVICE_PREFIX, mock->n_services));
+}
+
+static void
+mock_emit_networks (MockConnman *mock)
+{
+  mock_emit_list (mock, MOCK_CONNMAN_DEVICE_PATH, MOCK_INTERFACE ("Device"),
+                  "Networks", DBUS_TYPE_OBJECT_PATH,
+                  mock_paths (mock, MOCK_NETWORK_PREFIX, mock->n_networks));
+}
+
+static void
+mock_emit_connection (MockConnman *mock, const gchar *service)
+{
+  const char *state = mock_manager_state (mock);
+  const char *service_state = mock_service_state (mock, service);
+  gboolean connected = mock->connected != NULL;
+
+  mock_emit (mock, service, MOCK_INTERFACE ("Service"), "State",
+             DBUS_TYPE_STRING, &service_state);
+  mock_emit (mock, "/", MOCK_INTERFACE ("Manager"), "State",
+             DBUS_TYPE_STRING, &state);
+  mock_emit_list (mock, "/", MOCK_INTERFACE ("Manager"), "Connections",
+                  DBUS_TYPE_OBJECT_PATH,
+                  mock_single (connected, MOCK_CONNMAN_CONNECTION_PATH));
+  mock_emit_list (mock, "/", MOCK_INTERFACE ("Manager"),
+                  "ConnectedTechnologies", DBUS_TYPE_STRING,
+                  mock_single (connected, "wifi"));
+}
+
+static void
+mock_connect (MockConnman *mock, const gchar *service)
+{
+  gchar *previous = mock->connected;
+  const char *idle = "idle";
+
+  if (g_strcmp0 (previous, service) == 0)
+    return;
+
+  mock->connected = g_strdup (service);
+  if (previous)
+    mock_emit (mock, previous, MOCK_INTERFACE ("Service"), "State",
+               DBUS_TYPE_STRING, &idle);
+  mock_emit_connection (mock, service);
+  g_free (previous);
+}
+
+static void
+mock_disconnect (MockConnman *mock, const gchar *service)
+{
+  if (g_strcmp0 (mock->connected, service) != 0)
+    return;
+
+  g_free (mock->connected);
+  mock->connected = NULL;
+  mock_emit_connection (mock, service);
+}
+
+/* Method calls */
+
+static gboolean
+mock_read_property (DBusMessage *message, const char **key,
+                    DBusMessageIter *value)
+{
+  DBusMessageIter iter;
+
+  if (!dbus_message_iter_init (message, &iter) ||
+      dbus_message_iter_get_arg_type (&iter) != DBUS_TYPE_STRING)
+    return FALSE;
+
+  dbus_message_iter_get_basic (&iter, key);
+  if (!dbus_message_iter_next (&iter) ||
+      dbus_message_iter_get_arg_type (&iter) != DBUS_TYPE_VARIANT)
+    return FALSE;
+
+  dbus_message_iter_recurse (&iter, value);
+  return TRUE;
+}
+
+static void
+mock_manager_set_property (MockConnman *mock, DBusMessage *message)
+{
+  DBusMessageIter value;
+  const char *key;
+
+  if (!mock_read_property (message, &key, &value) ||
+      strcmp (key, "OfflineMode") != 0 ||
+      dbus_message_iter_get_arg_type (&value) != DBUS_TYPE_BOOLEAN)
+    return;
+
+  dbus_message_iter_get_basic (&value, &mock->offline_mode);
+  mock_emit (mock, "/", MOCK_INTERFACE ("Manager"), "OfflineMode",
+             DBUS_TYPE_BOOLEAN, &mock->offline_mode);
+}
+
+static void
+mock_set_wifi_enabled (MockConnman *mock, gboolean enabled)
+{
+  if (mock->wifi_enabled == enabled)
+    return;
+
+  mock->wifi_enabled = enabled;
+  mock_emit (mock, MOCK_CONNMAN_DEVICE_PATH, MOCK_INTERFACE ("Device"),
+             "Powered", DBUS_TYPE_BOOLEAN, &mock->wifi_enabled);
+  mock_emit_list (mock, "/", MOCK_INTERFACE ("Manager"),
+                  "EnabledTechnologies", DBUS_TYPE_STRING,
+                  mock_single (enabled, "wifi"));
+}
+
+/* The reply to GetProperties on path */
+static void
+mock_append_properties (MockConnman *mock, const char *path,
+                        DBusMessage *reply)
+{
+  DBusMessageIter iter, dict;
+
+  dbus_message_iter_init_append (reply, &iter);
+  dbus_message_iter_open_container (&iter, DBUS_TYPE_ARRAY, "{sv}", &dict);
+
+  if (!strcmp (path, "/"))
+    mock_manager_properties (mock, &dict);
+  else if (!strcmp (path, MOCK_CONNMAN_DEVICE_PATH))
+    mock_device_properties (mock, &dict);
+  else if (g_str_has_prefix (path, MOCK_NETWORK_PREFIX))
+    mock_network_properties (mock, path, &dict);
+  else if (g_str_has_prefix (path, MOCK_SERVICE_PREFIX))
+    mock_service_properties (mock, path, &dict);
+  else
+    mock_connection_properties (mock, &dict);
+
+  dbus_message_iter_close_container (&iter, &dict);
+}
+
+static gboolean
+mock_known_path (const char *path)
+{
+  return !strcmp (path, "/") ||
+         !strcmp (path, MOCK_CONNMAN_DEVICE_PATH) ||
+         !strcmp (path, MOCK_CONNMAN_CONNECTION_PATH) ||
+         g_str_has_prefix (path, MOCK_NETWORK_PREFIX) ||
+         g_str_has_prefix (path, MOCK_SERVICE_PREFIX);
+}
+
+static DBusHandlerResult
+mock_message_cb (DBusConnection *bus, DBusMessage *message, void *data)
+{
+  MockConnman *mock = data;
+  const char *path = dbus_message_get_path (message);
+  const char *member = dbus_message_get_member (message);
+  DBusMessage *reply;
+
+  if (dbus_message_get_type (message) != DBUS_MESSAGE_TYPE_METHOD_CALL ||
+      !mock_known_path (path))
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+  reply = dbus_message_new_method_return (message);
+
+  /* Anything not handled here succeeds without doing anything */
+  if (!strcmp (member, "GetProperties"))
+  {
+    mock_append_properties (mock, path, reply);
+  }
+  else if (dbus_message_has_interface (message, MOCK_INTERFACE ("Manager")))
+  {
+    if (!strcmp (member, "SetProperty"))
+    {
+      mock_manager_set_property (mock, message);
+    }
+    else if (!strcmp (member, "EnableTechnology") ||
+             !strcmp (member, "DisableTechnology"))
+    {
+      mock_set_wifi_enabled (mock, member[0] == 'E');
+    }
+    else if (!strcmp (member, "ConnectService") && mock->n_services)
+    {
+      gchar *service = mock_connman_service_path (mock, 0);
+
+      dbus_message_append_args (reply, DBUS_TYPE_OBJECT_PATH, &service,
+                                DBUS_TYPE_INVALID);
+      mock_connect (mock, service);
+      g_free (service);
+    }
+  }
+  else if (dbus_message_has_interface (message, MOCK_INTERFACE ("Service")))
+  {
+    if (!strcmp (member, "Connect"))
+      mock_connect (mock, path);
+    else if (!strcmp (member, "Disconnect") || !strcmp (member, "Remove"))
+      mock_disconnect (mock, path);
+  }
+
+  dbus_connection_send (bus, reply, NULL);
+  dbus_message_unref (reply);
+
+  return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+/* Setup */
+
+static gboolean
+mock_bus_start (MockConnman *mock, GError **error)
+{
+  gchar *argv[] = { "dbus-daemon", "--session", "--nofork",
+                    "--print-address=1", NULL };
+  GIOChannel *channel;
+  gint out;
+
+  if (!g_spawn_async_with_pipes (NULL, argv, NULL,
+                                 G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD,
+                                 NULL, NULL, &mock->bus_pid, NULL, &out, NULL,
+                                 error))
+    return FALSE;
+
+  channel = g_io_channel_unix_new (out);
+  g_io_channel_set_close_on_unref (channel, TRUE);
+  if (g_io_channel_read_line (channel, &mock->address, NULL, NULL, error) !=
+      G_IO_STATUS_NORMAL)
+  {
+    if (error && !*error)
+      g_set_error (error, MOCK_CONNMAN_ERROR, 0,
+                   "dbus-daemon exited without an address");
+    g_io_channel_unref (channel);
+    return FALSE;
+  }
+  g_strchomp (mock->address);
+  g_io_channel_unref (channel);
+
+  return TRUE;
+}
+
+static gboolean
+mock_claim_name (MockConnman *mock, GError **error)
+{
+  DBusError dbus_error;
+
+  dbus_error_init (&dbus_error);
+  if (dbus_bus_request_name (mock->bus, MOCK_SERVICE,
+                             DBUS_NAME_FLAG_DO_NOT_QUEUE, &dbus_error) ==
+      DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER)
+    return TRUE;
+
+  g_set_error (error, MOCK_CONNMAN_ERROR, 0, "Unable to own %s: %s",
+               MOCK_SERVICE,
+               dbus_error_is_set (&dbus_error) ? dbus_error.message : "taken");
+  dbus_error_free (&dbus_error);
+  return FALSE;
+}
+
+/*
+ * Start a bus and the fake daemon on it, with no services or networks.
+ * Fails if dbus-daemon cannot be run.
+ */
+MockConnman *
+mock_connman_new (GError **error)
+{
+  static const DBusObjectPathVTable vtable = { NULL, mock_message_cb };
+  MockConnman *mock = g_new0 (MockConnman, 1);
+  DBusError dbus_error;
+
+  mock->wifi_enabled = TRUE;
+
+  if (!mock_bus_start (mock, error))
+    goto fail;
+
+  dbus_error_init (&dbus_error);
+  mock->bus = dbus_connection_open_private (mock->address, &dbus_error);
+  if (!mock->bus || !dbus_bus_register (mock->bus, &dbus_error))
+  {
+    g_set_error (error, MOCK_CONNMAN_ERROR, 0,
+                 "Unable to connect to %s: %s", mock->address,
+                 dbus_error.message);
+    dbus_error_free (&dbus_error);
+    goto fail;
+  }
+
+  if (!mock_claim_name (mock, error))
+    goto fail;
+
+  dbus_connection_register_fallback (mock->bus, "/", &vtable, mock);
+  dbus_connection_setup_with_g_main (mock->bus, NULL);
+
+  return mock;
+
+ fail:
+  mock_connman_free (mock);
+  return NULL;
+}
+
+void
+mock_connman_free (MockConnman *mock)
+{
+  if (mock->bus)
+  {
+    dbus_connection_close (mock->bus);
+    dbus_connection_unref (mock->bus);
+  }
+
+  if (mock->bus_pid)
+  {
+    kill (mock->bus_pid, SIGTERM);
+    waitpid (mock->bus_pid, NULL, 0);
+    g_spawn_close_pid (mock->bus_pid);
+  }
+
+  g_free (mock->connected);
+  g_free (mock->address);
+  g_free (mock);
+}
+
+const gchar *
+mock_connman_get_address (MockConnman *mock)
+{
+  return mock->address;
+}
+
+/* Scenarios */
+
+void
+mock_connman_set_pool (MockConnman *mock, guint pool)
+{
+  mock->pool = pool;
+  mock_emit_services (mock);
+  mock_emit_networks (mock);
+}
+
+void
+mock_connman_set_services (MockConnman *mock, guint n_services)
+{
+  mock->n_services = n_services;
+  mock_emit_services (mock);
+}
+
+void
+mock_connman_set_networks (MockConnman *mock, guint n_networks)
+{
+  mock->n_networks = n_networks;
+  mock_emit_networks (mock);
+}
+
+/* Move both windows along by "by" objects */
+void
+mock_connman_rotate (MockConnman *mock, guint by)
+{
+  mock->offset += by;
+  mock_emit_services (mock);
+  mock_emit_networks (mock);
+}
+
+/* Change the Strength of every network and service, rounds times over */
+void
+mock_connman_strength_storm (MockConnman *mock, guint rounds)
+{
+  GPtrArray *services, *networks;
+  guchar strength;
+  guint round, i;
+
+  services = mock_paths (mock, MOCK_SERVICE_PREFIX, mock->n_services);
+  networks = mock_paths (mock, MOCK_NETWORK_PREFIX, mock->n_networks);
+
+  for (round = 0; round < rounds; round++)
+  {
+    mock->strength_seq++;
+
+    for (i = 0; i < networks->len; i++)
+    {
+      strength = mock_strength (mock, networks->pdata[i]);
+      mock_emit (mock, networks->pdata[i], MOCK_INTERFACE ("Network"),
+                 "Strength", DBUS_TYPE_BYTE, &strength);
+    }
+
+    for (i = 0; i < services->len; i++)
+    {
+      strength = mock_strength (mock, services->pdata[i]);
+      mock_emit (mock, services->pdata[i], MOCK_INTERFACE ("Service"),
+                 "Strength", DBUS_TYPE_BYTE, &strength);
+    }
+
+    dbus_connection_flush (mock->bus);
+  }
+
+  mock_list_free (services);
+  mock_list_free (networks);
+}
+
+/* Drop off the bus name and take it again, as a daemon restart would */
+void
+mock_connman_restart (MockConnman *mock)
+{
+  DBusError dbus_error;
+
+  dbus_error_init (&dbus_error);
+  dbus_bus_release_name (mock->bus, MOCK_SERVICE, &dbus_error);
+  if (dbus_error_is_set (&dbus_error))
+  {
+    g_warning ("Unable to release %s: %s", MOCK_SERVICE, dbus_error.message);
+    dbus_error_free (&dbus_error);
+  }
+
+  g_free (mock->connected);
+  mock->connected = NULL;
+
+  if (!mock_claim_name (mock, NULL))
+    g_warning ("Unable to own %s again", MOCK_SERVICE);
+}
+
+void
+mock_connman_flush (MockConnman *mock)
+{
+  dbus_connection_flush (mock->bus);
+}
@@ -0,0 +1,47 @@
+/*
+ * A fake ConnMan daemon on a private bus, for tests and benchmarks.
+ *
+ * mock_connman_new() starts a dbus-daemon of its own and claims
+ * org.moblin.connman on it.  The fake exports the Manager, one wifi
+ * Device with its Networks, the Services and, once a service has been
+ * connected, a Connection.  Point a manager at it with
+ * cm_manager_new_for_address() and mock_connman_get_address().
+ *
+ * Services and networks are numbered; the i-th visible one is
+ * (offset + i) % pool, so rotating the window removes, adds and reorders
+ * objects, and a pool the size of the window only reorders them.  The
+ * fake answers from the GLib main loop, so the test must iterate it.
+ */
+#ifndef __mock_connman_h__
+#define __mock_connman_h__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define MOCK_CONNMAN_DEVICE_PATH     "/device/mock_wifi"
+#define MOCK_CONNMAN_CONNECTION_PATH "/connection/mock_wifi"
+
+typedef struct _MockConnman MockConnman;
+
+MockConnman *mock_connman_new (GError **error);
+void mock_connman_free (MockConnman *mock);
+const gchar *mock_connman_get_address (MockConnman *mock);
+
+/* Object paths, numbered as the i-th visible service or network */
+gchar *mock_connman_service_path (MockConnman *mock, guint i);
+gchar *mock_connman_network_path (MockConnman *mock, guint i);
+
+/* Each of these signals the change, as ConnMan would */
+void mock_connman_set_pool (MockConnman *mock, guint pool);
+void mock_connman_set_services (MockConnman *mock, guint n_services);
+void mock_connman_set_networks (MockConnman *mock, guint n_networks);
+void mock_connman_rotate (MockConnman *mock, guint by);
+void mock_connman_strength_storm (MockConnman *mock, guint rounds);
+void mock_connman_restart (MockConnman *mock);
+
+void mock_connman_flush (MockConnman *mock);
+
+G_END_DECLS
+
+#endif /* __mock_connman_h__ */
@@ -0,0 +1,146 @@
+/*
+ * Run the fake ConnMan from mock-connman.c as a standalone daemon.
+ *
+ * Prints the private bus address as a DBUS_SYSTEM_BUS_ADDRESS assignment
+ * on its first line of output and then takes commands, one per line, on
+ * stdin:
+ *
+ *   services N     show N services
+ *   networks N     show N networks on the wifi device
+ *   pool N         wrap object numbers after N (0 never wraps)
+ *   rotate N       move the services and networks along by N
+ *   storm N        change every Strength, N times over
+ *   restart        drop the bus name and take it again
+ *   quit           exit, as does the end of input
+ *
+ * Point test-manager or test-service at it by passing them the address.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include "mock-connman.h"
+
+static gint n_services = 0;
+static gint n_networks = 0;
+static gint pool = 0;
+
+static GOptionEntry entries[] =
+{
+  { "services", 's', 0, G_OPTION_ARG_INT, &n_services,
+    "Number of services to start with", "N" },
+  { "networks", 'n', 0, G_OPTION_ARG_INT, &n_networks,
+    "Number of networks to start with", "N" },
+  { "pool", 'p', 0, G_OPTION_ARG_INT, &pool,
+    "Wrap object numbers after N", "N" },
+  { NULL }
+};
+
+typedef struct
+{
+  MockConnman *mock;
+  GMainLoop *loop;
+} Daemon;
+
+static gboolean
+run_command (Daemon *daemon, const gchar *line)
+{
+  gchar **argv = g_strsplit_set (line, " \t", 2);
+  guint n = argv[0] && argv[1] ? strtoul (argv[1], NULL, 10) : 0;
+  gboolean ok = TRUE;
+
+  if (!argv[0] || !*argv[0])
+    ;
+  else if (!strcmp (argv[0], "services"))
+    mock_connman_set_services (daemon->mock, n);
+  else if (!strcmp (argv[0], "networks"))
+    mock_connman_set_networks (daemon->mock, n);
+  else if (!strcmp (argv[0], "pool"))
+    mock_connman_set_pool (daemon->mock, n);
+  else if (!strcmp (argv[0], "rotate"))
+    mock_connman_rotate (daemon->mock, n);
+  else if (!strcmp (argv[0], "storm"))
+    mock_connman_strength_storm (daemon->mock, n);
+  else if (!strcmp (argv[0], "restart"))
+    mock_connman_restart (daemon->mock);
+  else if (!strcmp (argv[0], "quit"))
+    ok = FALSE;
+  else
+    g_printerr ("Unknown command: %s\n", argv[0]);
+
+  mock_connman_flush (daemon->mock);
+  g_strfreev (argv);
+
+  return ok;
+}
+
+static gboolean
+stdin_cb (GIOChannel *channel, GIOCondition condition, gpointer data)
+{
+  Daemon *daemon = data;
+  gchar *line = NULL;
+  gboolean ok;
+
+  if (g_io_channel_read_line (channel, &line, NULL, NULL, NULL) !=
+      G_IO_STATUS_NORMAL)
+  {
+    g_main_loop_quit (daemon->loop);
+    return FALSE;
+  }
+
+  ok = run_command (daemon, g_strstrip (line));
+  g_free (line);
+
+  if (!ok)
+    g_main_loop_quit (daemon->loop);
+
+  return ok;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  GOptionContext *context;
+  GIOChannel *channel;
+  GError *error = NULL;
+  Daemon daemon;
+
+  context = g_option_context_new ("- fake ConnMan on a private bus");
+  g_option_context_add_main_entries (context, entries, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+  {
+    g_printerr ("%s\n", error->message);
+    return 1;
+  }
+  g_option_context_free (context);
+
+  daemon.mock = mock_connman_new (&error);
+  if (!daemon.mock)
+  {
+    g_printerr ("Unable to start: %s\n", error->message);
+    g_error_free (error);
+    return 1;
+  }
+
+  mock_connman_set_pool (daemon.mock, pool);
+  mock_connman_set_services (daemon.mock, n_services);
+  mock_connman_set_networks (daemon.mock, n_networks);
+
+  g_print ("DBUS_SYSTEM_BUS_ADDRESS='%s'\n",
+           mock_connman_get_address (daemon.mock));
+  fflush (stdout);
+
+  daemon.loop = g_main_loop_new (NULL, FALSE);
+  channel = g_io_channel_unix_new (0);
+  g_io_add_watch (channel, G_IO_IN | G_IO_HUP, stdin_cb, &daemon);
+
+  g_main_loop_run (daemon.loop);
+
+  g_io_channel_unref (channel);
+  g_main_loop_unref (daemon.loop);
+  mock_connman_free (daemon.mock);
+
+  return 0;
+}
@@ -0,0 +1,322 @@
+/*
+ * Reconcile and delta signal test.
+ *
+ * Runs the fake ConnMan from mock-connman.c and checks what a low-level
+ * CmManager reports as its service list is reordered, shrunk and grown:
+ * the services-delta lists, the resulting order, and that services which
+ * stay listed keep their objects.  Then toggles wifi and checks the
+ * enabled-technologies-delta masks.
+ *
+ * Exits 77 (skipped) when no dbus-daemon is available.
+ */
+#include <string.h>
+#include <glib-object.h>
+#include <glib.h>
+#include <gconnman/gconnman.h>
+
+#include "mock-connman.h"
+
+#define POOL_SIZE   8
+#define ROTATE_BY   3
+#define SHRINK_TO   6
+
+static MockConnman *mock = NULL;
+static CmManager *manager = NULL;
+
+/* What the last services-delta carried, as paths */
+static guint services_deltas = 0;
+static GPtrArray *added = NULL;
+static GPtrArray *removed = NULL;
+static GPtrArray *moved = NULL;
+
+/* What the last enabled-technologies-delta carried */
+static guint technology_deltas = 0;
+static guint technologies_added = 0;
+static guint technologies_removed = 0;
+
+static void
+paths_set (GPtrArray *paths, GList *services)
+{
+  g_ptr_array_foreach (paths, (GFunc) g_free, NULL);
+  g_ptr_array_set_size (paths, 0);
+
+  for (; services; services = services->next)
+    g_ptr_array_add (paths, g_strdup (cm_service_get_path (services->data)));
+}
+
+static void
+services_delta_cb (CmManager *manager,
+                   GList     *added_services,
+                   GList     *removed_services,
+                   GList     *moved_services,
+                   gpointer   user_data)
+{
+  services_deltas++;
+  paths_set (added, added_services);
+  paths_set (removed, removed_services);
+  paths_set (moved, moved_services);
+}
+
+static void
+enabled_technologies_delta_cb (CmManager *manager,
+                               guint      added_mask,
+                               guint      removed_mask,
+                               gpointer   user_data)
+{
+  technology_deltas++;
+  technologies_added = added_mask;
+  technologies_removed = removed_mask;
+}
+
+static gboolean timed_out = FALSE;
+
+static gboolean
+timeout_cb (gpointer data)
+{
+  timed_out = TRUE;
+  return FALSE;
+}
+
+static gboolean
+wait_until (gboolean (*done) (void), const gchar *what)
+{
+  guint timeout;
+
+  timed_out = FALSE;
+  timeout = g_timeout_add (10000, timeout_cb, NULL);
+
+  while (!done () && !timed_out)
+    g_main_context_iteration (NULL, TRUE);
+
+  if (timed_out)
+  {
+    g_printerr ("Timed out waiting for %s\n", what);
+    return FALSE;
+  }
+  g_source_remove (timeout);
+
+  return TRUE;
+}
+
+static gboolean
+ready (void)
+{
+  return cm_manager_is_ready (manager) &&
+    g_list_length ((GList *) cm_manager_get_services (manager)) == POOL_SIZE;
+}
+
+static gboolean
+services_delta_seen (void)
+{
+  return services_deltas > 0;
+}
+
+static gboolean
+technology_delta_seen (void)
+{
+  return technology_deltas > 0;
+}
+
+/* paths holds exactly the mock's first..last visible services, in order */
+static gboolean
+paths_are (GPtrArray *paths, guint first, guint last, const gchar *what)
+{
+  gchar *expected;
+  gboolean ok = TRUE;
+  guint i;
+
+  if (paths->len != last - first)
+  {
+    g_printerr ("%u services %s, expected %u\n", paths->len, what,
+                last - first);
+    return FALSE;
+  }
+
+  for (i = first; ok && i < last; i++)
+  {
+    expected = mock_connman_service_path (mock, i);
+    ok = !strcmp (g_ptr_array_index (paths, i - first), expected);
+    if (!ok)
+      g_printerr ("Service %s is %s, expected %s\n", what,
+                  (gchar *) g_ptr_array_index (paths, i - first), expected);
+    g_free (expected);
+  }
+
+  return ok;
+}
+
+/* The manager lists the mock's first n services, in the mock's order */
+static gboolean
+services_in_order (guint n)
+{
+  GPtrArray *paths = g_ptr_array_new ();
+  gboolean ok;
+
+  paths_set (paths, (GList *) cm_manager_get_services (manager));
+  ok = paths_are (paths, 0, n, "listed");
+
+  g_ptr_array_foreach (paths, (GFunc) g_free, NULL);
+  g_ptr_array_free (paths, TRUE);
+
+  return ok;
+}
+
+/* Every service in before is still listed as the same object */
+static gboolean
+services_kept (GHashTable *before)
+{
+  const GList *iter;
+  CmService *service;
+
+  for (iter = cm_manager_get_services (manager); iter; iter = iter->next)
+  {
+    service = g_hash_table_lookup (before, cm_service_get_path (iter->data));
+    if (service && service != iter->data)
+    {
+      g_printerr ("Service %s was replaced\n",
+                  cm_service_get_path (iter->data));
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+static gboolean
+test_services (void)
+{
+  GHashTable *before;
+  const GList *iter;
+  gboolean ok;
+
+  before = g_hash_table_new (g_str_hash, g_str_equal);
+  for (iter = cm_manager_get_services (manager); iter; iter = iter->next)
+    g_hash_table_insert (before, (gpointer) cm_service_get_path (iter->data),
+                         iter->data);
+
+  /* The whole pool is listed, so rotating only reorders it */
+  services_deltas = 0;
+  mock_connman_rotate (mock, ROTATE_BY);
+  ok = wait_until (services_delta_seen, "the rotation") &&
+    paths_are (added, 0, 0, "added") &&
+    paths_are (removed, 0, 0, "removed") &&
+    paths_are (moved, POOL_SIZE - ROTATE_BY, POOL_SIZE, "moved") &&
+    services_in_order (POOL_SIZE) &&
+    services_kept (before);
+  g_hash_table_destroy (before);
+  if (!ok)
+    return FALSE;
+
+  services_deltas = 0;
+  mock_connman_set_services (mock, SHRINK_TO);
+  if (!wait_until (services_delta_seen, "the shrink") ||
+      !paths_are (added, 0, 0, "added") ||
+      !paths_are (removed, SHRINK_TO, POOL_SIZE, "removed") ||
+      !paths_are (moved, 0, 0, "moved") ||
+      !services_in_order (SHRINK_TO))
+    return FALSE;
+
+  services_deltas = 0;
+  mock_connman_set_services (mock, POOL_SIZE);
+  if (!wait_until (services_delta_seen, "the growth") ||
+      !paths_are (added, SHRINK_TO, POOL_SIZE, "added") ||
+      !paths_are (removed, 0, 0, "removed") ||
+      !paths_are (moved, 0, 0, "moved") ||
+      !services_in_order (POOL_SIZE))
+    return FALSE;
+
+  return TRUE;
+}
+
+static gboolean
+technology_toggled (gboolean enable)
+{
+  guint wifi = CM_TECHNOLOGY_BIT (DEVICE_WIFI);
+
+  technology_deltas = 0;
+  if (enable)
+    cm_manager_enable_technology (manager, "wifi");
+  else
+    cm_manager_disable_technology (manager, "wifi");
+
+  if (!wait_until (technology_delta_seen, "wifi to toggle"))
+    return FALSE;
+
+  if (technologies_added != (enable ? wifi : 0) ||
+      technologies_removed != (enable ? 0 : wifi) ||
+      cm_manager_is_technology_enabled (manager, DEVICE_WIFI) != enable)
+  {
+    g_printerr ("%s wifi gave added 0x%x, removed 0x%x\n",
+                enable ? "Enabling" : "Disabling",
+                technologies_added, technologies_removed);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+test_technologies (void)
+{
+  if (!cm_manager_is_technology_enabled (manager, DEVICE_WIFI))
+  {
+    g_printerr ("Wifi is not enabled to begin with\n");
+    return FALSE;
+  }
+
+  return technology_toggled (FALSE) && technology_toggled (TRUE);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  GError *error = NULL;
+  int ret = 1;
+
+  g_type_init ();
+
+  mock = mock_connman_new (&error);
+  if (!mock)
+  {
+    g_print ("Skipping, no fake ConnMan: %s\n", error->message);
+    g_clear_error (&error);
+    return 77;
+  }
+  mock_connman_set_pool (mock, POOL_SIZE);
+  mock_connman_set_services (mock, POOL_SIZE);
+
+  added = g_ptr_array_new ();
+  removed = g_ptr_array_new ();
+  moved = g_ptr_array_new ();
+
+  manager = cm_manager_new_for_address (&error, MANAGER_FLAG_LOW_LEVEL,
+                                        mock_connman_get_address (mock));
+  if (!manager)
+  {
+    g_printerr ("Error initialising manager: %s\n", error->message);
+    g_clear_error (&error);
+    goto out;
+  }
+  g_signal_connect (manager, "services-delta",
+                    G_CALLBACK (services_delta_cb), NULL);
+  g_signal_connect (manager, "enabled-technologies-delta",
+                    G_CALLBACK (enabled_technologies_delta_cb), NULL);
+  cm_manager_refresh (manager);
+
+  if (!wait_until (ready, "the manager") || !services_in_order (POOL_SIZE))
+    goto out;
+
+  if (!test_services () || !test_technologies ())
+    goto out;
+
+  g_print ("Service and technology deltas passed\n");
+  ret = 0;
+
+ out:
+  if (manager)
+    g_object_unref (manager);
+  mock_connman_free (mock);
+
+  return ret;
+}
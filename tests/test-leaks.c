@@ -0,0 +1,255 @@
+/*
+ * Leak regression test.
+ *
+ * Runs the fake ConnMan from mock-connman.c and churns a few thousand
+ * services and networks through a low-level CmManager, checking that
+ * every object the manager drops is finalized and that the heap does
+ * not grow once warmed up.
+ *
+ * Exits 77 (skipped) when no dbus-daemon is available, or when the heap
+ * cannot be measured.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#if defined (HAVE_MALLINFO2) || defined (HAVE_MALLINFO)
+#include <malloc.h>
+#endif
+#include <glib-object.h>
+#include <glib.h>
+#include <gconnman/gconnman.h>
+
+#include "mock-connman.h"
+
+#define POOL_SIZE      64  /* distinct paths, so interned paths stay bounded */
+#define ACTIVE_SIZE    32
+#define ROTATE_BY      8
+#define WARMUP_ROUNDS  16
+#define CHURN_ROUNDS   256
+#define HEAP_SLACK     (64 * 1024)
+
+/*
+ * Heap accounting
+ *
+ * The bytes malloc has handed out and not had back, which covers GLib,
+ * libdbus and the mock alike; G_SLICE=always-malloc routes slices
+ * through malloc too.  Without mallinfo2() or mallinfo() only the object
+ * checks run, and the test reports itself skipped rather than passed.
+ */
+static gboolean
+heap_live (gsize *live)
+{
+#if defined (HAVE_MALLINFO2)
+  struct mallinfo2 info = mallinfo2 ();
+
+  *live = info.uordblks;
+  return TRUE;
+#elif defined (HAVE_MALLINFO)
+  struct mallinfo info = mallinfo ();
+
+  *live = (guint) info.uordblks;
+  return TRUE;
+#else
+  *live = 0;
+  return FALSE;
+#endif
+}
+
+/*
+ * Live object accounting, by weak references on every service and
+ * network the manager hands out
+ */
+static GHashTable *tracked = NULL;
+
+static void
+object_finalized_cb (gpointer data, GObject *where_the_object_was)
+{
+  g_hash_table_remove (tracked, where_the_object_was);
+}
+
+static void
+track (gpointer object)
+{
+  if (g_hash_table_lookup (tracked, object))
+    return;
+
+  g_hash_table_insert (tracked, object, object);
+  g_object_weak_ref (object, object_finalized_cb, NULL);
+}
+
+static gboolean timed_out = FALSE;
+
+static gboolean
+timeout_cb (gpointer data)
+{
+  timed_out = TRUE;
+  return FALSE;
+}
+
+/* The manager has caught up with the mock's current window */
+static gboolean
+settled (MockConnman *mock, CmManager *manager, CmDevice **device)
+{
+  const GList *services, *networks, *iter;
+  gchar *first;
+  gboolean ok;
+
+  *device = cm_manager_find_device (manager, MOCK_CONNMAN_DEVICE_PATH);
+  if (!cm_manager_is_ready (manager) || !*device)
+    return FALSE;
+
+  services = cm_manager_get_services (manager);
+  networks = cm_device_get_networks (*device);
+  if (g_list_length ((GList *) services) != ACTIVE_SIZE ||
+      g_list_length ((GList *) networks) != ACTIVE_SIZE)
+    return FALSE;
+
+  for (iter = services; iter; iter = iter->next)
+    if (!cm_service_get_name (iter->data))
+      return FALSE;
+  for (iter = networks; iter; iter = iter->next)
+    if (!cm_network_get_name (iter->data))
+      return FALSE;
+
+  first = mock_connman_service_path (mock, 0);
+  ok = !strcmp (cm_service_get_path (services->data), first);
+  g_free (first);
+  if (!ok)
+    return FALSE;
+
+  first = mock_connman_network_path (mock, 0);
+  ok = !strcmp (cm_network_get_path (networks->data), first);
+  g_free (first);
+
+  return ok;
+}
+
+static gboolean
+wait_for_round (MockConnman *mock, CmManager *manager, guint round)
+{
+  CmDevice *device = NULL;
+  const GList *iter;
+  guint timeout;
+
+  timed_out = FALSE;
+  timeout = g_timeout_add (10000, timeout_cb, NULL);
+
+  while (!settled (mock, manager, &device) && !timed_out)
+    g_main_context_iteration (NULL, TRUE);
+
+  if (timed_out)
+  {
+    g_printerr ("Timed out waiting for round %u\n", round);
+    return FALSE;
+  }
+  g_source_remove (timeout);
+
+  for (iter = cm_manager_get_services (manager); iter; iter = iter->next)
+    track (iter->data);
+  for (iter = cm_device_get_networks (device); iter; iter = iter->next)
+    track (iter->data);
+
+  if (g_hash_table_size (tracked) != 2 * ACTIVE_SIZE)
+  {
+    g_printerr ("%u live services and networks, expected %u\n",
+                g_hash_table_size (tracked), 2 * ACTIVE_SIZE);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  MockConnman *mock;
+  CmManager *manager;
+  GError *error = NULL;
+  gboolean heap_counted;
+  gsize heap_warm = 0, heap_now = 0;
+  guint round;
+  int ret = 1;
+
+  /* Before GLib first reads it */
+  setenv ("G_SLICE", "always-malloc", TRUE);
+  heap_counted = heap_live (&heap_now);
+
+  g_type_init ();
+
+  mock = mock_connman_new (&error);
+  if (!mock)
+  {
+    g_print ("Skipping, no fake ConnMan: %s\n", error->message);
+    g_clear_error (&error);
+    return 77;
+  }
+  mock_connman_set_pool (mock, POOL_SIZE);
+  mock_connman_set_services (mock, ACTIVE_SIZE);
+  mock_connman_set_networks (mock, ACTIVE_SIZE);
+
+  tracked = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  manager = cm_manager_new_for_address (&error, MANAGER_FLAG_LOW_LEVEL,
+                                        mock_connman_get_address (mock));
+  if (!manager)
+  {
+    g_printerr ("Error initialising manager: %s\n", error->message);
+    g_clear_error (&error);
+    goto out;
+  }
+  cm_manager_refresh (manager);
+
+  for (round = 0; round < WARMUP_ROUNDS + CHURN_ROUNDS; round++)
+  {
+    if (round)
+      mock_connman_rotate (mock, ROTATE_BY);
+
+    if (!wait_for_round (mock, manager, round))
+      goto out;
+
+    if (round == WARMUP_ROUNDS)
+      heap_live (&heap_warm);
+  }
+
+  g_print ("Churned %u services and %u networks\n",
+           CHURN_ROUNDS * ROTATE_BY, CHURN_ROUNDS * ROTATE_BY);
+
+  if (heap_counted)
+  {
+    heap_live (&heap_now);
+    g_print ("Heap: %" G_GSIZE_FORMAT " bytes after warm-up, %"
+             G_GSIZE_FORMAT " after churn\n", heap_warm, heap_now);
+    if (heap_now > heap_warm + HEAP_SLACK)
+    {
+      g_printerr ("Heap grew by %" G_GSIZE_FORMAT " bytes\n",
+                  heap_now - heap_warm);
+      goto out;
+    }
+  }
+
+  g_object_unref (manager);
+  if (g_hash_table_size (tracked) != 0)
+  {
+    g_printerr ("%u services and networks outlived their manager\n",
+                g_hash_table_size (tracked));
+    goto out;
+  }
+
+  if (heap_counted)
+    ret = 0;
+  else
+  {
+    g_printerr ("SKIP: no mallinfo2() or mallinfo(), the heap was not "
+                "checked\n");
+    ret = 77;
+  }
+
+ out:
+  mock_connman_free (mock);
+
+  return ret;
+}
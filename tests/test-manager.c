@@ -28,7 +28,8 @@ main (int    argc,
 
   g_type_init ();
 
-  manager = cm_manager_new (&error, FALSE);
+  /* An optional bus address, e.g. one printed by mock-connmand */
+  manager = cm_manager_new_for_address (&error, 0, argc > 1 ? argv[1] : NULL);
   if (error)
   {
     g_debug ("Error initialising manager: %s\n",
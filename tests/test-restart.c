@@ -0,0 +1,225 @@
+/*
+ * Owner restart test.
+ *
+ * Runs the fake ConnMan from mock-connman.c under a low-level CmManager
+ * with incremental refresh on, then has the fake drop its bus name and
+ * take it again, as a daemon restart would.  The manager must notice
+ * both through NameOwnerChanged, go unavailable and become ready again,
+ * and still hold the very same device, service and network objects.
+ *
+ * Exits 77 (skipped) when no dbus-daemon is available.
+ */
+#include <string.h>
+#include <glib-object.h>
+#include <glib.h>
+#include <gconnman/gconnman.h>
+
+#include "mock-connman.h"
+
+#define POOL_SIZE 8
+
+static MockConnman *mock = NULL;
+static CmManager *manager = NULL;
+
+static guint unavailable = 0;
+static guint readies = 0;
+static guint finalized = 0;
+
+static void
+state_changed_cb (CmManager *manager, gpointer user_data)
+{
+  if (!g_strcmp0 (cm_manager_get_state (manager), "unavailable"))
+    unavailable++;
+}
+
+static void
+ready_cb (CmManager *manager, gpointer user_data)
+{
+  readies++;
+}
+
+static void
+object_finalized_cb (gpointer data, GObject *where_the_object_was)
+{
+  finalized++;
+}
+
+static gboolean timed_out = FALSE;
+
+static gboolean
+timeout_cb (gpointer data)
+{
+  timed_out = TRUE;
+  return FALSE;
+}
+
+/* The manager has caught up with the mock */
+static gboolean
+settled (void)
+{
+  CmDevice *device;
+  const GList *iter;
+
+  device = cm_manager_find_device (manager, MOCK_CONNMAN_DEVICE_PATH);
+  if (!cm_manager_is_ready (manager) || !device)
+    return FALSE;
+
+  if (g_list_length ((GList *) cm_manager_get_services (manager)) !=
+      POOL_SIZE ||
+      g_list_length ((GList *) cm_device_get_networks (device)) != POOL_SIZE)
+    return FALSE;
+
+  for (iter = cm_manager_get_services (manager); iter; iter = iter->next)
+    if (!cm_service_get_name (iter->data))
+      return FALSE;
+
+  return TRUE;
+}
+
+static gboolean
+restarted (void)
+{
+  return unavailable > 0 && readies > 0 && settled ();
+}
+
+static gboolean
+wait_until (gboolean (*done) (void), const gchar *what)
+{
+  guint timeout;
+
+  timed_out = FALSE;
+  timeout = g_timeout_add (10000, timeout_cb, NULL);
+
+  while (!done () && !timed_out)
+    g_main_context_iteration (NULL, TRUE);
+
+  if (timed_out)
+  {
+    g_printerr ("Timed out waiting for %s\n", what);
+    return FALSE;
+  }
+  g_source_remove (timeout);
+
+  return TRUE;
+}
+
+/* Every object the manager hands out, in order, watched for finalization */
+static GPtrArray *
+objects_get (void)
+{
+  GPtrArray *objects = g_ptr_array_new ();
+  CmDevice *device;
+  const GList *iter;
+
+  device = cm_manager_find_device (manager, MOCK_CONNMAN_DEVICE_PATH);
+  g_ptr_array_add (objects, device);
+  for (iter = cm_manager_get_services (manager); iter; iter = iter->next)
+    g_ptr_array_add (objects, iter->data);
+  for (iter = cm_device_get_networks (device); iter; iter = iter->next)
+    g_ptr_array_add (objects, iter->data);
+
+  return objects;
+}
+
+static gboolean
+objects_same (GPtrArray *before, GPtrArray *after)
+{
+  guint i;
+
+  if (before->len != after->len)
+  {
+    g_printerr ("%u objects after the restart, expected %u\n",
+                after->len, before->len);
+    return FALSE;
+  }
+
+  for (i = 0; i < before->len; i++)
+  {
+    if (g_ptr_array_index (before, i) != g_ptr_array_index (after, i))
+    {
+      g_printerr ("Object %u was replaced across the restart\n", i);
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  GPtrArray *before = NULL, *after = NULL;
+  GError *error = NULL;
+  guint i;
+  int ret = 1;
+
+  g_type_init ();
+
+  mock = mock_connman_new (&error);
+  if (!mock)
+  {
+    g_print ("Skipping, no fake ConnMan: %s\n", error->message);
+    g_clear_error (&error);
+    return 77;
+  }
+  mock_connman_set_pool (mock, POOL_SIZE);
+  mock_connman_set_services (mock, POOL_SIZE);
+  mock_connman_set_networks (mock, POOL_SIZE);
+
+  manager = cm_manager_new_for_address (&error, MANAGER_FLAG_LOW_LEVEL,
+                                        mock_connman_get_address (mock));
+  if (!manager)
+  {
+    g_printerr ("Error initialising manager: %s\n", error->message);
+    g_clear_error (&error);
+    goto out;
+  }
+  cm_manager_set_incremental_refresh (manager, TRUE);
+  g_signal_connect (manager, "state-changed",
+                    G_CALLBACK (state_changed_cb), NULL);
+  g_signal_connect (manager, "manager-ready", G_CALLBACK (ready_cb), NULL);
+  cm_manager_refresh (manager);
+
+  if (!wait_until (settled, "the manager"))
+    goto out;
+
+  before = objects_get ();
+  for (i = 0; i < before->len; i++)
+    g_object_weak_ref (g_ptr_array_index (before, i), object_finalized_cb,
+                       NULL);
+
+  unavailable = 0;
+  readies = 0;
+  mock_connman_restart (mock);
+  if (!wait_until (restarted, "ConnMan to come back"))
+    goto out;
+
+  after = objects_get ();
+  if (!objects_same (before, after))
+    goto out;
+  if (finalized)
+  {
+    g_printerr ("%u objects were finalized across the restart\n", finalized);
+    goto out;
+  }
+
+  g_print ("Kept %u objects across a ConnMan restart\n", before->len);
+  ret = 0;
+
+ out:
+  if (before)
+  {
+    for (i = 0; !finalized && i < before->len; i++)
+      g_object_weak_unref (g_ptr_array_index (before, i),
+                           object_finalized_cb, NULL);
+    g_ptr_array_free (before, TRUE);
+  }
+  if (after)
+    g_ptr_array_free (after, TRUE);
+  if (manager)
+    g_object_unref (manager);
+  mock_connman_free (mock);
+
+  return ret;
+}
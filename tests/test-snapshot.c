@@ -0,0 +1,248 @@
+/*
+ * Snapshot encoding test.
+ *
+ * Round-trips a record holding one value of every type a snapshot can
+ * store, then feeds the decoder every truncation of the encoding and a
+ * few corrupted copies, all of which must be rejected.  Needs no bus.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <glib-object.h>
+#include <glib.h>
+
+#include "gconnman-internal.h"
+
+#define TEST_PATH "/service/test"
+
+static gboolean failed = FALSE;
+
+static void
+check (gboolean ok, const gchar *what)
+{
+  if (!ok)
+  {
+    g_printerr ("FAIL: %s\n", what);
+    failed = TRUE;
+  }
+}
+
+static GPtrArray *
+records_new (void)
+{
+  GPtrArray *records = g_ptr_array_new ();
+  CmSnapshotRecord *record;
+  GPtrArray *paths;
+  GArray *bytes;
+  gchar *strv[] = { "wifi", "ethernet", NULL };
+
+  record = internal_snapshot_record_new (SNAPSHOT_SERVICE, TEST_PATH);
+
+  g_value_set_string (
+    internal_property_values_add (record->values, "Name", G_TYPE_STRING),
+    "Test");
+  g_value_set_boolean (
+    internal_property_values_add (record->values, "Favorite", G_TYPE_BOOLEAN),
+    TRUE);
+  g_value_set_uchar (
+    internal_property_values_add (record->values, "Strength", G_TYPE_UCHAR),
+    42);
+  g_value_set_uint (
+    internal_property_values_add (record->values, "Frequency", G_TYPE_UINT),
+    2412);
+
+  bytes = g_array_new (FALSE, FALSE, sizeof (guchar));
+  g_array_append_vals (bytes, "\0ssid\xff", 6);
+  g_value_take_boxed (
+    internal_property_values_add (record->values, "WiFi.SSID",
+                                  DBUS_TYPE_G_UCHAR_ARRAY),
+    bytes);
+
+  paths = g_ptr_array_new ();
+  g_ptr_array_add (paths, g_strdup ("/network/a"));
+  g_ptr_array_add (paths, g_strdup ("/network/b"));
+  g_value_take_boxed (
+    internal_property_values_add (record->values, "Networks",
+                                  dbus_g_type_get_collection (
+                                    "GPtrArray", DBUS_TYPE_G_OBJECT_PATH)),
+    paths);
+
+  g_value_set_boxed (
+    internal_property_values_add (record->values, "Technologies",
+                                  G_TYPE_STRV),
+    strv);
+
+  g_ptr_array_add (records, record);
+
+  return records;
+}
+
+static void
+records_free (GPtrArray *records)
+{
+  g_ptr_array_foreach (records, (GFunc) internal_snapshot_record_free, NULL);
+  g_ptr_array_free (records, TRUE);
+}
+
+static const GValue *
+value_get (CmSnapshotRecord *record, const gchar *name, GType type)
+{
+  const GValue *value = g_hash_table_lookup (record->values, name);
+
+  if (!value || G_VALUE_TYPE (value) != type)
+    return NULL;
+
+  return value;
+}
+
+static void
+test_round_trip (const GString *data)
+{
+  GPtrArray *records, *paths;
+  CmSnapshotRecord *record;
+  const GValue *value;
+  GArray *bytes;
+  gchar **strv;
+
+  records = internal_snapshot_decode (data->str, data->len);
+  check (records && records->len == 1, "round trip decodes one record");
+  if (!records || records->len != 1)
+    return;
+
+  record = g_ptr_array_index (records, 0);
+  check (record->kind == SNAPSHOT_SERVICE, "record kind");
+  check (!strcmp (record->path, TEST_PATH), "record path");
+  check (g_hash_table_size (record->values) == 7, "record value count");
+
+  value = value_get (record, "Name", G_TYPE_STRING);
+  check (value && !strcmp (g_value_get_string (value), "Test"), "string");
+
+  value = value_get (record, "Favorite", G_TYPE_BOOLEAN);
+  check (value && g_value_get_boolean (value), "boolean");
+
+  value = value_get (record, "Strength", G_TYPE_UCHAR);
+  check (value && g_value_get_uchar (value) == 42, "byte");
+
+  value = value_get (record, "Frequency", G_TYPE_UINT);
+  check (value && g_value_get_uint (value) == 2412, "uint");
+
+  value = value_get (record, "WiFi.SSID", DBUS_TYPE_G_UCHAR_ARRAY);
+  bytes = value ? g_value_get_boxed (value) : NULL;
+  check (bytes && bytes->len == 6 && !memcmp (bytes->data, "\0ssid\xff", 6),
+         "byte array");
+
+  value = value_get (record, "Networks",
+                     dbus_g_type_get_collection ("GPtrArray",
+                                                 DBUS_TYPE_G_OBJECT_PATH));
+  paths = value ? g_value_get_boxed (value) : NULL;
+  check (paths && paths->len == 2 &&
+         !strcmp (g_ptr_array_index (paths, 0), "/network/a") &&
+         !strcmp (g_ptr_array_index (paths, 1), "/network/b"),
+         "path array");
+
+  value = value_get (record, "Technologies", G_TYPE_STRV);
+  strv = value ? g_value_get_boxed (value) : NULL;
+  check (strv && g_strv_length (strv) == 2 &&
+         !strcmp (strv[0], "wifi") && !strcmp (strv[1], "ethernet"),
+         "string array");
+
+  records_free (records);
+}
+
+static void
+check_rejected (const gchar *data, gsize len, const gchar *what)
+{
+  GPtrArray *records = internal_snapshot_decode (data, len);
+
+  check (records == NULL, what);
+  if (records)
+    records_free (records);
+}
+
+/* Read and overwrite the u32 at offset, little endian */
+static guint32
+peek_uint32 (const gchar *data, gsize offset)
+{
+  guint32 v;
+
+  memcpy (&v, data + offset, sizeof (v));
+  return GUINT32_FROM_LE (v);
+}
+
+static void
+poke_uint32 (gchar *data, gsize offset, guint32 v)
+{
+  v = GUINT32_TO_LE (v);
+  memcpy (data + offset, &v, sizeof (v));
+}
+
+static void
+test_malformed (const GString *data)
+{
+  gchar *copy;
+  gchar what[64];
+  gsize len, magic = strlen ("GCMSNAP");
+  gsize path_len_at = magic + 1 + 4 + 1;
+  gsize first_value_at = path_len_at + 4 + strlen (TEST_PATH) + 4;
+
+  for (len = 0; len < data->len; len++)
+  {
+    g_snprintf (what, sizeof (what), "truncated to %" G_GSIZE_FORMAT " bytes",
+                len);
+    check_rejected (data->str, len, what);
+  }
+
+  copy = g_malloc (data->len);
+  memcpy (copy, data->str, data->len);
+
+  copy[0] = 'X';
+  check_rejected (copy, data->len, "bad magic");
+  copy[0] = data->str[0];
+
+  copy[magic]++;
+  check_rejected (copy, data->len, "unknown version");
+  copy[magic] = data->str[magic];
+
+  poke_uint32 (copy, magic + 1, G_MAXUINT32);
+  check_rejected (copy, data->len, "record count past the end");
+  memcpy (copy, data->str, data->len);
+
+  poke_uint32 (copy, path_len_at, G_MAXUINT32);
+  check_rejected (copy, data->len, "path length past the end");
+  memcpy (copy, data->str, data->len);
+
+  poke_uint32 (copy, path_len_at + 4 + strlen (TEST_PATH), G_MAXUINT32);
+  check_rejected (copy, data->len, "value count past the end");
+  memcpy (copy, data->str, data->len);
+
+  /* The first value's type byte follows its name */
+  copy[first_value_at + 4 + peek_uint32 (data->str, first_value_at)] = '?';
+  check_rejected (copy, data->len, "unknown value type");
+
+  g_free (copy);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  GPtrArray *records;
+  GString *data;
+
+  g_type_init ();
+  dbus_g_type_specialized_init ();
+
+  records = records_new ();
+  data = internal_snapshot_encode (records);
+  records_free (records);
+
+  test_round_trip (data);
+  test_malformed (data);
+
+  g_string_free (data, TRUE);
+
+  if (failed)
+    return 1;
+
+  g_print ("Snapshot round trip and malformed input passed\n");
+  return 0;
+}